@@ -0,0 +1,86 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROTIDE_ANCHORS_HPP
+#define ROTIDE_ANCHORS_HPP
+
+#include <rotide/buffer.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// A range of the buffer that stays on its text through edits. It is a
+// node of the tree that holds it; only the tree can say where it is.
+struct Anchor;
+
+typedef std::vector<Anchor*> Anchor_list;
+
+// Ranges of a buffer, kept in step with its edits: marks, the jump list,
+// and anything else that has to point at text rather than at an offset.
+// An anchor is [start, end); a point is an empty one.
+//
+// The anchors are held in a treap by start, each node knowing the
+// furthest end in its subtree. An edit shifts every anchor past it by
+// splitting the tree there and leaving the shift on the root of the part
+// after it, to be handed down only when a walk goes through; so a million
+// anchors below an edit near the top cost O(log n) to move. Only those
+// that overlap the edit are visited one by one.
+//
+// Text typed at the start of an anchor goes in front of it and text typed
+// at its end stays out of it. An anchor in text that is replaced keeps
+// its place in the new text, or ends up where the text was if none is
+// left.
+//
+// EXAMPLE:
+//  Anchor_tree anchors(&buffer);
+//  Anchor* mark = anchors.add(view.cursor);
+//  ... edits ...
+//  view.set_offset(anchors.start(mark));
+//  anchors.remove(mark);
+//
+class Anchor_tree : public Buffer_listener {
+public:
+    explicit Anchor_tree(Buffer* buffer);
+    ~Anchor_tree();
+
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+
+    Anchor* add(size_t offset) { return add(offset, offset); }
+    Anchor* add(size_t start, size_t end);
+    void remove(Anchor* anchor);
+    void clear();
+
+    // Where an anchor is now, in O(log n).
+    size_t start(const Anchor* anchor) const;
+    size_t end(const Anchor* anchor) const;
+
+    // Appends the anchors overlapping [begin, end) by start, along with
+    // the empty ones in it.
+    void find(size_t begin, size_t end, Anchor_list* found) const;
+
+    size_t size() const { return count; }
+
+private:
+    Anchor_tree(const Anchor_tree&);
+    Anchor_tree& operator=(const Anchor_tree&);
+
+    Buffer* buffer;
+    Anchor* root;
+    size_t count;
+};
+
+#endif // ROTIDE_ANCHORS_HPP
@@ -0,0 +1,319 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_BUFFER_HPP
+#define ROTIDE_BUFFER_HPP
+
+#include <rotide/ref.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// The buffer is a piece table. The bytes themselves live in immutable
+// blocks (the mmapped file, or chunks of inserted text) and the document
+// is an ordered list of pieces pointing into those blocks.
+//
+// The pieces are kept in a persistent treap: an edit copies only the
+// O(log n) nodes on the path it touches and shares everything else. This
+// makes a snapshot of the whole document as cheap as copying a pointer,
+// which is what undo, saving and the worker threads build on.
+//
+// See NOTES for the original rectangular buffer sketch this replaces.
+
+typedef std::vector<size_t> Offset_list;
+
+// A run of bytes in the document.
+struct Buffer_range {
+    Buffer_range(size_t offset, size_t length)
+        : offset(offset), length(length) { }
+
+    size_t offset, length;
+};
+
+typedef std::vector<Buffer_range> Range_list;
+
+// A block of bytes that pieces point into. Bytes below `used` never
+// change once written, so blocks can be read from any thread. The one
+// exception is a mapping whose file another program writes over in
+// place: its pages show the new bytes, and past a new end they fault.
+class Buffer_block {
+public:
+    // Heap storage for inserted text.
+    explicit Buffer_block(size_t capacity);
+
+    // Storage backed by a read-only mapping of a file.
+    Buffer_block(char* mapping, size_t size, int fd);
+
+    ~Buffer_block();
+
+    // Records the position of every newline so that newline lookups in
+    // large blocks are a binary search instead of a scan.
+    void build_index();
+
+    // True if there is a NUL among the first bytes, which is how text
+    // tools tell binary content apart. Such a block is marked `binary`
+    // instead of indexed.
+    bool looks_binary() const;
+
+    // For a mapping whose file was cut to size: the pages past the new
+    // end are swapped for zeros, so reading them no longer faults. Safe
+    // from any thread, and does nothing to heap blocks.
+    void cut(size_t size);
+
+    // Number of newlines in [start, start + length).
+    size_t count_newlines(size_t start, size_t length) const;
+
+    // Block offset of the nth (0-based) newline at or after start.
+    size_t find_newline(size_t start, size_t n) const;
+
+    int refs;
+    char* data;
+    size_t capacity, used;
+    int fd;
+    bool mapped, indexed;
+
+    // Binary content has no lines: its newlines are never counted, so
+    // a block of any size makes a piece in O(1) and is all one line.
+    bool binary;
+    Offset_list newlines;
+
+private:
+    Buffer_block(const Buffer_block&);
+    Buffer_block& operator=(const Buffer_block&);
+};
+
+// A run of bytes inside a block.
+struct Piece {
+    Piece() : start(0), length(0), newlines(0) { }
+    Piece(const Ref<Buffer_block>& block, size_t start, size_t length);
+
+    const char* data() const { return block->data + start; }
+
+    Ref<Buffer_block> block;
+    size_t start, length, newlines;
+};
+
+typedef std::vector<Piece> Piece_list;
+
+// An immutable treap node. `bytes` and `newlines` are subtree totals.
+struct Piece_node {
+    Piece_node(const Ref<Piece_node>& left,
+            const Ref<Piece_node>& right,
+            const Piece& piece,
+            unsigned priority);
+
+    int refs;
+    Ref<Piece_node> left, right;
+    Piece piece;
+    size_t bytes, newlines;
+    unsigned priority;
+};
+
+// A read-only view of the document at one point in time. Copying a
+// snapshot is O(1) and it stays valid no matter what happens to the
+// buffer afterwards.
+class Buffer_snapshot {
+public:
+    Buffer_snapshot() { }
+    explicit Buffer_snapshot(const Ref<Piece_node>& root) : root(root) { }
+
+    // All of a block, or nothing for an empty one. Like edits, this is
+    // only done on the main thread.
+    explicit Buffer_snapshot(const Ref<Buffer_block>& block);
+
+    size_t size() const;
+
+    // Number of lines. An empty document has one (empty) line.
+    size_t lines() const;
+
+    // Offset of the first byte of a line, and of its terminating newline
+    // (or size() for the last line). Lines past the end are clamped.
+    size_t line_start(size_t line) const;
+    size_t line_end(size_t line) const;
+
+    // Line containing a byte offset.
+    size_t line_of(size_t offset) const;
+
+    // Offset of the nth (0-based) newline in the document.
+    size_t newline_offset(size_t n) const;
+
+    // Copies up to size bytes starting at offset; returns bytes copied.
+    size_t read(size_t offset, size_t size, char* out) const;
+    std::string text(size_t offset, size_t size) const;
+    char at(size_t offset) const;
+
+    // The bytes in [offset, offset + size) as a snapshot of their own.
+    // Only the nodes along the two cuts are new; the blocks and every
+    // piece in between are shared, so a slice of any size is O(log n).
+    // Like edits, it is only made on the main thread.
+    Buffer_snapshot slice(size_t offset, size_t size) const;
+
+    Ref<Piece_node> root;
+};
+
+// Maps an open file read-only as a block, which owns the descriptor from
+// then on. An empty file is no block. The newline index is left for the
+// caller to build, so this is O(1) whatever the size and can be done on
+// any thread. On failure the descriptor is closed and errno says why.
+bool map_file(int fd, Ref<Buffer_block>* block);
+
+// Walks the document as a series of contiguous byte runs starting at an
+// offset, without copying anything.
+//
+// EXAMPLE:
+//  Piece_iterator it(buffer.snapshot(), 0);
+//  const char* data;
+//  size_t size;
+//  while (it.next(&data, &size))
+//      fwrite(data, 1, size, stdout);
+//
+class Piece_iterator {
+public:
+    Piece_iterator(const Buffer_snapshot& snapshot, size_t offset);
+
+    // Yields the next run. Returns false once the document is exhausted.
+    bool next(const char** data, size_t* size);
+
+    // Like next, but yields the piece itself with `skip` bytes of its
+    // front already consumed.
+    bool next_piece(const Piece** piece, size_t* skip);
+
+    // Document offset of the next run.
+    size_t offset() const { return position; }
+
+private:
+    void push_left(const Piece_node* node);
+
+    Buffer_snapshot snapshot;
+    std::vector<const Piece_node*> stack;
+    size_t skip, position;
+};
+
+// Describes a single change to a buffer. Lines are counted in the
+// document before the edit; `line` is the line holding `offset`.
+struct Buffer_edit {
+    Buffer_edit()
+        : offset(0), removed(0), inserted(0),
+          line(0), removed_lines(0), inserted_lines(0),
+          generation(0) { }
+
+    size_t offset, removed, inserted;
+    size_t line, removed_lines, inserted_lines;
+    unsigned long generation;
+    Buffer_snapshot before;
+};
+
+class Buffer;
+
+// Anything that caches information derived from the text (layout,
+// highlighting, indexes) listens for edits so it can update only what
+// actually changed.
+class Buffer_listener {
+public:
+    virtual ~Buffer_listener() { }
+    virtual void edited(Buffer* buffer, const Buffer_edit& edit) = 0;
+
+    // The file on disk now holds buffer->saved.
+    virtual void written(Buffer*) { }
+};
+
+typedef std::vector<Buffer_listener*> Listener_list;
+
+class Buffer {
+public:
+    Buffer();
+
+    // Maps a file and makes it the contents of the buffer. A file that
+    // does not exist yet opens as an empty buffer with that path. Binary
+    // content is not indexed, so any size opens in O(1).
+    bool open(const std::string& file);
+
+    // Edits. Offsets past the end are clamped.
+    void insert(size_t offset, const char* data, size_t size);
+    void insert(size_t offset, const std::string& text);
+    void remove(size_t offset, size_t size);
+
+    // Puts count copies of another snapshot in at offset. Its pieces are
+    // shared rather than copied, so this costs O(pieces) whatever the
+    // number of bytes.
+    //
+    // EXAMPLE:
+    //  Buffer_snapshot line = buffer.snapshot().slice(start, length);
+    //  buffer.insert(buffer.size(), line, 1000);
+    //
+    void insert(size_t offset, const Buffer_snapshot& text, size_t count);
+
+    // Replaces every range with the same text as a single edit. The text
+    // is stored once and the pieces between the ranges are built in one
+    // pass, so a million replacements cost one edit, one undo step and
+    // one notification spanning the first range to the last. The ranges
+    // have to be sorted; one that overlaps the range before it is
+    // skipped. Returns how many were replaced.
+    size_t replace(const Range_list& ranges, const char* data, size_t size);
+
+    // Makes another snapshot the contents, in O(1). Only the bytes in
+    // [offset, offset + removed) of the current document may differ; in
+    // the snapshot they are the `inserted` bytes at offset. This is how
+    // undo steps back and forth without copying anything.
+    void restore(const Buffer_snapshot& snapshot,
+            size_t offset, size_t removed, size_t inserted);
+
+    // Records that the file on disk now holds snapshot, which may be
+    // older than the contents, and tells the listeners.
+    void set_saved(const Buffer_snapshot& snapshot);
+
+    // Appends bytes the file on disk already holds, like those another
+    // program wrote to its end. A buffer that was unmodified stays so:
+    // saved moves along before the listeners are told.
+    void append_saved(const Buffer_snapshot& text);
+
+    // Register for edit notifications.
+    void listen(Buffer_listener* listener);
+    void unlisten(Buffer_listener* listener);
+
+    const Buffer_snapshot& snapshot() const { return current; }
+
+    size_t size() const { return current.size(); }
+    size_t lines() const { return current.lines(); }
+    size_t line_start(size_t line) const { return current.line_start(line); }
+    size_t line_end(size_t line) const { return current.line_end(line); }
+    size_t line_of(size_t offset) const { return current.line_of(offset); }
+    char at(size_t offset) const { return current.at(offset); }
+    std::string text(size_t offset, size_t size) const
+    { return current.text(offset, size); }
+
+    std::string path;
+    unsigned long generation;
+
+    // True unless the contents are those of the file as it was opened.
+    bool modified;
+
+    // True if the file was opened as binary content (see
+    // Buffer_block::looks_binary). It has no lines and is shown as hex.
+    bool binary;
+    Buffer_snapshot saved;
+
+private:
+    Piece append(const char* data, size_t size);
+    void commit(const Ref<Piece_node>& root, Buffer_edit* edit);
+
+    Buffer_snapshot current;
+    Ref<Buffer_block> add_block;
+    Listener_list listeners;
+};
+
+#endif // ROTIDE_BUFFER_HPP
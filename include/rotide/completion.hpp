@@ -0,0 +1,146 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROTIDE_COMPLETION_HPP
+#define ROTIDE_COMPLETION_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/ref.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Buffer_view;
+class Event_queue;
+class Thread_pool;
+
+typedef std::vector<std::string> Word_list;
+
+// A node of a Word_trie: one byte of a word, linked to its parent, its
+// first child and its next sibling by index. `count` is how often the
+// word ending here is in the text and `best` the highest count below.
+struct Word_node {
+    unsigned parent, child, sibling;
+    int count, best;
+    char byte;
+};
+
+// Words and how often each one is in the text, in a trie held in one
+// array. Counts only ever change by deltas, so a trie can hold what an
+// edit took out and put in as well as whole texts, and adding one trie to
+// another sums them. A word whose count falls to zero keeps its nodes for
+// when it comes back.
+//
+// EXAMPLE:
+//  Word_trie words;
+//  words.add("buffer", 6, 1);
+//  words.add("buffered", 8, 1);
+//  words.complete("buf", 10, &list);   // the most frequent first
+//
+class Word_trie {
+public:
+    Word_trie();
+
+    void add(const char* word, size_t size, int delta);
+
+    // Appends up to limit words longer than prefix that start with it,
+    // the most frequent first. Only as many nodes are looked at as it
+    // takes to be sure of those.
+    void complete(const std::string& prefix, size_t limit,
+            Word_list* words) const;
+
+    // Adds every count in other to this one.
+    void merge(const Word_trie& other);
+    void swap(Word_trie& other) { nodes.swap(other.nodes); }
+
+    size_t size() const { return nodes.size(); }
+
+private:
+    unsigned find(const char* word, size_t size) const;
+    unsigned child_of(unsigned node, char byte);
+    std::string word_of(unsigned node) const;
+
+    std::vector<Word_node> nodes;
+};
+
+// A build or edit being counted on the thread pool, which is cancelled
+// when the index goes away.
+struct Word_run {
+    Word_run() : refs(0), cancelled(0) { }
+
+    int refs;
+    int cancelled;
+};
+
+// Every word in the buffers it watches, for completing the one being
+// typed. It is never built again: each edit reads the words around what
+// it took out and put in and changes their counts. Whole buffers and big
+// edits are counted on the thread pool and summed in when they are done,
+// which works whatever was edited meanwhile, since counts only add up.
+//
+// EXAMPLE:
+//  Word_index words(&pool, &events);
+//  words.watch(&buffer);
+//  words.complete("buf", 10, &list);
+//  words.complete(&view, 1);       // completes the word at the cursor
+//
+class Word_index : public Buffer_listener {
+public:
+    Word_index(Thread_pool* pool, Event_queue* events);
+    ~Word_index();
+
+    void watch(Buffer* buffer);
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+
+    void complete(const std::string& prefix, size_t limit,
+            Word_list* words) const;
+
+    // Replaces the word in front of the view's cursor with the first
+    // completion of it, or, right after doing so, with the one step
+    // places on from it. Stepping past either end gives back what was
+    // typed. Returns false if there is nothing to complete.
+    bool complete(Buffer_view* view, int step);
+
+    // Takes in what a job counted. Run on the main thread.
+    void counted(Word_run* run, Word_trie* counts);
+
+private:
+    void count(const Buffer_snapshot& before, size_t begin,
+            size_t before_end, const Buffer_snapshot& after,
+            size_t after_end, bool clipped_begin, bool clipped_end);
+
+    Word_index(const Word_index&);
+    Word_index& operator=(const Word_index&);
+
+    Thread_pool* pool;
+    Event_queue* events;
+    std::vector<Buffer*> buffers;
+    Word_trie words;
+    Ref<Word_run> run;
+
+    // The completion last made: where the word starts, what was typed,
+    // the choices and which one is in.
+    Buffer* completed_buffer;
+    unsigned long completed_generation;
+    size_t completed_start, completed_end;
+    std::string typed;
+    Word_list choices;
+    int choice;
+};
+
+#endif // ROTIDE_COMPLETION_HPP
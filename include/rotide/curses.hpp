@@ -119,6 +119,12 @@ public:
     // Refresh the window
     void refresh();
 
+    // Frames: between hold() and the matching release() refreshes only
+    // pile up, and the last release() puts everything on the screen in
+    // one update. Holds nest.
+    void hold();
+    void release();
+
     // Shutdown the instance
     void shutdown();
 
@@ -137,6 +143,21 @@ public:
     // Get a character from the input
     bool get(char* c);
 
+    // Check if get() has a key to return without waiting
+    bool ready();
+
+    // Wait until there is a key or fd can be read, whichever comes
+    // first. Returns true if it was a key.
+    bool idle(int fd);
+
+    // Call after get() returns ESC. If the terminal is starting a
+    // bracketed paste, reads all of it into text.
+    bool get_paste(std::string* text);
+
+    // Input queued up faster than anyone types is a paste from a terminal
+    // that does not bracket it. Collects c and the rest of the burst.
+    bool get_burst(const char c, std::string* text);
+
     // Draw a status bar
     void draw_status_bar();
 
@@ -152,6 +173,9 @@ public:
     // last pressed key
     int last_key;
 
+    // Depth of hold() calls not yet released
+    int held;
+
     Curses_pos pos, spos;
     curses_lib::WINDOW* touched_window;
     curses_lib::WINDOW* active_window;
@@ -159,6 +183,10 @@ public:
 
     Buffer_list buffers;
     Curses_buffer screen_buffer;
+
+    // Bytes read ahead while looking for a paste that turned out to be
+    // regular input. get() hands these out before reading the terminal.
+    std::deque<char> pending;
 };
 
 #endif // ROTIDE_CURSES_HPP
@@ -86,6 +86,15 @@ std::string KEY_STR(const int key, const Key_string_mode& mode = KS_PRETTY_PRINT
     return s;
 }
 
+// Bytes that can be typed text: printable characters, tabs and
+// newlines, but nothing a binding could mean as a command.
+inline
+bool is_text(char c)
+{
+    unsigned char byte = c;
+    return (byte >= 32 && byte != 127) || c == CTRL_I || c == CTRL_J;
+}
+
 
 enum Curses_style
 {
@@ -0,0 +1,112 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROTIDE_CURSORS_HPP
+#define ROTIDE_CURSORS_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/view.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+// A cursor at head with the text between it and anchor selected. A plain
+// cursor is an empty selection.
+struct Selection {
+    Selection(size_t anchor, size_t head) : anchor(anchor), head(head) { }
+
+    size_t start() const { return std::min(anchor, head); }
+    size_t end() const { return std::max(anchor, head); }
+
+    size_t anchor, head;
+};
+
+typedef std::vector<Selection> Selection_list;
+
+// More cursors than the view's own, made from the matches of a pattern
+// or down a column of lines. While there are any, typing goes in at all
+// of them and motions move all of them.
+//
+// Each key typed is one Buffer::replace over every selection: the pieces
+// from the first cursor to the last are rebuilt in one pass, the buffer
+// tells its listeners about one edit, and undo keeps one record. Where
+// each cursor lands is worked out from the same ranges, so nothing is
+// looked up again afterwards.
+//
+// The selections are kept sorted and apart; ones that run into each
+// other become one. The view's cursor is the main one: moving it on its
+// own takes the main one along.
+//
+// EXAMPLE:
+//  Cursor_set cursors(&view);
+//  cursors.add_column(9999);       // a cursor on each of the next lines
+//  cursors.insert("// ", 3);       // one edit, one undo step
+//  cursors.clear();
+//
+class Cursor_set : public Buffer_listener, public Highlighter {
+public:
+    explicit Cursor_set(Buffer_view* view);
+    ~Cursor_set();
+
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+    void highlight(size_t begin, size_t end, Highlight_list* highlights);
+
+    // Whether there are cursors other than the view's own. They are put
+    // aside while the view shows another buffer.
+    bool active() const;
+    size_t count() const;
+
+    // Selects each range, with its cursor at the end, instead of the
+    // cursors there were. The first one from the view's cursor on is the
+    // main one.
+    bool select(const Range_list& ranges);
+
+    // Adds a cursor at the main one's column on each of the next lines,
+    // or on the lines above it if lines is negative.
+    bool add_column(long lines);
+
+    // Back to the view's cursor alone.
+    void clear();
+
+    // Typing at every cursor. A selection is replaced by what is typed,
+    // or removed by a backspace.
+    void insert(const char* data, size_t size);
+    void backspace();
+
+    // Moves every cursor by characters within its line, or by lines in
+    // the same byte column. Selections are dropped.
+    void move_columns(long delta);
+    void move_lines(long delta);
+
+private:
+    void take_cursor();
+    void normalize(size_t head);
+    void apply(const Range_list& ranges, const char* data, size_t size);
+
+    Cursor_set(const Cursor_set&);
+    Cursor_set& operator=(const Cursor_set&);
+
+    Buffer_view* view;
+    Buffer* buffer;
+    Selection_list selections;
+    size_t primary;
+    bool editing;
+    int cursor_attr, selection_attr;
+};
+
+#endif // ROTIDE_CURSORS_HPP
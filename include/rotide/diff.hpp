@@ -0,0 +1,62 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROTIDE_DIFF_HPP
+#define ROTIDE_DIFF_HPP
+
+#include <rotide/buffer.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Bytes [offset, offset + removed) of the old text that became bytes
+// [from, from + inserted) of the new one.
+struct Diff_hunk {
+    Diff_hunk(size_t offset, size_t removed, size_t from, size_t inserted)
+        : offset(offset), removed(removed), from(from), inserted(inserted)
+    {
+    }
+
+    size_t offset, removed, from, inserted;
+};
+
+typedef std::vector<Diff_hunk> Diff_hunk_list;
+
+// The hunks that turn a snapshot into the contents of a block, front to
+// back. Whatever the two share at the front and the back is trimmed off
+// first with memcmp. What is left is diffed by lines with Myers'
+// algorithm. A middle too big to diff, or too different, becomes one
+// hunk.
+//
+// Every byte of the snapshot up to where they differ is read. Two
+// mappings of one file are not the same bytes just because the inode
+// is: a file written over in place shows its new bytes through both,
+// which is why File_watcher never diffs a buffer mapping the file.
+//
+// Only reads, so it can run on any thread.
+//
+// EXAMPLE:
+//  Diff_hunk_list hunks;
+//  diff(buffer.snapshot(), *mapped, &hunks);
+//
+void diff(const Buffer_snapshot& before, const Buffer_block& after,
+        Diff_hunk_list* hunks);
+
+// True if a snapshot holds exactly the bytes of a block.
+bool same(const Buffer_snapshot& before, const Buffer_block& after);
+
+#endif // ROTIDE_DIFF_HPP
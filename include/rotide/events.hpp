@@ -0,0 +1,67 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_EVENTS_HPP
+#define ROTIDE_EVENTS_HPP
+
+#include <rotide/thread.hpp>
+
+#include <vector>
+
+// Something a background thread wants done on the main thread, such as
+// showing progress or taking in a finished result.
+class Event {
+public:
+    virtual ~Event() { }
+    virtual void run() = 0;
+};
+
+typedef std::vector<Event*> Event_list;
+
+// Events posted from any thread, run by the main loop in the order they
+// were posted. Posting also makes fd() readable, so the main loop can
+// wait on the keyboard and the queue at once.
+//
+// EXAMPLE:
+//  events.post(new Save_done(...));     // on a worker
+//  ...
+//  if (!curses.idle(events.fd()))      // on the main thread
+//      events.dispatch();
+//
+class Event_queue {
+public:
+    Event_queue();
+    ~Event_queue();
+
+    // Takes ownership of the event.
+    void post(Event* event);
+
+    // Runs and deletes everything posted so far. Returns false if there
+    // was nothing.
+    bool dispatch();
+
+    int fd() const { return wake[0]; }
+
+private:
+    Event_queue(const Event_queue&);
+    Event_queue& operator=(const Event_queue&);
+
+    Mutex mutex;
+    Event_list events;
+    int wake[2];
+};
+
+#endif // ROTIDE_EVENTS_HPP
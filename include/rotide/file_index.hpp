@@ -0,0 +1,195 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_FILE_INDEX_HPP
+#define ROTIDE_FILE_INDEX_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/ref.hpp>
+#include <rotide/thread.hpp>
+
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+class Buffer_view;
+class Event_queue;
+
+// One path in the index. Its bytes live in the index's name blob, and
+// mask has a bit set for every kind of character in it, so a query can
+// skip paths that lack one of its characters without looking at them.
+struct Index_entry {
+    uint64_t mask;
+    size_t offset;
+    unsigned length;    // 0 once the file is gone
+    unsigned name;      // where the file name starts
+};
+
+typedef std::vector<Index_entry> Index_entry_list;
+
+// A directory in the index and the entries of the files right in it.
+struct Index_directory {
+    std::string path;   // "" for the root, otherwise ending in '/'
+    int watch;          // its inotify watch, or -1
+    bool removed;
+    std::vector<size_t> files;
+};
+
+typedef std::vector<Index_directory> Index_directory_list;
+
+// A path found by a query, best first.
+struct File_match {
+    std::string path;
+    int score;
+};
+
+typedef std::vector<File_match> File_match_list;
+
+// One build of the index, shared by the jobs walking the tree.
+struct Index_run {
+    Index_run() : refs(0), cancelled(0), pending(0) { }
+
+    int refs;
+    int cancelled;
+    int pending;
+};
+
+// What the watcher read for a watched directory.
+struct Index_change {
+    int watch;
+    uint32_t mask;
+    std::string name;
+};
+
+typedef std::vector<Index_change> Index_change_list;
+
+// Every file under a directory, for finding one by a few of the
+// characters in its path.
+//
+// The tree is walked on the thread pool when the index starts, one job
+// per directory, and every directory is watched with inotify from then
+// on, so files that come and go show up in queries right away. The index
+// itself is only touched on the main thread: the jobs and the watcher
+// post what they find.
+//
+// A query matches paths that have its characters in order, ignoring
+// case, and scores them by where the characters fall: in the file name,
+// at the start of a word and next to each other is better. Paths are
+// scored in chunks by the main thread and any idle workers at once, and
+// while a query is being typed each one only looks at the paths the one
+// before it matched.
+//
+// EXAMPLE:
+//  File_index index(&pool, &events);
+//  index.start(".");
+//  ...
+//  index.find("bufcc", 20, &matches);  // src/buffer.cc first
+//
+class File_index {
+public:
+    File_index(Thread_pool* pool, Event_queue* events);
+    ~File_index();
+
+    // Drops the index and builds it again for root.
+    bool start(const std::string& root);
+    bool busy() const { return indexing; }
+    size_t size() const { return entries.size() - removed; }
+
+    // The best paths for a query, at most limit of them. An empty query
+    // matches nothing.
+    void find(const std::string& query, size_t limit,
+            File_match_list* matches);
+
+    // Fills picks with the best paths for a query, one to a line, and
+    // switches the view to it. Returns how many there are.
+    size_t pick(Buffer_view* view, const std::string& query);
+
+    // Switches the view back from the picks to the buffer it showed
+    // before, if the path under the cursor is that buffer's file. Returns
+    // false otherwise.
+    bool open(Buffer_view* view);
+
+    // Run on the main thread by the events the jobs and the watcher post.
+    void add(Index_run* run, const std::string& path, int watch,
+            const std::vector<std::string>& files);
+    void change(const Index_change_list& changes);
+    void finished(Index_run* run);
+
+    Buffer picks;
+
+private:
+    class Watcher : public Thread {
+    public:
+        Watcher(File_index* index, Event_queue* events, int fd);
+        ~Watcher();
+
+        void stop();
+
+    protected:
+        void run();
+
+    private:
+        File_index* index;
+        Event_queue* events;
+        int fd;
+        int wake[2];
+    };
+
+    typedef std::map<int, size_t> Watch_map;
+
+    void clear();
+    void walk(const std::string& path);
+    size_t directory(const std::string& path, bool* fresh);
+    void add_file(size_t directory, const std::string& name, bool check);
+    void remove_file(size_t directory, const std::string& name);
+    void remove_directory(const std::string& path);
+    void compact();
+
+    File_index(const File_index&);
+    File_index& operator=(const File_index&);
+
+    Thread_pool* pool;
+    Event_queue* events;
+
+    std::string root;
+    std::string names;
+    Index_entry_list entries;
+    Index_directory_list directories;
+    Watch_map watches;
+    std::map<std::string, size_t> by_path;
+    size_t removed;
+
+    Ref<Index_run> run;
+    bool indexing;
+
+    int inotify;
+    Watcher* watcher;
+
+    // The last query and the entries it matched, while the index has
+    // not changed since.
+    std::string last_query;
+    std::vector<size_t> last_hits;
+    bool last_valid;
+
+    // What the view showed before the picks.
+    Buffer* other;
+    size_t other_cursor;
+};
+
+#endif // ROTIDE_FILE_INDEX_HPP
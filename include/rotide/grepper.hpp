@@ -0,0 +1,108 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_GREPPER_HPP
+#define ROTIDE_GREPPER_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/search.hpp>
+
+#include <cstddef>
+#include <string>
+
+class Buffer_view;
+class Curses;
+class Event_queue;
+class Thread_pool;
+
+// One :grep, shared by the jobs working on it. The counters are only
+// changed atomically.
+struct Grep_run {
+    Grep_run(const std::string& pattern, bool regex);
+
+    int refs;
+    std::string pattern;
+    bool regex;
+    Literal_search literal;
+
+    int cancelled;
+    int pending;
+    size_t files, matches;
+};
+
+// Searches every file under a directory on the thread pool and streams
+// the matching lines into a results buffer as "path:line:text".
+//
+// A directory is a job of its own: it queues a job for each directory
+// in it and batches its files into jobs of a few dozen, so the workers
+// spread out over the tree as it is found. Each file is mapped and
+// searched in place; one with a NUL byte near the start is taken to be
+// binary and skipped, and so is anything whose name starts with a dot.
+// Every file with matches is posted to the main loop on its own, so the
+// results show up while the rest of the tree is still being searched.
+//
+// EXAMPLE:
+//  Grepper grepper(&pool, &events, &curses);
+//  grepper.start("TODO", ".", false, &error);
+//  grepper.toggle(&view);
+//
+class Grepper {
+public:
+    Grepper(Thread_pool* pool, Event_queue* events, Curses* curses);
+    ~Grepper();
+
+    // Starts searching under root, dropping any earlier results. Returns
+    // false, with the reason in error, if the pattern is no good or root
+    // can not be read.
+    bool start(const std::string& pattern, const std::string& root,
+            bool regex, std::string* error);
+    void cancel();
+    bool busy() const { return searching; }
+
+    // Switches the view between the results and the buffer it showed
+    // before, which keeps its cursor.
+    void toggle(Buffer_view* view);
+
+    // Shows the match under the cursor in the results, if it is in the
+    // buffer the view showed before. Returns false otherwise.
+    bool open(Buffer_view* view);
+
+    // Run on the main thread by the events the jobs post.
+    void found(Grep_run* run, const std::string& lines);
+    void finished(Grep_run* run);
+
+    Buffer results;
+
+private:
+    void report();
+
+    Grepper(const Grepper&);
+    Grepper& operator=(const Grepper&);
+
+    Thread_pool* pool;
+    Event_queue* events;
+    Curses* curses;
+
+    Ref<Grep_run> run;
+    std::string root;
+    bool searching;
+
+    // What the view showed before the results.
+    Buffer* other;
+    size_t other_cursor;
+};
+
+#endif // ROTIDE_GREPPER_HPP
@@ -0,0 +1,91 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_KEY_RING_HPP
+#define ROTIDE_KEY_RING_HPP
+
+#include <cstddef>
+#include <vector>
+
+typedef std::vector<int> Key_list;
+
+// A Key_ring keeps the most recent key sequences in a fixed number of
+// bytes. Once it is full the oldest sequences make room for new ones, so
+// an editor that stays open for days holds on to the same memory it had
+// on the first command.
+//
+// Every entry is packed as varints:
+//
+//  [length] [key] [key] ... [length, reversed]
+//
+// where length counts the bytes of the keys. The leading length lets the
+// oldest entry be dropped and the trailing one lets entries be walked
+// back from the newest.
+//
+// EXAMPLE:
+//  Key_ring history(4096);
+//  history.push(keys);
+//
+//  Key_ring::Entry entry;
+//  if (history.get(0, &entry)) {
+//      int key;
+//      while (entry.next(&key))
+//          ...
+//  }
+//
+class Key_ring {
+public:
+    explicit Key_ring(size_t capacity);
+
+    // Adds a sequence as the newest entry. Keys must not be negative. A
+    // sequence that is larger than the whole ring is not kept.
+    void push(const Key_list& keys);
+
+    // Changes the number of bytes kept, keeping the newest entries that
+    // still fit.
+    void resize(size_t capacity);
+
+    size_t size() const { return entries; }
+    size_t capacity() const { return data.size(); }
+
+    // Reads the keys of one entry where they are stored.
+    class Entry {
+    public:
+        Entry() : ring(NULL), at(0), left(0) { }
+        bool next(int* key);
+
+    private:
+        friend class Key_ring;
+        const Key_ring* ring;
+        size_t at, left;
+    };
+
+    // The entry that was pushed back entries before the newest; 0 is the
+    // newest itself.
+    bool get(size_t back, Entry* entry) const;
+
+private:
+    unsigned char byte(size_t at) const;
+    size_t read_varint(size_t* at) const;
+    size_t read_trailer(size_t* end) const;
+    void write(size_t at, const unsigned char* from, size_t size);
+    void drop_oldest();
+
+    std::vector<unsigned char> data;
+    size_t head, used, entries;
+};
+
+#endif // ROTIDE_KEY_RING_HPP
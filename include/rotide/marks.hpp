@@ -0,0 +1,83 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROTIDE_MARKS_HPP
+#define ROTIDE_MARKS_HPP
+
+#include <rotide/anchors.hpp>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+class Buffer_view;
+
+// The named marks and the jump list of the buffer a view was opened on.
+// Both are anchors, so they stay on their text however much is typed or
+// deleted above them.
+//
+// A command that leaves the cursor on another line more than one away,
+// without editing anything, is a jump: where it started is pushed onto
+// the jump list, which back() and forward() then walk like a browser's
+// history.
+//
+// EXAMPLE:
+//  Marks marks(&view);
+//  marks.set('a');
+//  ... edits and motions ...
+//  marks.go('a');
+//  marks.back();       // to where the cursor was before going to 'a'
+//
+class Marks {
+public:
+    explicit Marks(Buffer_view* view);
+
+    // Marks the cursor's place under name, or moves the cursor to the
+    // mark. Both fail while the view shows another buffer.
+    bool set(int name);
+    bool go(int name);
+
+    // Told after every command where the cursor was before it and what
+    // the buffer's generation was.
+    void moved(size_t from, unsigned long generation);
+
+    bool back();
+    bool forward();
+
+private:
+    void push(size_t offset);
+    bool visit(size_t at);
+
+    typedef std::map<int, Anchor*> Mark_map;
+
+    Marks(const Marks&);
+    Marks& operator=(const Marks&);
+
+    Buffer_view* view;
+    Buffer* buffer;
+    Anchor_tree anchors;
+    Mark_map named;
+
+    // The jump list, oldest first, and where back() and forward() have
+    // taken the cursor in it: its size if they have not been used since
+    // the last jump.
+    std::vector<Anchor*> jumps;
+    size_t current;
+    bool walking;
+};
+
+#endif // ROTIDE_MARKS_HPP
@@ -0,0 +1,125 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_RECOVERY_HPP
+#define ROTIDE_RECOVERY_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/thread.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// An edit the writer thread reads from the text after it.
+struct Recovery_edit {
+    Recovery_edit(const Buffer_snapshot& after, size_t offset,
+            size_t removed, size_t inserted)
+        : after(after), offset(offset), removed(removed), inserted(inserted)
+    {
+    }
+
+    Buffer_snapshot after;
+    size_t offset, removed, inserted;
+};
+
+typedef std::vector<Recovery_edit> Recovery_edit_list;
+
+// The recovery journal keeps every edit that was not saved yet, so a
+// crash or a CTRL_C loses at most the last moment of typing. It sits next
+// to the file as .<name>.recover:
+//
+//  "RRJ1" [file size] [mtime s] [mtime ns] batch*
+//  batch = [length] [checksum] edit*
+//  edit  = [offset] [removed] [inserted] inserted-bytes
+//
+// with every [field] a varint. Edits are only ever appended to a ring in
+// memory; a background thread writes out what has piled up as one batch
+// and syncs it, every SYNC_MS or as soon as SYNC_BYTES are waiting. A
+// batch that was cut short or mangled by a crash ends the journal.
+//
+// An edit too big for the ring, and the text left unsaved after a save,
+// are handed over as a snapshot and a range instead, and the thread reads
+// the text itself. Past replay() the main thread never touches the file.
+//
+// On startup the edits are put back if the journal was made for the file
+// as it is on disk now. Once the buffer is saved, or closed without
+// changes, the journal has nothing left to say and starts over or goes.
+//
+// EXAMPLE:
+//  Recovery_journal recovery(&buffer);
+//  size_t edits = recovery.replay();
+//
+class Recovery_journal : public Buffer_listener, public Thread {
+public:
+    explicit Recovery_journal(Buffer* buffer);
+    ~Recovery_journal();
+
+    bool good() const { return fd >= 0; }
+
+    // Puts back the edits of a previous run and starts listening.
+    // Returns how many edits there were.
+    size_t replay();
+
+    // The buffer now matches the file on disk; forget everything so far.
+    void reset();
+
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+
+    // Starts over from what was saved. Edits made since the save began
+    // are kept as one edit.
+    void written(Buffer* buffer);
+
+    // Where the journal of a file lives.
+    static std::string path_for(const std::string& file);
+
+protected:
+    void run();
+
+private:
+    void append(const char* data, size_t size);
+    void append(const Buffer_snapshot& snapshot, size_t offset,
+            size_t size);
+    void spill(const Recovery_edit& edit);
+    void take(std::string* batch);
+    void flush(std::string* batch);
+    bool write_header(const std::string& file);
+
+    Recovery_journal(const Recovery_journal&);
+    Recovery_journal& operator=(const Recovery_journal&);
+
+    Buffer* buffer;
+    int fd;
+    bool listening;
+
+    // Edits waiting to be written: `used` bytes starting at `head`, then
+    // the spilled ones. Once one is spilled the rest follow it until the
+    // writer has taken them, so they go out in order.
+    char* ring;
+    size_t head, used;
+    Recovery_edit_list spilled;
+
+    // Set by reset(): the journal is started over, for `restart_file`,
+    // before anything still waiting is written.
+    bool restart;
+    std::string restart_file;
+
+    Mutex mutex;
+    Condition ready;
+    bool stopping;
+};
+
+#endif // ROTIDE_RECOVERY_HPP
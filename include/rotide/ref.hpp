@@ -0,0 +1,81 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_REF_HPP
+#define ROTIDE_REF_HPP
+
+#include <cstddef>
+
+// A Ref is an intrusive, reference counted handle. The referenced type only
+// needs a public `int refs` member that starts at zero; the last Ref to let
+// go deletes the object.
+//
+// The counts are updated atomically so immutable data (buffer blocks, piece
+// trees) can be handed to worker threads without any extra locking.
+//
+// EXAMPLE:
+//  struct Thing { Thing() : refs(0) { } int refs; };
+//  Ref<Thing> a(new Thing);
+//  Ref<Thing> b = a;   // refs == 2
+//
+template <class T>
+class Ref {
+public:
+    Ref() : ptr(NULL) { }
+    Ref(T* p) : ptr(p) { retain(); }
+    Ref(const Ref& other) : ptr(other.ptr) { retain(); }
+    ~Ref() { release(); }
+
+    Ref& operator=(const Ref& other)
+    {
+        if (ptr != other.ptr) {
+            T* old = ptr;
+            ptr = other.ptr;
+            retain();
+            if (old && __sync_sub_and_fetch(&old->refs, 1) == 0)
+                delete old;
+        }
+        return *this;
+    }
+
+    T* get() const { return ptr; }
+    T* operator->() const { return ptr; }
+    T& operator*() const { return *ptr; }
+    bool empty() const { return ptr == NULL; }
+
+    bool operator==(const Ref& other) const { return ptr == other.ptr; }
+    bool operator!=(const Ref& other) const { return ptr != other.ptr; }
+
+    // Drops the reference early.
+    void reset() { release(); ptr = NULL; }
+
+private:
+    void retain()
+    {
+        if (ptr)
+            __sync_add_and_fetch(&ptr->refs, 1);
+    }
+
+    void release()
+    {
+        if (ptr && __sync_sub_and_fetch(&ptr->refs, 1) == 0)
+            delete ptr;
+    }
+
+    T* ptr;
+};
+
+#endif // ROTIDE_REF_HPP
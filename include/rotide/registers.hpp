@@ -0,0 +1,121 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROTIDE_REGISTERS_HPP
+#define ROTIDE_REGISTERS_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/ref.hpp>
+
+#include <cstddef>
+#include <map>
+#include <string>
+
+class Buffer_view;
+class Curses;
+class Event_queue;
+class Thread_pool;
+
+// What a register holds: a snapshot of just the yanked bytes, sharing
+// every block with the buffer they came from. `lines` is set for whole
+// lines, which are put in under the cursor's line instead of at the
+// cursor.
+struct Yank {
+    Yank() : lines(false) { }
+
+    Buffer_snapshot text;
+    bool lines;
+};
+
+typedef std::map<int, Yank> Yank_map;
+
+// The register used when none is named, and the one the clipboard is
+// pasted into.
+const int UNNAMED_REGISTER = '"';
+const int CLIPBOARD_REGISTER = '+';
+
+// A trip to or from the system clipboard, which is cancelled when the
+// registers go away.
+struct Clip_run {
+    Clip_run() : refs(0), cancelled(0) { }
+
+    int refs;
+    int cancelled;
+};
+
+// Registers for yanked text. Nothing is ever copied into them: a yank
+// keeps a slice of the buffer's snapshot, which is O(log n) however much
+// it covers, and a put splices the same pieces back in. Half a gigabyte
+// can be yanked and put a hundred times over and the bytes stay where
+// they were.
+//
+// Bytes only get written out when they cross to the system clipboard.
+// copy() spills a register into a temporary file on the thread pool and
+// hands that to copy_command; paste() has paste_command fill a temporary
+// file, which is mapped and put in a register like any opened file.
+//
+// EXAMPLE:
+//  Yank_registers yanks(&view, &curses, &pool, &events);
+//  yanks.yank_lines('a', 1000000);
+//  yanks.put('a', 3);
+//  yanks.copy('a');
+//
+class Yank_registers {
+public:
+    Yank_registers(Buffer_view* view, Curses* curses, Thread_pool* pool,
+            Event_queue* events);
+    ~Yank_registers();
+
+    // Yanks count lines from the cursor's down, or size bytes at offset.
+    // Every yank is also left in the unnamed register.
+    void yank_lines(int name, size_t count);
+    void yank(int name, size_t offset, size_t size);
+
+    // Puts a register in count times as one edit. Returns false if it is
+    // empty.
+    bool put(int name, size_t count);
+
+    // Bytes in a register.
+    size_t size(int name) const;
+
+    // Starts a trip to or from the clipboard; the status bar hears how it
+    // went. Returns false if the register is empty or one is under way.
+    bool copy(int name);
+    bool paste();
+
+    // Run on the main thread by the events the jobs post.
+    void copied(Clip_run* run, int error);
+    void pasted(Clip_run* run, const Ref<Buffer_block>& text, int error);
+
+    std::string copy_command, paste_command;
+
+private:
+    void keep(int name, const Yank& yank);
+
+    Yank_registers(const Yank_registers&);
+    Yank_registers& operator=(const Yank_registers&);
+
+    Buffer_view* view;
+    Curses* curses;
+    Thread_pool* pool;
+    Event_queue* events;
+    Yank_map registers;
+    Ref<Clip_run> run;
+    bool busy;
+};
+
+#endif // ROTIDE_REGISTERS_HPP
@@ -0,0 +1,85 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_SAVER_HPP
+#define ROTIDE_SAVER_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/thread.hpp>
+
+#include <cstddef>
+#include <string>
+
+class Curses;
+class Event_queue;
+
+// Writes the buffer out without holding up the editor. save() takes a
+// snapshot, which costs nothing, and a worker streams it into a temporary
+// file next to the target: ranges still in the original file are copied
+// by the kernel with copy_file_range, everything else goes out in large
+// writes. The temporary file then replaces the target with rename(), so
+// the file is always either the old or the new version.
+//
+// Progress and the outcome are posted to the main loop and shown in the
+// status bar. Edits can go on meanwhile; the buffer only counts as saved
+// up to the snapshot that was written.
+//
+// EXAMPLE:
+//  Saver saver(&buffer, &curses, &events);
+//  saver.save("");             // to the buffer's own file
+//
+class Saver : public Thread {
+public:
+    Saver(Buffer* buffer, Curses* curses, Event_queue* events);
+    ~Saver();
+
+    // Starts a save to path, or to the buffer's file if path is empty.
+    // Returns false if a save is already under way or there is nowhere
+    // to save to.
+    bool save(const std::string& path);
+
+    bool busy() const { return running(); }
+
+    // Run on the main thread by the events the worker posts.
+    void progress(size_t bytes);
+    void finish();
+
+protected:
+    void run();
+
+private:
+    bool write_out(int out);
+    bool write_range(int out, const char* data, size_t size);
+    size_t copy_range(int out, int in, size_t offset, size_t size);
+    void advance(size_t bytes);
+
+    Saver(const Saver&);
+    Saver& operator=(const Saver&);
+
+    Buffer* buffer;
+    Curses* curses;
+    Event_queue* events;
+
+    // Only touched by the worker while a save is under way.
+    Buffer_snapshot snapshot;
+    std::string path;
+    size_t done;
+    long reported;
+    int error;
+    unsigned mask;
+};
+
+#endif // ROTIDE_SAVER_HPP
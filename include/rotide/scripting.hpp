@@ -18,6 +18,7 @@
 #define ROTIDE_SCRIPTING_HPP
 
 #include <v8.h>
+#include <rotide/key_ring.hpp>
 #include <rotide/v8/easy.hpp>
 #include <sstream>
 #include <string>
@@ -28,20 +29,33 @@ bool is_ctrl_key(const int key);
 
 class Curses;
 class Curses_pos;
+class Buffer_view;
+class Undo_tree;
+class Saver;
+class Searcher;
+class Grepper;
+class File_index;
+class Syntax_highlighter;
+class Structure_index;
+class Marks;
+class Cursor_set;
+class Word_index;
+class Yank_registers;
+class File_watcher;
 class Key_node;
 
 typedef std::map<int, Key_node> Key_mapping;
 typedef std::map<std::string, Function_list> Function_map;
 typedef std::map<std::string, Function_list> Command_mapping; 
-typedef std::vector<int> Key_list;
-typedef std::vector<Key_list> Key_history;
+typedef std::map<int, Key_list> Register_map;
 typedef std::vector<std::string> Argument_list;
 
 class Scripting_attributes {
 public:
     Scripting_attributes()
-        : insert_mode(false), cmd_mode(false), status("-- WAITING --") { }
-    bool insert_mode, cmd_mode;
+        : insert_mode(false), cmd_mode(false), search_mode(false),
+          status("-- WAITING --") { }
+    bool insert_mode, cmd_mode, search_mode;
     std::string status;
     int status_x;
 };
@@ -252,17 +266,80 @@ public:
     Key_mapping keys;
 };
 
+// What the next key is taken as when a macro or mark command is waiting
+// for the name of its register or mark.
+enum Register_prompt {
+    NO_PROMPT,
+    RECORD_PROMPT,
+    REPLAY_PROMPT,
+    MARK_PROMPT,
+    GO_MARK_PROMPT
+};
+
 class Scripting_engine {
 public:
-    Scripting_engine(Curses* curses);
+    Scripting_engine(Curses* curses, Buffer_view* view, Undo_tree* undo,
+            Saver* saver, Searcher* searcher, Grepper* grepper,
+            File_index* files, Syntax_highlighter* syntax,
+            Structure_index* structure, Marks* marks, Cursor_set* cursors,
+            Word_index* words, Yank_registers* yanks,
+            File_watcher* watcher);
     bool load(const std::string& file);
     void think();
+
+    // Runs a key through the bindings and, in insert mode, into the
+    // buffer. Every key typed or replayed comes through here. Outside of
+    // insert mode every command is its own undo step; a visit to insert
+    // mode is one step and so is a whole replay.
+    void feed(int key);
+
+    // Inserts pasted text at the cursors as one edit and one undo step.
+    void paste(const std::string& text);
+
+    // Macros: keys fed between record() and stop_recording() are kept in
+    // a register, and replay() feeds them again with drawing held until
+    // the last repetition is done. A register of 0 takes the next key as
+    // its name.
+    //
+    // EXAMPLE:
+    //  engine.record('a');
+    //  ... keys ...
+    //  engine.stop_recording();
+    //  engine.replay('a', 10000);
+    //
+    bool record(int reg);
+    void stop_recording();
+    bool replay(int reg, int count);
+    bool recording() const { return recording_register != 0; }
+
+    // Marks the cursor's place, or goes to a mark. A name of 0 takes the
+    // next key as the name.
+    bool mark(int name);
+    bool go_mark(int name);
+
+    // Opens the search prompt. What is typed at it is searched for right
+    // away, Enter stays on the match and Esc goes back to where the
+    // cursor was.
+    void prompt_search();
     
     v8::Handle<v8::ObjectTemplate> global;      // Global scope
     v8::Persistent<v8::Object> object;          // Engine namespace
     v8::Persistent<v8::FunctionTemplate> tmpl;  // Function template
     v8::Persistent<v8::Context> context;        // Engine context
     Curses* curses;
+    Buffer_view* view;
+    Undo_tree* undo;
+    Saver* saver;
+    Searcher* searcher;
+    Grepper* grepper;
+    File_index* files;
+    Syntax_highlighter* syntax;
+    Structure_index* structure;
+    Marks* marks;
+    Cursor_set* cursors;
+    Word_index* words;
+    Yank_registers* yanks;
+    File_watcher* watcher;
     Curses_pos* active_pos;
     Key_engine bindings;
     bool good;
@@ -270,20 +347,34 @@ public:
     const std::string& status() { return attrs.status; }
 private:
     void handle_key_combination();
+    void type_search(int key);
+    std::string typed() const;
+    void remember(int key);
+    void take_register(int key);
+    void run_replay();
     Scripting_attributes attrs;
     Key_list key_combination;
-    Key_history key_history;
+    Key_ring key_history;
+    size_t search_from;
+    bool key_taken;
+
+    Register_map registers;
+    Register_prompt prompt;
+    int recording_register;
+    int replay_register, replay_count, replay_depth;
 public:
     DEFINE(Scripting_engine)
     {
         FUNCTION(test);
         FUNCTION(bind);
         FUNCTION(command);
+        FUNCTION(history);
         ACCESSOR(insert_mode);
         ACCESSOR(cmd_mode);
         ACCESSOR(status);
         ACCESSOR(mx);
         ACCESSOR(my);
+        ACCESSOR(history_size);
 
         // The fun stuff
         ACCESSOR_GETTER(CTRL_A);
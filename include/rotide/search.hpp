@@ -0,0 +1,63 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_SEARCH_HPP
+#define ROTIDE_SEARCH_HPP
+
+#include <rotide/buffer.hpp>
+
+#include <cstddef>
+#include <string>
+
+// Finds a literal string in a snapshot, reading its pieces in place. The
+// scan looks for the byte of the pattern that is likely to be rarest
+// with memchr, which runs over the data with vector instructions, and
+// only compares the whole pattern where that byte turns up. A match may
+// span any number of pieces.
+//
+// EXAMPLE:
+//  Literal_search search("needle");
+//  size_t at;
+//  if (search.forward(buffer.snapshot(), 0, buffer.size(), &at))
+//      view.set_offset(at);
+//
+class Literal_search {
+public:
+    explicit Literal_search(const std::string& pattern);
+
+    // The first match starting in [from, end).
+    bool forward(const Buffer_snapshot& snapshot, size_t from, size_t end,
+            size_t* at) const;
+
+    // The last match starting in [begin, before).
+    bool backward(const Buffer_snapshot& snapshot, size_t begin,
+            size_t before, size_t* at) const;
+
+    // The first match in a run of memory, or NULL.
+    const char* find(const char* begin, const char* end) const;
+
+    const std::string& pattern() const { return needle; }
+    size_t size() const { return needle.size(); }
+
+private:
+    bool scan(const Buffer_snapshot& snapshot, size_t from, size_t end,
+            bool last, size_t* at) const;
+
+    std::string needle;
+    size_t rare;
+};
+
+#endif // ROTIDE_SEARCH_HPP
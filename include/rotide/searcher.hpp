@@ -0,0 +1,156 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_SEARCHER_HPP
+#define ROTIDE_SEARCHER_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/ref.hpp>
+#include <rotide/view.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Event_queue;
+class Thread_pool;
+
+typedef Buffer_range Search_match;
+typedef Range_list Match_list;
+
+// One run of a pattern over a snapshot, shared by the jobs working on it.
+// Chunk i is [starts[i], starts[i + 1]) and holds the matches that start
+// in it; those of a literal are looked for past its end, and those of a
+// regular expression to the end of the next line, since a bracket
+// expression can match a newline. The chunks of a literal are all the
+// same size; those of a regular expression end with a line where it is
+// not too long. A chunk's matches are only read once it is done.
+struct Search_scan {
+    Search_scan(const Buffer_snapshot& snapshot, const std::string& pattern,
+            bool regex);
+
+    size_t chunk_of(size_t offset) const;
+
+    int refs;
+    Buffer_snapshot snapshot;
+    std::string pattern;
+    bool regex;
+
+    std::vector<size_t> starts;
+    std::vector<Match_list> matches;
+    std::vector<int> done;
+    int cancelled;
+};
+
+// Finds every match of a pattern in the buffer, using all the cores. The
+// buffer is cut into chunks that are matched on the thread pool, starting
+// from the one under the cursor, and each is handed to the main loop as
+// soon as it is done. Moving to a match only waits for the chunks between
+// the cursor and that match, so the first match shows up while the rest
+// of a big file is still being searched.
+//
+// Patterns are literal text or POSIX extended regular expressions. An
+// edit makes the matches stale; they are dropped and the next search
+// starts over. The matches on screen are highlighted.
+//
+// A literal pattern can also be searched for while it is typed. Every
+// scan made since the prompt opened is kept, so a pattern that extends an
+// earlier one only checks the rest of it where the earlier one matched,
+// and taking a character back finds the shorter pattern's matches again
+// without searching at all. Each key cancels the scan before it.
+//
+// EXAMPLE:
+//  Searcher searcher(&view, &pool, &events);
+//  searcher.start("err(or)?", true, &error);
+//  ...
+//  searcher.next(false);
+//
+//  searcher.type("e");
+//  searcher.type("er");
+//  searcher.accept();
+//
+class Searcher : public Buffer_listener, public Highlighter {
+public:
+    Searcher(Buffer_view* view, Thread_pool* pool, Event_queue* events);
+    ~Searcher();
+
+    // Starts a search and moves to the first match after the cursor once
+    // it is found. Returns false, with the reason in error, if the
+    // pattern is not a valid regular expression.
+    bool start(const std::string& pattern, bool regex, std::string* error);
+
+    // Moves to the next or previous match from the cursor, wrapping
+    // around. Returns false if there is no search.
+    bool next(bool backward);
+
+    // Every match of a pattern, in order. The search for it is reused if
+    // it is the one running; otherwise one is started. Either way this
+    // waits for the chunks that are not done, with the whole thread pool
+    // still working on them. The matches are handed over, which ends the
+    // search; this is meant for editing all of them.
+    bool collect(const std::string& pattern, bool regex, Match_list* matches,
+            std::string* error);
+
+    // The search prompt: type() searches for the pattern typed so far from
+    // where the prompt was opened. accept() keeps the match it landed on,
+    // abandon() drops the search and goes back.
+    void type(const std::string& pattern);
+    void accept();
+    void abandon();
+
+    void cancel();
+
+    bool active() const { return !scan.empty(); }
+    bool complete() const;
+    const std::string& pattern() const { return last_pattern; }
+
+    // Matches found so far.
+    size_t count() const;
+
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+    void highlight(size_t begin, size_t end, Highlight_list* highlights);
+
+    // Run on the main thread when a chunk is done.
+    void delivered(Search_scan* scan, size_t chunk);
+
+private:
+    bool jump();
+    void report(const Search_match& match);
+    void submit(const Ref<Search_scan>& base);
+
+    Searcher(const Searcher&);
+    Searcher& operator=(const Searcher&);
+
+    Buffer_view* view;
+    Thread_pool* pool;
+    Event_queue* events;
+
+    Ref<Search_scan> scan;
+    std::string last_pattern;
+    bool last_regex;
+
+    // A move that is waiting for chunks to be done.
+    bool waiting, backward;
+    size_t origin;
+
+    // The prompt's scans, each pattern a prefix of the next, and where
+    // the cursor was when it opened.
+    std::vector<Ref<Search_scan> > typed;
+    bool typing;
+    size_t home;
+};
+
+#endif // ROTIDE_SEARCHER_HPP
@@ -0,0 +1,147 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_STRUCTURE_HPP
+#define ROTIDE_STRUCTURE_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/ref.hpp>
+#include <rotide/view.hpp>
+
+#include <cstddef>
+#include <vector>
+
+class Event_queue;
+class Thread_pool;
+
+enum Bracket_kind {
+    BRACKET_ROUND = 0,
+    BRACKET_SQUARE,
+    BRACKET_CURLY,
+    BRACKET_KINDS
+};
+
+// How the depth of one kind of bracket changes over a run of text: by
+// sum in all, and by low at the lowest point along the way.
+struct Bracket_depth {
+    int sum, low;
+};
+
+// What the index knows about a run of text: the brackets in it, and the
+// least indentation of the lines that start in it and are not blank.
+struct Structure_summary {
+    Bracket_depth brackets[BRACKET_KINDS];
+    int indent;
+};
+
+// A run of text and its summary, as the index is first built.
+struct Structure_piece {
+    size_t length;
+    Structure_summary summary;
+};
+
+typedef std::vector<Structure_piece> Structure_piece_list;
+
+// The first build of an index, which is cancelled if the buffer is
+// switched away from.
+struct Structure_run {
+    Structure_run() : refs(0), cancelled(0) { }
+
+    int refs;
+    int cancelled;
+};
+
+struct Structure_chunk;
+
+// An index of a buffer's brackets and indentation, for jumping to the
+// bracket that matches the one under the cursor, marking that pair on
+// the screen, and folding a block away.
+//
+// The buffer is cut into chunks of a few kilobytes held in a treap by
+// offset, like the lines of the wrap layout. Each node sums up its
+// subtree, so the match of a bracket is found by walking down from the
+// root past every subtree whose brackets cannot close it: two chunks are
+// read at most, however far apart the pair is. The end of an indented
+// block is found the same way. An edit only reads again the chunks it
+// touches and one on either side.
+//
+// The first build reads the whole buffer in a job on the thread pool;
+// edits made meanwhile are kept and played over it when it comes back.
+// Brackets in strings and comments are counted like any other.
+//
+// EXAMPLE:
+//  Structure_index structure(&view, &pool, &events);
+//  structure.jump();               // % from the cursor
+//  structure.fold();               // hides the block the cursor is on
+//
+class Structure_index : public Buffer_listener, public Highlighter {
+public:
+    Structure_index(Buffer_view* view, Thread_pool* pool,
+            Event_queue* events);
+    ~Structure_index();
+
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+    void highlight(size_t begin, size_t end, Highlight_list* highlights);
+
+    // Whether the first build is done. A binary buffer is never indexed.
+    bool ready() const { return run.empty() && !buffer->binary; }
+
+    // The bracket at offset, or the first one after it on its line, and
+    // the one matching it. Returns false if there is none.
+    bool match(size_t offset, size_t* bracket, size_t* other);
+
+    // The lines under line that a fold there hides: those inside the
+    // bracket opened last on it, or else those indented further than it.
+    bool block(size_t line, size_t* first, size_t* last);
+
+    // Moves the cursor to the match of the bracket under it.
+    bool jump();
+
+    // Folds the block under the cursor's line.
+    bool fold();
+
+    // Takes in the first build. Run on the main thread.
+    void built(Structure_run* run, Structure_piece_list* pieces);
+
+private:
+    void start();
+    void apply(const Buffer_edit& edit, const Buffer_snapshot& after);
+    size_t forward(int kind, size_t from);
+    size_t backward(int kind, size_t from);
+    size_t dedent(size_t from, int indent);
+    bool opened_last(size_t line, size_t* offset, int* kind);
+
+    Structure_index(const Structure_index&);
+    Structure_index& operator=(const Structure_index&);
+
+    Buffer_view* view;
+    Buffer* buffer;
+    Thread_pool* pool;
+    Event_queue* events;
+    Structure_chunk* root;
+
+    // The first build, while it runs, and the edits made meanwhile.
+    Ref<Structure_run> run;
+    std::vector<Buffer_edit> pending;
+
+    // The pair marked last, for the cursor and generation it was for.
+    size_t marked_cursor, marked[2];
+    unsigned long marked_generation;
+    bool marking;
+    int mark_attr;
+};
+
+#endif // ROTIDE_STRUCTURE_HPP
@@ -0,0 +1,234 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_SYNTAX_HPP
+#define ROTIDE_SYNTAX_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/ref.hpp>
+#include <rotide/view.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <regex.h>
+
+class Event_queue;
+class Thread_pool;
+
+// What a grammar can call a piece of text. Each is drawn in a color of
+// its own.
+enum Syntax_style {
+    STYLE_PLAIN = 0,
+    STYLE_KEYWORD,
+    STYLE_TYPE,
+    STYLE_STRING,
+    STYLE_NUMBER,
+    STYLE_COMMENT,
+    STYLE_PREPROCESSOR,
+    STYLE_CONSTANT,
+    STYLE_FUNCTION,
+    STYLE_COUNT
+};
+
+// The style with that name, such as "keyword", or -1.
+int syntax_style(const std::string& name);
+
+// A pattern, what text it matches is styled as and the state the lexer
+// goes to after it, or -1 to stay.
+struct Grammar_rule {
+    std::string pattern;
+    regex_t* regex;
+    int style;
+    int next;
+};
+
+typedef std::vector<Grammar_rule> Grammar_rule_list;
+
+// Text none of a state's rules match gets the state's own style, so a
+// block comment is a state whose only rule ends it.
+struct Grammar_state {
+    std::string name;
+    int style;
+    Grammar_rule_list rules;
+};
+
+typedef std::vector<Grammar_state> Grammar_state_list;
+
+// A set of states the lexer moves between, each a list of extended
+// regular expressions. Lexing starts in the state named "start". Once
+// built a grammar is never changed, so it can be shared.
+//
+// EXAMPLE:
+//  Ref<Grammar> c(new Grammar("c"));
+//  c->extensions.push_back(".c");
+//  int start = c->state("start"), comment = c->state("comment");
+//  c->add_rule(start, "/\\*", STYLE_COMMENT, comment, &error);
+//  c->add_rule(comment, "\\*/", STYLE_COMMENT, start, &error);
+//  c->states[comment].style = STYLE_COMMENT;
+//
+struct Grammar {
+    explicit Grammar(const std::string& name);
+    ~Grammar();
+
+    // The index of the state with that name, made if it is new.
+    int state(const std::string& name);
+
+    // The state named "start", or the first one.
+    int initial() const;
+
+    // Returns false, with the reason in error, if the pattern is no good.
+    bool add_rule(int state, const std::string& pattern, int style,
+            int next, std::string* error);
+
+    // Whether a file at path is written in this grammar, by its
+    // extension.
+    bool matches(const std::string& path) const;
+
+    // The same grammar with its patterns compiled again. glibc takes a
+    // lock inside each compiled pattern while matching, so a grammar
+    // lexed on two threads at once is better off as two.
+    Grammar* duplicate() const;
+
+    int refs;
+    std::string name;
+    std::vector<std::string> extensions;
+    Grammar_state_list states;
+
+private:
+    Grammar(const Grammar&);
+    Grammar& operator=(const Grammar&);
+};
+
+// A run of a line, by its offset in the line.
+struct Syntax_span {
+    Syntax_span(size_t offset, size_t length, int style)
+        : offset(offset), length(length), style(style) { }
+
+    size_t offset, length;
+    int style;
+};
+
+typedef std::vector<Syntax_span> Syntax_span_list;
+
+// Lexes one line, without its newline, starting in state. The styled
+// runs are added to spans unless it is NULL. Returns the state the line
+// ends in.
+int lex_line(const Grammar& grammar, int state, const char* text,
+        size_t size, Syntax_span_list* spans);
+
+struct Lex_batch;
+
+// Line states on their way from the lexing jobs to the main thread.
+// Jobs push batches onto the list with a compare-and-swap and the main
+// thread takes the whole list in one swap, so neither ever waits for
+// the other. signalled is set while a wake-up is on its way.
+struct Lex_inbox {
+    Lex_inbox() : refs(0), head(NULL), signalled(0) { }
+    ~Lex_inbox();
+
+    int refs;
+    Lex_batch* head;
+    int signalled;
+};
+
+// One job lexing a snapshot, until it reaches the end or is cancelled.
+struct Lex_run {
+    Lex_run() : refs(0), cancelled(0) { }
+
+    int refs;
+    int cancelled;
+};
+
+// Colors the buffer of a view by the grammar for its file.
+//
+// The state the lexer is in at the start of each line is cached. An
+// edit only throws out the states from the line it is on, and lexing
+// picks up from there until a line ends in the state it was cached with
+// past the edit; from then on the cache is right again.
+//
+// Lexing happens in a job on the thread pool, over a snapshot of the
+// buffer, from the first line whose state is not known to the end. The
+// job hands back the states in batches, small ones first, and the
+// screen is drawn again as they come in. The screen never waits for it:
+// a visible line a little past the known states is lexed on the spot,
+// and one further on is drawn from the state it had before the edit, or
+// the start state, until the job gets there. Typing in the middle of a
+// long file re-lexes a line or two right away.
+//
+// EXAMPLE:
+//  Syntax_highlighter syntax(&view, &pool, &events);
+//  syntax.add(grammar);   // picked if it fits the buffer's file
+//
+class Syntax_highlighter : public Highlighter, public Buffer_listener {
+public:
+    Syntax_highlighter(Buffer_view* view, Thread_pool* pool,
+            Event_queue* events);
+    ~Syntax_highlighter();
+
+    // Grammars added later win over earlier ones for the same file.
+    void add(const Ref<Grammar>& grammar);
+    const Grammar* grammar() const { return current.get(); }
+
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+    void highlight(size_t begin, size_t end, Highlight_list* highlights);
+
+    // Takes in what the lexing jobs have handed back. Run on the main
+    // thread by the event they post.
+    void receive();
+
+    // Whether every line's state is known.
+    bool settled() const;
+
+private:
+    void select();
+    void cancel();
+    void schedule();
+    void merge(const Lex_batch& batch);
+    bool settle(size_t line);
+    const Syntax_span_list& spans(size_t line);
+
+    Syntax_highlighter(const Syntax_highlighter&);
+    Syntax_highlighter& operator=(const Syntax_highlighter&);
+
+    Buffer_view* view;
+    Buffer* buffer;
+    Thread_pool* pool;
+    Event_queue* events;
+    std::vector<Ref<Grammar> > grammars;
+    Ref<Grammar> current;
+    Ref<Grammar> background;
+    int attrs[STYLE_COUNT];
+
+    // The state at the start of each line lexed so far. The ones from
+    // dirty on may be out of date, and the ones up to stale certainly
+    // are.
+    std::vector<int> states;
+    size_t dirty, stale;
+
+    // Batches come back from every job through the one inbox; only
+    // those of the job still running are taken in.
+    Ref<Lex_inbox> inbox;
+    Ref<Lex_run> job;
+
+    // The runs of the line drawn last, which usually takes a few rows.
+    size_t spans_line;
+    unsigned long spans_generation;
+    Syntax_span_list line_spans;
+};
+
+#endif // ROTIDE_SYNTAX_HPP
@@ -0,0 +1,173 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_THREAD_HPP
+#define ROTIDE_THREAD_HPP
+
+#include <pthread.h>
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+// Thin wrappers around pthreads for the work that happens off the main
+// loop: journaling, saving and searching. Workers only ever read buffer
+// snapshots, which are immutable, so these are mostly used for handing
+// work and results back and forth.
+
+class Mutex {
+public:
+    Mutex() { pthread_mutex_init(&mutex, NULL); }
+    ~Mutex() { pthread_mutex_destroy(&mutex); }
+
+    void lock() { pthread_mutex_lock(&mutex); }
+    void unlock() { pthread_mutex_unlock(&mutex); }
+
+    pthread_mutex_t mutex;
+
+private:
+    Mutex(const Mutex&);
+    Mutex& operator=(const Mutex&);
+};
+
+// Holds a mutex for as long as it is in scope.
+//
+// EXAMPLE:
+//  {
+//      Lock lock(mutex);
+//      queue.push_back(work);
+//  }
+//
+class Lock {
+public:
+    explicit Lock(Mutex& mutex) : mutex(mutex) { mutex.lock(); }
+    ~Lock() { mutex.unlock(); }
+
+private:
+    Lock(const Lock&);
+    Lock& operator=(const Lock&);
+
+    Mutex& mutex;
+};
+
+class Condition {
+public:
+    Condition() { pthread_cond_init(&condition, NULL); }
+    ~Condition() { pthread_cond_destroy(&condition); }
+
+    // The mutex has to be held; it is released while waiting.
+    void wait(Mutex& mutex) { pthread_cond_wait(&condition, &mutex.mutex); }
+
+    // Like wait, but gives up after ms milliseconds. Returns false if it
+    // timed out.
+    bool wait(Mutex& mutex, int ms);
+
+    void signal() { pthread_cond_signal(&condition); }
+    void broadcast() { pthread_cond_broadcast(&condition); }
+
+private:
+    Condition(const Condition&);
+    Condition& operator=(const Condition&);
+
+    pthread_cond_t condition;
+};
+
+// A thread running a subclass's run(). join() has to be called before
+// the subclass goes away.
+//
+// EXAMPLE:
+//  class Worker : public Thread {
+//      void run() { ... }
+//  };
+//  Worker worker;
+//  worker.start();
+//  ...
+//  worker.join();
+//
+class Thread {
+public:
+    Thread() : started(false) { }
+    virtual ~Thread() { }
+
+    bool start();
+    void join();
+    bool running() const { return started; }
+
+protected:
+    virtual void run() = 0;
+
+private:
+    static void* trampoline(void* self);
+
+    Thread(const Thread&);
+    Thread& operator=(const Thread&);
+
+    pthread_t thread;
+    bool started;
+};
+
+// A piece of work for a Thread_pool.
+class Job {
+public:
+    virtual ~Job() { }
+    virtual void run() = 0;
+};
+
+typedef std::deque<Job*> Job_queue;
+
+// A fixed set of threads, one per core unless told otherwise, running
+// jobs in the order they were submitted. Jobs still queued when the pool
+// goes away are dropped; the ones running are finished first.
+//
+// EXAMPLE:
+//  Thread_pool pool;
+//  pool.submit(new Chunk_job(scan, 0));
+//
+class Thread_pool {
+public:
+    explicit Thread_pool(size_t threads = 0);
+    ~Thread_pool();
+
+    // Takes ownership of the job.
+    void submit(Job* job);
+
+    size_t size() const { return workers.size(); }
+
+private:
+    class Worker : public Thread {
+    public:
+        explicit Worker(Thread_pool* pool) : pool(pool) { }
+
+    protected:
+        void run();
+
+    private:
+        Thread_pool* pool;
+    };
+
+    typedef std::vector<Worker*> Worker_list;
+
+    Thread_pool(const Thread_pool&);
+    Thread_pool& operator=(const Thread_pool&);
+
+    Mutex mutex;
+    Condition ready;
+    Job_queue jobs;
+    Worker_list workers;
+    bool stopping;
+};
+
+#endif // ROTIDE_THREAD_HPP
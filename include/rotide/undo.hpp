@@ -0,0 +1,138 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_UNDO_HPP
+#define ROTIDE_UNDO_HPP
+
+#include <rotide/buffer.hpp>
+
+#include <cstddef>
+#include <vector>
+
+struct Undo_node;
+class Undo_journal;
+typedef std::vector<Undo_node*> Undo_node_list;
+
+// One state of the document in the undo tree. The snapshot shares all
+// but the O(log n) nodes an edit touched with its neighbours, so keeping
+// a state costs about as much as the edit that made it.
+//
+// [offset, offset + removed) of the parent's document was replaced by
+// [offset, offset + inserted) of this one; everything else is the same.
+//
+// Steps are named by their sequence number within the session that made
+// them. A session of 0 is the current one.
+struct Undo_node {
+    Undo_node(Undo_node* parent, const Buffer_snapshot& snapshot,
+            unsigned long sequence);
+
+    Undo_node* parent;
+    Undo_node_list children;
+    size_t active;
+
+    Buffer_snapshot snapshot;
+    size_t offset, removed, inserted;
+    unsigned long session, sequence;
+    size_t cost;
+};
+
+// The undo tree listens to a buffer and turns its edits into steps. All
+// edits between two checkpoints make a single step, so one command or one
+// visit to insert mode is undone at once.
+//
+// Undoing after a change and then changing something else starts a new
+// branch; the old one stays reachable with branch(). When the steps take
+// more than the memory budget, branches that are not on the way to the
+// current state go first, oldest first, and then the oldest history.
+//
+// EXAMPLE:
+//  Undo_tree undo(&buffer);
+//  buffer.insert(0, "Hello");
+//  undo.checkpoint();
+//  undo.undo();    // the buffer is empty again
+//  undo.redo();    // and says Hello
+//
+class Undo_tree : public Buffer_listener {
+public:
+    explicit Undo_tree(Buffer* buffer);
+    ~Undo_tree();
+
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+
+    // Tells the journal which state the file holds, if it is the
+    // current one.
+    void written(Buffer* buffer);
+
+    // Ends the current step.
+    void checkpoint();
+
+    // Throws the history away; the current contents become the root.
+    void reset();
+
+    // Steps back or forward. offset, if given, is where the change
+    // starts, which is where the cursor belongs afterwards.
+    bool undo(size_t* offset = NULL);
+    bool redo(size_t* offset = NULL);
+
+    // Picks which of the current state's branches redo follows, counting
+    // from the one that is followed now. Branches are in the order they
+    // were made.
+    bool branch(int delta);
+
+    // Number of branches redo can choose from.
+    size_t branches() const { return current->children.size(); }
+
+    void set_budget(size_t bytes);
+    size_t budget() const { return limit; }
+
+    // Memory the steps are estimated to hold on to.
+    size_t cost() const { return total; }
+
+    // The oldest state that is still kept, and the one the buffer is in.
+    const Undo_node* top() const { return root; }
+    const Undo_node* state() const { return current; }
+
+    // Puts an older state above the top. The old top is what replacing
+    // [offset, offset + removed) of the snapshot with inserted bytes
+    // gives. The journal uses this to bring back earlier sessions.
+    void prepend(const Buffer_snapshot& snapshot, size_t offset,
+            size_t removed, size_t inserted,
+            unsigned long session, unsigned long sequence);
+
+    Buffer* buffer;
+
+    // Finished steps are handed to the journal, if there is one, and the
+    // journal is asked for more when undo runs out.
+    Undo_journal* journal;
+
+private:
+    void close();
+    void restore(Undo_node* node, size_t offset, size_t removed,
+            size_t inserted);
+    void prune();
+    void destroy(Undo_node* node);
+
+    Undo_tree(const Undo_tree&);
+    Undo_tree& operator=(const Undo_tree&);
+
+    Undo_node* root;
+    Undo_node* current;
+    bool open, restoring;
+    unsigned long sequence;
+    size_t limit, total;
+};
+
+#endif // ROTIDE_UNDO_HPP
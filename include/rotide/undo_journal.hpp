@@ -0,0 +1,122 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_UNDO_JOURNAL_HPP
+#define ROTIDE_UNDO_JOURNAL_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/thread.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class Undo_tree;
+struct Undo_node;
+
+// What the writer thread is asked to put in the journal. Steps carry the
+// snapshots on both sides of them; the text is only pulled out of those
+// on the writer thread.
+struct Journal_record {
+    Journal_record()
+        : type(0), session(0), sequence(0),
+          parent_session(0), parent_sequence(0),
+          offset(0), removed(0), inserted(0),
+          size(0), seconds(0), nanoseconds(0) { }
+
+    int type;
+    unsigned long session, sequence;
+    unsigned long parent_session, parent_sequence;
+    size_t offset, removed, inserted;
+    Buffer_snapshot before, after;
+    unsigned long size, seconds, nanoseconds;
+};
+
+typedef std::vector<Journal_record> Journal_queue;
+
+// The undo journal keeps the undo history of a file across restarts. It
+// sits next to the file as .<name>.undo and is only ever appended to:
+//
+//  "RUJ1" record*
+//  record = type [length] payload
+//  step   = [session] [sequence] [parent session] [parent sequence]
+//           [offset] [removed] removed-bytes [inserted] inserted-bytes
+//  anchor = [session] [sequence] [file size] [mtime s] [mtime ns]
+//
+// with every [field] a varint. A session is named by the size of the
+// journal when it started, so names never clash. An anchor says that a
+// step has the contents the file had with that size and mtime; one is
+// written for the state a session starts from, and one whenever the
+// buffer is written out.
+//
+// Records are written by a background thread so the main loop never
+// waits for the disk, and the journal is only made once the first step
+// is finished. Nothing is read until undo runs out of history in the
+// current session; then the records of older sessions are read once and
+// the history leading up to the opened file is put above the root, the
+// text of each step read as it is put back.
+//
+// EXAMPLE:
+//  Undo_tree undo(&buffer);
+//  Undo_journal journal(&undo);
+//
+class Undo_journal : public Thread {
+public:
+    explicit Undo_journal(Undo_tree* tree);
+    ~Undo_journal();
+
+    // False if nothing is recorded this session. A journal that is yet
+    // to be made is good.
+    bool good() const { return writable; }
+
+    // A step is finished and can be written.
+    void closed(const Undo_node* node);
+
+    // The buffer matches the file on disk again, in the state of node.
+    void anchor(const Undo_node* node);
+
+    // Brings in the history of earlier sessions above the tree's top. Only
+    // the first call does anything.
+    void load();
+
+    // Where the journal of a file lives.
+    static std::string path_for(const std::string& file);
+
+protected:
+    void run();
+
+private:
+    bool begin();
+    void push(const Journal_record& record);
+    bool stat_file(unsigned long* size, unsigned long* seconds,
+            unsigned long* nanoseconds) const;
+
+    Undo_journal(const Undo_journal&);
+    Undo_journal& operator=(const Undo_journal&);
+
+    Undo_tree* tree;
+    int fd;
+    unsigned long session, root_sequence;
+    unsigned long root_size, root_seconds, root_nanoseconds;
+    bool loaded, writable;
+
+    Mutex mutex;
+    Condition ready;
+    Journal_queue queue;
+    bool stopping;
+};
+
+#endif // ROTIDE_UNDO_JOURNAL_HPP
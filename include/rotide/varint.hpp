@@ -0,0 +1,74 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_VARINT_HPP
+#define ROTIDE_VARINT_HPP
+
+#include <cstddef>
+
+// Variable-length integers: seven bits a byte, low bits first, with the
+// high bit set on every byte but the last. Small numbers, which is what
+// keys, lengths and most offsets are, take a byte or two.
+//
+// EXAMPLE:
+//  unsigned char buf[MAX_VARINT];
+//  unsigned char* end = put_varint(300, buf);     // 2 bytes
+//  unsigned long value;
+//  get_varint(buf, end, &value);                  // value == 300
+//
+
+// Longest encoding of an unsigned long.
+const size_t MAX_VARINT = (sizeof(unsigned long) * 8 + 6) / 7;
+
+inline size_t varint_size(unsigned long value)
+{
+    size_t size = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+    }
+    return size;
+}
+
+// Writes a value and returns the end of what was written.
+inline unsigned char* put_varint(unsigned long value, unsigned char* out)
+{
+    while (value >= 0x80) {
+        *out++ = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = (unsigned char)value;
+    return out;
+}
+
+// Reads a value and returns the end of it, or NULL if the input ends in
+// the middle of one.
+inline const unsigned char* get_varint(const unsigned char* in,
+        const unsigned char* end, unsigned long* value)
+{
+    unsigned long result = 0;
+    for (int shift = 0; in != end && shift < (int)MAX_VARINT * 7; shift += 7) {
+        unsigned char byte = *in++;
+        result |= (unsigned long)(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return in;
+        }
+    }
+    return NULL;
+}
+
+#endif // ROTIDE_VARINT_HPP
@@ -0,0 +1,166 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_VIEW_HPP
+#define ROTIDE_VIEW_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/wrap.hpp>
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+class Curses;
+
+// A run of text drawn with a curses attribute, such as A_REVERSE.
+struct Highlight {
+    Highlight(size_t offset, size_t length, int attr)
+        : offset(offset), length(length), attr(attr) { }
+
+    size_t offset, length;
+    int attr;
+};
+
+typedef std::vector<Highlight> Highlight_list;
+
+// Marks up the text on the screen. A highlighter is only ever asked about
+// what is visible, one screen row at a time, so it never has to look at
+// the rest of the buffer while drawing.
+class Highlighter {
+public:
+    virtual ~Highlighter() { }
+
+    // Adds the runs that overlap [begin, end).
+    virtual void highlight(size_t begin, size_t end,
+            Highlight_list* highlights) = 0;
+};
+
+typedef std::vector<Highlighter*> Highlighter_list;
+
+// The first and last line of each fold, by the first.
+typedef std::map<size_t, size_t> Fold_map;
+
+// A Buffer_view puts a buffer on the screen. It owns the cursor, the
+// first visible row and the soft-wrap layout of the buffer for the width
+// of the active window.
+//
+// It can also show the buffer as a hex dump, which binary buffers always
+// are. Rows are then a fixed number of bytes, so the offset of any row
+// is a multiplication: nothing is laid out or measured, and only the
+// bytes on the screen are read and formatted. Motion walks bytes and
+// rows of bytes.
+//
+// EXAMPLE:
+//  Buffer_view view(&curses, &buffer);
+//  view.insert("Hello, world!", 13);
+//  view.move_rows(-1);
+//  view.draw();
+//
+class Buffer_view : public Buffer_listener {
+public:
+    Buffer_view(Curses* curses, Buffer* buffer);
+    ~Buffer_view();
+
+    // Keeps the layout, cursor and scroll position in step with edits.
+    void edited(Buffer* buffer, const Buffer_edit& edit);
+
+    // Draws the visible rows into the active window and places the cursor.
+    void draw();
+
+    // Puts another buffer in the view, with the cursor at its top.
+    void show(Buffer* other);
+
+    // Highlighters added later are drawn on top of earlier ones.
+    void add_highlighter(Highlighter* highlighter);
+    void remove_highlighter(Highlighter* highlighter);
+
+    // Typing at the cursor.
+    void insert(const char* data, size_t size);
+    void backspace();
+
+    // Replaces the bytes under the cursor, going on past the end if need
+    // be, and moves the cursor after them. The new bytes are a piece over
+    // the old ones, so a byte changed in a huge file costs O(log n).
+    void overwrite(const char* data, size_t size);
+
+    // Shows the buffer as a hex dump, or as text again. Binary buffers
+    // have no lines to show as text, so turning hex off for one fails.
+    bool set_hex(bool on);
+    bool hex() const { return hex_mode; }
+
+    // Vertical motion walks visual rows and tries to stay in the same
+    // screen column; horizontal motion walks characters within the line.
+    void move_rows(long rows);
+    void move_columns(long columns);
+
+    void set_line(size_t line);
+    void set_column(size_t column);
+    void set_offset(size_t offset);
+
+    // Line of the cursor and its byte column in that line.
+    size_t line() const;
+    size_t column() const;
+
+    // A fold hides lines [first, last] under the line in front of them,
+    // which is drawn with a count of what it holds. Closed folds inside
+    // a new one are taken into it; a fold that would cut through one,
+    // or start under one, is refused. Editing a folded line or moving
+    // the cursor onto one opens its fold.
+    //
+    // EXAMPLE:
+    //  view.fold(11, 40);      // line 10 stands for lines 11 to 40
+    //  view.unfold(10);
+    //
+    bool fold(size_t first, size_t last);
+
+    // Opens the fold under line, or the one holding it.
+    bool unfold(size_t line);
+    void unfold_all();
+
+    // The fold that hides line, if there is one.
+    bool folded(size_t line, size_t* first, size_t* last) const;
+
+    Curses* curses;
+    Buffer* buffer;
+    Wrap_layout layout;
+    size_t cursor;
+
+private:
+    void fit();
+    void follow_cursor();
+    void draw_hex();
+    size_t hex_width() const;
+    size_t last_byte() const;
+    void highlight(size_t offset, size_t size, std::vector<int>* attrs);
+    size_t offset_at_cell(size_t line, size_t row, int cell);
+    int cell_of(size_t line, size_t row, size_t offset);
+    size_t shown(size_t line) const;
+
+    Buffer_view(const Buffer_view&);
+    Buffer_view& operator=(const Buffer_view&);
+
+    size_t top_line, top_row;
+    int rows, columns, goal;
+
+    // Whether the hex dump is shown, and the offset of its first row.
+    bool hex_mode;
+    size_t hex_top;
+    Highlighter_list highlighters;
+    Fold_map folds;
+};
+
+#endif // ROTIDE_VIEW_HPP
@@ -0,0 +1,166 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef ROTIDE_WATCHER_HPP
+#define ROTIDE_WATCHER_HPP
+
+#include <rotide/buffer.hpp>
+#include <rotide/diff.hpp>
+#include <rotide/ref.hpp>
+#include <rotide/thread.hpp>
+
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+class Buffer_view;
+class Curses;
+class Event_queue;
+class Saver;
+class Undo_tree;
+
+typedef std::vector<std::string> File_name_list;
+typedef std::vector<Ref<Buffer_block> > Block_list;
+
+// A reload being worked out on the thread pool, which is cancelled when
+// the watcher goes away.
+struct Reload_run {
+    Reload_run() : refs(0), cancelled(0) { }
+
+    int refs;
+    int cancelled;
+};
+
+// Watches the buffer's file for other programs writing to it and takes
+// in what they wrote. The directory is watched with inotify rather than
+// the file, so a file replaced by a rename is followed too.
+//
+// A reload maps the file on the thread pool and diffs it against the
+// buffer (see diff()), and only the hunks that changed are edited in, as
+// one undo step. Cursors, marks and the undo history are left as they
+// were around everything else, and a big file that was appended to
+// costs what was appended. Changed bytes are copied out of the new
+// mapping when there are few of them, so the buffer is not left pinning
+// an unindexed mapping for a few lines.
+//
+// A buffer with unsaved edits is not touched: the status bar says the
+// file changed, and reload(true) takes it anyway.
+//
+// A file written over in place rather than replaced shows through the
+// buffer's own mapping of it, so what the buffer held cannot be told
+// from what is there now: it is taken in whole, as one hunk. A mapping
+// of a file that was cut short is cut with it as soon as that is seen,
+// before anything reads past the end.
+//
+// Following a file, as for a log, skips the diff: only the bytes past
+// what was read last are read, with pread in chunks of at most 64MB,
+// and appended with Buffer::append_saved, so keeping up costs what was
+// written whatever the size of the file. A file that was replaced
+// (another inode) or cut short was rotated, and is read again from the
+// start as one undo step, binary or not as the new one is. While the
+// cursor is on the last line it stays there as the file grows.
+//
+// EXAMPLE:
+//  File_watcher watcher(&view, &undo, &saver, &curses, &pool, &events);
+//  watcher.watch();
+//  watcher.follow(true);
+//
+class File_watcher : public Buffer_listener {
+public:
+    File_watcher(Buffer_view* view, Undo_tree* undo, Saver* saver,
+            Curses* curses, Thread_pool* pool, Event_queue* events);
+    ~File_watcher();
+
+    // Watches the buffer's file, or its new one after a save under
+    // another name. Returns false if it cannot be watched.
+    bool watch();
+
+    // Reads the file again. With force, unsaved edits are replaced too.
+    void reload(bool force);
+
+    // Starts or stops following the file. Returns false if the buffer
+    // has no file that can be watched.
+    bool follow(bool on);
+    bool following() const { return tailing; }
+
+    void edited(Buffer*, const Buffer_edit&) { }
+    void written(Buffer* buffer);
+
+    // Run on the main thread by the events the reader and the jobs post.
+    void changed(const File_name_list& names);
+    void reloaded(Reload_run* run, unsigned long generation, bool unchanged,
+            const Ref<Buffer_block>& text, const Diff_hunk_list& hunks,
+            int error);
+    void tailed(Reload_run* run, bool rotated, dev_t device, ino_t inode,
+            const Ref<Buffer_block>& text, off_t size, bool more, int error);
+
+private:
+    class Reader : public Thread {
+    public:
+        Reader(File_watcher* watcher, Event_queue* events, int fd);
+        ~Reader();
+
+        void stop();
+
+    protected:
+        void run();
+
+    private:
+        File_watcher* watcher;
+        Event_queue* events;
+        int fd;
+        int wake[2];
+    };
+
+    void apply(const Ref<Buffer_block>& text, const Diff_hunk_list& hunks);
+    void cut();
+    void tail();
+    void take_file();
+
+    File_watcher(const File_watcher&);
+    File_watcher& operator=(const File_watcher&);
+
+    Buffer_view* view;
+    Buffer* buffer;
+    Undo_tree* undo;
+    Saver* saver;
+    Curses* curses;
+    Thread_pool* pool;
+    Event_queue* events;
+
+    // The file watched, and the name it has in its directory.
+    std::string path, name;
+    int inotify, directory;
+    Reader* reader;
+
+    Ref<Reload_run> run;
+    bool reloading, pending, forcing;
+
+    // Mappings of the file that the buffer or its undo history may still
+    // read, cut along with the file (see Buffer_block::cut).
+    Block_list mappings;
+
+    // While following: the file read, and how much of it is in the
+    // buffer.
+    bool tailing;
+    dev_t device;
+    ino_t inode;
+    off_t taken;
+};
+
+#endif // ROTIDE_WATCHER_HPP
@@ -0,0 +1,126 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef ROTIDE_WRAP_HPP
+#define ROTIDE_WRAP_HPP
+
+#include <rotide/buffer.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Soft wrapping splits a logical line into as many visual rows as the
+// window width requires. Rows break on cells: a tab runs to the next tab
+// stop of its row and UTF-8 continuation bytes take no room.
+//
+// The breaks of a line are cached and keyed by the window width and the
+// line's generation (the buffer generation of the last edit touching it).
+// Lines that have never been measured carry an estimate of bytes / width
+// rows until something (drawing, motion) needs them exactly.
+//
+// The per-line entries sit in chunks of a treap that keeps subtree sums
+// of lines and rows, so both line -> visual row and visual row -> line
+// are O(log n). Inside a line the breaks are a sorted offset list, so a
+// minified 10MB line is a binary search away as well.
+//
+// Hidden lines, the inside of a fold, keep their breaks but count as no
+// rows at all, so the row lookups step over a fold of any size in
+// O(log n) too.
+
+const int TAB_WIDTH = 8;
+
+// Cells taken by a byte drawn at a row-relative column.
+inline int cell_width(unsigned char c, int column)
+{
+    if ((c & 0xC0) == 0x80)
+        return 0;
+    return (c == '\t') ? TAB_WIDTH - column % TAB_WIDTH : 1;
+}
+
+struct Wrap_line {
+    Wrap_line()
+        : rows(1), width(0), generation(0), measured(-1), hidden(false) { }
+
+    // Visual row holding a line-relative byte offset.
+    size_t row_of(size_t column) const;
+
+    // Line-relative byte offset where a row starts.
+    size_t row_start(size_t row) const { return row ? breaks[row - 1] : 0; }
+
+    // Rows the line takes on the screen.
+    size_t shown() const { return hidden ? 0 : rows; }
+
+    size_t rows;
+    int width;
+    unsigned long generation, measured;
+    bool hidden;
+    Offset_list breaks;
+};
+
+struct Wrap_position {
+    Wrap_position() : line(0), row(0) { }
+    size_t line, row;
+};
+
+struct Wrap_chunk;
+
+class Wrap_layout {
+public:
+    Wrap_layout();
+    ~Wrap_layout();
+
+    // Throws everything away and estimates every line of the snapshot
+    // for the given width.
+    void reset(const Buffer_snapshot& snapshot, int width);
+
+    // Applies an edit: the touched lines are replaced by fresh estimates
+    // and everything else is left alone. A single-line edit keeps the
+    // breaks in front of the edit and resumes measuring from there.
+    void edited(const Buffer_snapshot& snapshot, const Buffer_edit& edit);
+
+    // The breaks of a line, measured for the current width if needed.
+    const Wrap_line& measure(size_t line);
+
+    // Hides lines [first, first + count), or shows them again. Lines
+    // put in by an edit are always shown.
+    void hide(size_t first, size_t count, bool hidden);
+
+    // Visual row of the first row of a line, or of the next line shown
+    // if it is hidden.
+    size_t row_of(size_t line) const;
+
+    // Line and row within it for a visual row.
+    Wrap_position locate(size_t row) const;
+
+    size_t rows() const;
+    size_t lines() const;
+    int width() const { return columns; }
+
+private:
+    const Wrap_line* find(size_t line) const;
+    Wrap_line estimate(size_t line, unsigned long generation) const;
+    void remeasure(size_t line, Wrap_line* entry) const;
+    void replace(size_t first, size_t count, std::vector<Wrap_line>& lines);
+
+    Wrap_layout(const Wrap_layout&);
+    Wrap_layout& operator=(const Wrap_layout&);
+
+    Buffer_snapshot snapshot;
+    Wrap_chunk* root;
+    int columns;
+};
+
+#endif // ROTIDE_WRAP_HPP
@@ -0,0 +1,42 @@
+/**
+ * Blocks
+ *
+ * % jumps to the bracket matching the one under the cursor, or the first
+ * one after it on the line. z folds the block the cursor's line opens,
+ * or opens the fold under it again, and Z opens every fold. :fold and
+ * :unfold do the same as z.
+ */
+ro.bind(["%".charCodeAt(0)], "match_bracket", function () {
+    if (ro.insert_mode) { return false; }
+
+    if (!ro.match_bracket()) {
+        ro.status = "-- NO MATCH --";
+    }
+    return true;
+});
+
+ro.bind(["z".charCodeAt(0)], "toggle_fold", function () {
+    if (ro.insert_mode) { return false; }
+
+    if (!ro.unfold() && !ro.fold()) {
+        ro.status = "-- NOTHING TO FOLD --";
+    }
+    return true;
+});
+
+ro.bind(["Z".charCodeAt(0)], "unfold_all", function () {
+    if (ro.insert_mode) { return false; }
+
+    ro.unfold_all();
+    return true;
+});
+
+ro.command("fold", function (cmd, args) {
+    ro.cmd_mode = false;
+    return ro.fold();
+});
+
+ro.command("unfold", function (cmd, args) {
+    ro.cmd_mode = false;
+    return ro.unfold();
+});
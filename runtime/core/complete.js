@@ -0,0 +1,21 @@
+/**
+ * Word completion
+ *
+ * In insert mode CTRL+N completes the word in front of the cursor from
+ * the words already in the buffer, the most frequent first. Pressing it
+ * again goes on to the next one and CTRL+P back; going past either end
+ * gives back what was typed.
+ */
+function complete_word(step) {
+    return function () {
+        if (!ro.insert_mode) { return false; }
+
+        if (!ro.complete_word(step)) {
+            ro.status = "-- NO COMPLETIONS --";
+        }
+        return true;
+    };
+}
+
+ro.bind([ro.CTRL_N], "complete_next", complete_word(1));
+ro.bind([ro.CTRL_P], "complete_previous", complete_word(-1));
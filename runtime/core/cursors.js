@@ -0,0 +1,41 @@
+/**
+ * Multiple cursors
+ *
+ * + adds a cursor on the line below, at the same column; a multiplier
+ * adds that many. :cursors <text> puts a cursor on every match of <text>
+ * with the match selected, and :cursors_regex <pattern> takes a regular
+ * expression. While there is more than one cursor, motions move them all
+ * and typing goes in at every one of them as one edit. - goes back to a
+ * single cursor.
+ */
+ro.bind(["+".charCodeAt(0)], "add_cursors", function () {
+    if (ro.insert_mode) { return false; }
+
+    var count = ro.multiplier.length ? parseInt(ro.multiplier) : 1;
+    ro.multiplier = "";
+    ro.add_cursors(count);
+    ro.status = "-- " + ro.cursor_count + " CURSORS --";
+    return true;
+});
+
+ro.bind(["-".charCodeAt(0)], "clear_cursors", function () {
+    if (ro.insert_mode) { return false; }
+
+    ro.clear_cursors();
+    return true;
+});
+
+function select_command(regex) {
+    return function (cmd, args) {
+        ro.cmd_mode = false;
+        if (!args || !args.length) { return false; }
+
+        var count = ro.select_matches(args.join(" "), regex);
+        if (count < 0) { return true; }
+        ro.status = "-- " + count + " CURSORS --";
+        return true;
+    };
+}
+
+ro.command("cursors", select_command(false));
+ro.command("cursors_regex", select_command(true));
@@ -0,0 +1,52 @@
+/**
+ * Files
+ *
+ * :w [file] writes the buffer out, to its own file unless another is
+ * given. The write happens in the background; the status bar shows how
+ * far along it is.
+ */
+ro.write = function (path) {
+    if (ro.save(path)) { return true; }
+
+    ro.status = ro.saving ? "-- ALREADY WRITING --" : "-- NO FILE NAME --";
+    return false;
+};
+
+ro.command("w", function (cmd, args) {
+    ro.cmd_mode = false;
+    return ro.write((args && args.length) ? args[0] : null);
+});
+
+ro.command("write", function (cmd, args) {
+    ro.cmd_mode = false;
+    return ro.write((args && args.length) ? args[0] : null);
+});
+
+/**
+ * :reload reads the file again, throwing away unsaved edits. A file
+ * changed by another program is reloaded on its own unless the buffer
+ * has unsaved edits; only the lines that changed are touched, as one
+ * undo step.
+ */
+ro.command("reload", function (cmd, args) {
+    ro.cmd_mode = false;
+    ro.reload();
+    return true;
+});
+
+/**
+ * :follow follows the file as another program appends to it, like
+ * tail -f; :follow again stops. Only what was appended is read, and the
+ * cursor stays on the last line while it is there. A rotated log is
+ * read again from the start.
+ */
+ro.command("follow", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!ro.follow(!ro.following)) {
+        ro.status = "-- NO FILE TO FOLLOW --";
+        return false;
+    }
+
+    ro.status = ro.following ? "-- FOLLOWING --" : "-- NOT FOLLOWING --";
+    return true;
+});
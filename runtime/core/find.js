@@ -0,0 +1,19 @@
+/**
+ * Find
+ *
+ * :find <letters> lists the files under the directory the editor was
+ * started in whose paths have those letters in order, best first: in
+ * the file name, at the start of words and next to each other is better.
+ * The list is kept up to date as files come and go. o on the file being
+ * edited goes back to it.
+ */
+ro.command("find", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || args.length !== 1) { return false; }
+
+    if (!ro.pick_files(args[0])) {
+        ro.status = ro.indexing ? "-- NO FILES MATCH YET --"
+                                : "-- NO FILES MATCH --";
+    }
+    return true;
+});
@@ -0,0 +1,36 @@
+/**
+ * Grep
+ *
+ * :grep <text> [dir] searches every file under dir, or the current
+ * directory, and :grep_regex <pattern> [dir] does the same with a
+ * regular expression. The matching lines show up in a results buffer as
+ * they are found; :results switches between it and the file, and o on a
+ * result in the file being edited goes to it. o does the same for the
+ * file picker of :find.
+ */
+function grep_command(regex) {
+    return function (cmd, args) {
+        ro.cmd_mode = false;
+        if (!args || !args.length || args.length > 2) { return false; }
+
+        ro.grep(args[0], args.length > 1 ? args[1] : ".", regex);
+        return true;
+    };
+}
+
+ro.command("grep", grep_command(false));
+ro.command("grep_regex", grep_command(true));
+
+ro.command("results", function (cmd, args) {
+    ro.cmd_mode = false;
+    return ro.grep_results();
+});
+
+ro.bind(["o".charCodeAt(0)], "grep_open", function () {
+    if (ro.insert_mode) { return false; }
+
+    if (!ro.grep_open() && !ro.pick_open()) {
+        ro.status = "-- NOT IN THIS FILE --";
+    }
+    return true;
+});
@@ -0,0 +1,49 @@
+/**
+ * Hex
+ *
+ * :hex shows the buffer as a hex dump, and :hex again shows it as text.
+ * Binary files open as hex and stay that way; only the rows on the
+ * screen are ever read, so a core dump of any size opens at once. h and
+ * l walk bytes and j and k walk rows of them.
+ *
+ * :goto <offset> moves to a byte offset, in hex with 0x in front.
+ * :byte <xx> [xx ...] replaces the bytes under the cursor with the ones
+ * given in hex and moves past them.
+ */
+ro.command("hex", function (cmd, args) {
+    ro.cmd_mode = false;
+    ro.hex = !ro.hex;
+    ro.status = ro.hex ? "0x" + ro.offset.toString(16) : "";
+    return true;
+});
+
+ro.command("goto", function (cmd, args) {
+    ro.cmd_mode = false;
+    var offset = (args && args.length) ? parseInt(args[0]) : NaN;
+    if (isNaN(offset) || offset < 0) {
+        ro.status = "-- NOT AN OFFSET --";
+        return false;
+    }
+
+    ro.offset = offset;
+    ro.status = "0x" + ro.offset.toString(16);
+    return true;
+});
+
+ro.command("byte", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || !args.length) { return false; }
+
+    var bytes = [];
+    for (var i = 0; i < args.length; ++i) {
+        if (!/^[0-9a-fA-F]{1,2}$/.test(args[i])) {
+            ro.status = "-- NOT A BYTE: " + args[i] + " --";
+            return false;
+        }
+        bytes.push(parseInt(args[i], 16));
+    }
+
+    ro.overwrite(bytes);
+    ro.status = "0x" + ro.offset.toString(16);
+    return true;
+});
@@ -0,0 +1,48 @@
+/**
+ * Marks and jumps
+ *
+ * m<name> marks the cursor's place and '<name> goes back to it,
+ * wherever edits have moved its text since. A command that takes
+ * the cursor more than a line away is a jump; ( goes back through the
+ * jumps and ) forward again.
+ */
+ro.bind(["m".charCodeAt(0)], "mark", function () {
+    if (ro.insert_mode) { return false; }
+
+    ro.mark();
+    return true;
+});
+
+ro.bind(["'".charCodeAt(0)], "go_mark", function () {
+    if (ro.insert_mode) { return false; }
+
+    ro.go_mark();
+    return true;
+});
+
+ro.bind(["(".charCodeAt(0)], "jump_back", function () {
+    if (ro.insert_mode) { return false; }
+
+    if (!ro.jump_back()) {
+        ro.status = "-- NO OLDER JUMP --";
+    }
+    return true;
+});
+
+ro.bind([")".charCodeAt(0)], "jump_forward", function () {
+    if (ro.insert_mode) { return false; }
+
+    if (!ro.jump_forward()) {
+        ro.status = "-- NO NEWER JUMP --";
+    }
+    return true;
+});
+
+/**
+ * :mark <name>
+ */
+ro.command("mark", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || !args.length) { return false; }
+    return ro.mark(args[0]);
+});
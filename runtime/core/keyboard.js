@@ -35,16 +35,19 @@ function move_cursor_delta(mx, my) {
         if (ro.insert_mode) { return false; }
         var inc = ro.multiplier.length ? parseInt(ro.multiplier) : 1;
 
+        // Vertical motion goes by screen rows so wrapped lines are
+        // walked the way they are displayed.
         if (mx == 0) {
-            ro.status = "" + (ro.my + my*inc) + ":" + ro.mx;
-            ro.my += my*inc;
+            ro.move_rows(my*inc);
         } 
         
         if (my == 0) {
-            ro.status = "" + ro.my + ":" + (ro.mx + mx*inc);
-            ro.mx += mx*inc;
+            ro.move_columns(mx*inc);
         } 
 
+        ro.status = ro.hex ? "0x" + ro.offset.toString(16)
+            : "" + ro.line + ":" + ro.column;
+
          if (ro.multiplier.length)
             ro.multiplier = "";
 
@@ -69,8 +72,8 @@ ro.bind([ro.ZERO], "0", function (argument) {
     if (ro.multiplier.length) {
         ro.multiplier += "0";
     } else {
-        ro.status = "" + ro.my + ":0";
-        ro.mx = 0;
+        ro.column = 0;
+        ro.status = "" + ro.line + ":0";
     }
 
     return true;
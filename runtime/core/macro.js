@@ -0,0 +1,45 @@
+/**
+ * Macros
+ *
+ * q<register> starts recording keys into a register and q stops it.
+ * @<register> replays it, as many times as the multiplier says.
+ */
+ro.bind(["q".charCodeAt(0)], "record", function () {
+    if (ro.insert_mode) { return false; }
+
+    if (ro.recording) {
+        ro.stop_recording();
+    } else {
+        ro.record();
+    }
+
+    return true;
+});
+
+ro.bind(["@".charCodeAt(0)], "replay", function () {
+    if (ro.insert_mode) { return false; }
+
+    var count = ro.multiplier.length ? parseInt(ro.multiplier) : 1;
+    ro.multiplier = "";
+    ro.replay(null, count);
+    return true;
+});
+
+/**
+ * :record <register>
+ * :replay <register> [count]
+ */
+ro.command("record", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || !args.length) { return false; }
+    return ro.record(args[0]);
+});
+
+ro.command("replay", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || !args.length) { return false; }
+
+    var count = args.length > 1 ? parseInt(args[1]) : 1;
+    ro.status = "-- WAITING --";
+    return ro.replay(args[0], count);
+});
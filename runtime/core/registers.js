@@ -0,0 +1,68 @@
+/**
+ * Yank and put
+ *
+ * Y yanks as many lines as the multiplier says and p puts them back
+ * under the cursor's line, as many times as the multiplier says. The
+ * registers keep the yanked text without copying it, so this is as quick
+ * for a gigabyte as for a line.
+ *
+ * :yank <register> [lines] and :put <register> [count] name a register.
+ * :copy [register] hands one to the system clipboard and :paste reads
+ * the clipboard into the + register, ready for p.
+ */
+function take_multiplier() {
+    var count = ro.multiplier.length ? parseInt(ro.multiplier) : 1;
+    ro.multiplier = "";
+    return count;
+}
+
+function yank_lines(register, count) {
+    var bytes = ro.yank_lines(register, count);
+    ro.status = "-- " + count + " LINES YANKED (" + bytes + " BYTES) --";
+    return true;
+}
+
+function put(register, count) {
+    if (!ro.put(register, count)) {
+        ro.status = "-- NOTHING TO PUT --";
+    }
+    return true;
+}
+
+ro.bind(["Y".charCodeAt(0)], "yank_lines", function () {
+    if (ro.insert_mode) { return false; }
+    return yank_lines(null, take_multiplier());
+});
+
+ro.bind(["p".charCodeAt(0)], "put", function () {
+    if (ro.insert_mode) { return false; }
+    return put(null, take_multiplier());
+});
+
+ro.command("yank", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || !args.length) { return false; }
+
+    return yank_lines(args[0], args.length > 1 ? parseInt(args[1]) : 1);
+});
+
+ro.command("put", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || !args.length) { return false; }
+
+    return put(args[0], args.length > 1 ? parseInt(args[1]) : 1);
+});
+
+ro.command("copy", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!ro.copy_register(args && args.length ? args[0] : null)) {
+        ro.status = "-- NOTHING TO COPY --";
+    }
+    return true;
+});
+
+ro.command("paste", function (cmd, args) {
+    ro.cmd_mode = false;
+    ro.paste_clipboard();
+    return true;
+});
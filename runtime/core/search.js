@@ -0,0 +1,66 @@
+/**
+ * Search
+ *
+ * / searches for text as it is typed; Enter stays on the match and Esc
+ * goes back. :search <text> and :regex <pattern> move to the next match
+ * after the cursor. n goes on to the next one and N back to the one
+ * before, wrapping around the buffer. A big file is searched in the
+ * background; the first match shows up as soon as it is found.
+ *
+ * :s <text> <with> replaces every <text> in the buffer at once, as one
+ * undo step; :replace is the same. :replace_regex <pattern> <with> takes
+ * a regular expression. Leaving out <with> deletes the matches.
+ */
+ro.bind(["/".charCodeAt(0)], "search_prompt", function () {
+    if (ro.insert_mode) { return false; }
+
+    ro.multiplier = "";
+    return ro.search_prompt();
+});
+
+ro.bind(["n".charCodeAt(0)], "search_next", function () {
+    if (ro.insert_mode) { return false; }
+
+    var count = ro.multiplier.length ? parseInt(ro.multiplier) : 1;
+    ro.multiplier = "";
+    while (count-- > 0 && ro.search_next(false)) { }
+    return true;
+});
+
+ro.bind(["N".charCodeAt(0)], "search_previous", function () {
+    if (ro.insert_mode) { return false; }
+
+    var count = ro.multiplier.length ? parseInt(ro.multiplier) : 1;
+    ro.multiplier = "";
+    while (count-- > 0 && ro.search_next(true)) { }
+    return true;
+});
+
+ro.command("search", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || !args.length) { return false; }
+    return ro.search_start(args.join(" "), false);
+});
+
+ro.command("regex", function (cmd, args) {
+    ro.cmd_mode = false;
+    if (!args || !args.length) { return false; }
+    return ro.search_start(args.join(" "), true);
+});
+
+function replace_command(regex) {
+    return function (cmd, args) {
+        ro.cmd_mode = false;
+        if (!args || !args.length || args.length > 2) { return false; }
+
+        var text = args.length > 1 ? args[1] : "";
+        var count = ro.replace(args[0], text, regex);
+        if (count < 0) { return true; }
+        ro.status = "Replaced " + count + (count == 1 ? " match." : " matches.");
+        return true;
+    };
+}
+
+ro.command("s", replace_command(false));
+ro.command("replace", replace_command(false));
+ro.command("replace_regex", replace_command(true));
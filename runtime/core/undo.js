@@ -0,0 +1,40 @@
+/**
+ * Undo
+ *
+ * u undoes the last step and U redoes it. After undoing, :branch n
+ * picks which of the later changes U brings back.
+ */
+ro.bind(["u".charCodeAt(0)], "undo", function () {
+    if (ro.insert_mode) { return false; }
+
+    var count = ro.multiplier.length ? parseInt(ro.multiplier) : 1;
+    ro.multiplier = "";
+    while (count-- > 0 && ro.undo()) { }
+    return true;
+});
+
+ro.bind(["U".charCodeAt(0)], "redo", function () {
+    if (ro.insert_mode) { return false; }
+
+    var count = ro.multiplier.length ? parseInt(ro.multiplier) : 1;
+    ro.multiplier = "";
+    while (count-- > 0 && ro.redo()) { }
+    return true;
+});
+
+ro.command("undo", function (cmd, args) {
+    ro.cmd_mode = false;
+    return ro.undo();
+});
+
+ro.command("redo", function (cmd, args) {
+    ro.cmd_mode = false;
+    return ro.redo();
+});
+
+ro.command("branch", function (cmd, args) {
+    ro.cmd_mode = false;
+    var delta = (args && args.length) ? parseInt(args[0]) : 1;
+    ro.status = "-- BRANCHES: " + ro.undo_branch(delta) + " --";
+    return true;
+});
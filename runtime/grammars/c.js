@@ -0,0 +1,32 @@
+/**
+ * C and C++
+ *
+ * Comments, strings and characters, numbers, preprocessor lines,
+ * keywords, built-in types and the Class_name types of this code, and
+ * ALL_CAPS constants.
+ */
+ro.grammar("c", [".c", ".h", ".cc", ".hh", ".cpp", ".hpp", ".cxx"], {
+    start: [
+        ["//.*", "comment"],
+        ["/\\*", "comment", "comment"],
+        ["^[ \t]*#[ \t]*[a-z]+", "preprocessor"],
+        ["\"(\\\\.|[^\\\\\"])*\"?", "string"],
+        ["'(\\\\.|[^\\\\'])*'", "string"],
+        ["\\b(0[xX][0-9a-fA-F]+|[0-9]+(\\.[0-9]*)?([eE][-+]?[0-9]+)?)" +
+            "[uUlLfF]*\\b", "number"],
+        ["\\b(if|else|for|while|do|switch|case|default|break|continue|" +
+            "return|goto|sizeof|typedef|struct|union|enum|class|" +
+            "namespace|public|private|protected|template|typename|" +
+            "virtual|static|const|extern|inline|new|delete|operator|" +
+            "using|try|catch|throw|friend|explicit|volatile|register|" +
+            "this)\\b", "keyword"],
+        ["\\b(void|bool|char|short|int|long|float|double|signed|" +
+            "unsigned|[a-z_0-9]+_t|[A-Z][A-Za-z0-9]*_[a-z_0-9]+)\\b",
+            "type"],
+        ["\\b(true|false|NULL|[A-Z][A-Z0-9_]+)\\b", "constant"]
+    ],
+    comment: {
+        style: "comment",
+        rules: [["\\*/", "comment", "start"]]
+    }
+});
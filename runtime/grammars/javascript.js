@@ -0,0 +1,23 @@
+/**
+ * JavaScript
+ *
+ * Comments, strings, numbers, keywords and constants.
+ */
+ro.grammar("javascript", [".js", ".json"], {
+    start: [
+        ["//.*", "comment"],
+        ["/\\*", "comment", "comment"],
+        ["\"(\\\\.|[^\\\\\"])*\"?", "string"],
+        ["'(\\\\.|[^\\\\'])*'?", "string"],
+        ["\\b(0[xX][0-9a-fA-F]+|[0-9]+(\\.[0-9]*)?([eE][-+]?[0-9]+)?)\\b",
+            "number"],
+        ["\\b(var|function|return|if|else|for|in|while|do|switch|case|" +
+            "default|break|continue|new|delete|typeof|instanceof|this|" +
+            "try|catch|finally|throw)\\b", "keyword"],
+        ["\\b(true|false|null|undefined|NaN|Infinity)\\b", "constant"]
+    ],
+    comment: {
+        style: "comment",
+        rules: [["\\*/", "comment", "start"]]
+    }
+});
@@ -2,4 +2,44 @@ ro.core.enable([
         // The keyboard core handles keyboard interaction
         // and movement throughout the editor.
         "core/keyboard.js",
+
+        // Recording keys into registers and replaying them.
+        "core/macro.js",
+
+        // Undo, redo and switching between undo branches.
+        "core/undo.js",
+
+        // Writing the buffer out.
+        "core/file.js",
+
+        // Searching the buffer.
+        "core/search.js",
+
+        // Searching the files under a directory.
+        "core/grep.js",
+
+        // Finding files by a few letters of their names.
+        "core/find.js",
+
+        // Matching brackets and folding blocks away.
+        "core/blocks.js",
+
+        // Marks and the jump list.
+        "core/jumps.js",
+
+        // Typing at many places at once.
+        "core/cursors.js",
+
+        // Completing words from the ones already in the buffer.
+        "core/complete.js",
+
+        // Yanking and putting text, and the system clipboard.
+        "core/registers.js",
+
+        // Showing files as hex and changing them byte by byte.
+        "core/hex.js",
+
+        // Grammars that color files by their extensions.
+        "grammars/c.js",
+        "grammars/javascript.js",
 ]);
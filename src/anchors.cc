@@ -0,0 +1,304 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/anchors.hpp>
+
+#include <algorithm>
+
+// A node of the tree. Its own fields are exact once the shifts owed by
+// its ancestors are added; `shift` is what it owes its children.
+struct Anchor {
+    Anchor(size_t start, size_t end);
+    ~Anchor() { delete left; delete right; }
+
+    Anchor* left;
+    Anchor* right;
+    Anchor* parent;
+    unsigned priority;
+    size_t start, end, reach;
+    long shift;
+};
+
+namespace {
+
+unsigned next_priority()
+{
+    static unsigned state = 2463534242U;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Moves a whole subtree; its children only hear of it when walked into.
+void shift_by(Anchor* node, long delta)
+{
+    node->start += delta;
+    node->end += delta;
+    node->reach += delta;
+    node->shift += delta;
+}
+
+void push(Anchor* node)
+{
+    if (node->shift == 0)
+        return;
+
+    if (node->left)
+        shift_by(node->left, node->shift);
+    if (node->right)
+        shift_by(node->right, node->shift);
+    node->shift = 0;
+}
+
+void update(Anchor* node)
+{
+    node->reach = node->end;
+    if (node->left) {
+        node->reach = std::max(node->reach, node->left->reach);
+        node->left->parent = node;
+    }
+    if (node->right) {
+        node->reach = std::max(node->reach, node->right->reach);
+        node->right->parent = node;
+    }
+}
+
+Anchor* detach(Anchor* node)
+{
+    if (node)
+        node->parent = NULL;
+    return node;
+}
+
+// Joins two trees where every start in left comes before those in right.
+Anchor* merge(Anchor* left, Anchor* right)
+{
+    if (!left)
+        return right;
+    if (!right)
+        return left;
+
+    if (left->priority > right->priority) {
+        push(left);
+        left->right = merge(left->right, right);
+        update(left);
+        return left;
+    }
+
+    push(right);
+    right->left = merge(left, right->left);
+    update(right);
+    return right;
+}
+
+// Cuts a tree into the anchors starting before offset and the rest.
+void split(Anchor* node, size_t offset, Anchor** left, Anchor** right)
+{
+    if (!node) {
+        *left = *right = NULL;
+        return;
+    }
+
+    push(node);
+    if (node->start < offset) {
+        split(node->right, offset, &node->right, right);
+        update(node);
+        *left = node;
+    } else {
+        split(node->left, offset, left, &node->left);
+        update(node);
+        *right = node;
+    }
+}
+
+// Where an offset that was in or after the edited text ends up.
+size_t moved(size_t offset, const Buffer_edit& edit)
+{
+    if (offset >= edit.offset + edit.removed)
+        return offset + edit.inserted - edit.removed;
+    return edit.offset + std::min(offset - edit.offset, edit.inserted);
+}
+
+// The anchors starting before an edit only change if they reach into it.
+void stretch(Anchor* node, const Buffer_edit& edit)
+{
+    if (!node || node->reach <= edit.offset)
+        return;
+
+    push(node);
+    stretch(node->left, edit);
+    stretch(node->right, edit);
+    if (node->end > edit.offset)
+        node->end = moved(node->end, edit);
+    update(node);
+}
+
+// Every anchor starting in the edited text is placed one by one. Their
+// order is kept, so the subtree stays as it is.
+void place(Anchor* node, const Buffer_edit& edit)
+{
+    if (!node)
+        return;
+
+    push(node);
+    place(node->left, edit);
+    place(node->right, edit);
+    node->start = moved(node->start, edit);
+    node->end = std::max(node->start, moved(node->end, edit));
+    update(node);
+}
+
+void find_in(const Anchor* node, long owed, size_t begin, size_t end,
+        Anchor_list* found)
+{
+    if (!node || node->reach + owed < begin)
+        return;
+
+    long below = owed + node->shift;
+    find_in(node->left, below, begin, end, found);
+
+    size_t start = node->start + owed;
+    if (start >= end)
+        return;
+
+    size_t stop = node->end + owed;
+    if (stop > begin || (stop == start && start >= begin))
+        found->push_back(const_cast<Anchor*>(node));
+
+    find_in(node->right, below, begin, end, found);
+}
+
+// What the ancestors of a node still owe it.
+long owed(const Anchor* node)
+{
+    long shift = 0;
+    for (const Anchor* up = node->parent; up; up = up->parent)
+        shift += up->shift;
+    return shift;
+}
+
+} // namespace
+
+Anchor::Anchor(size_t start, size_t end)
+    : left(NULL), right(NULL), parent(NULL), priority(next_priority()),
+      start(start), end(end), reach(end), shift(0)
+{
+}
+
+Anchor_tree::Anchor_tree(Buffer* buffer)
+    : buffer(buffer), root(NULL), count(0)
+{
+    buffer->listen(this);
+}
+
+Anchor_tree::~Anchor_tree()
+{
+    buffer->unlisten(this);
+    delete root;
+}
+
+// The tree is cut into the anchors before the edit, those starting in the
+// text it replaced and those after it. The last part moves as a whole.
+void Anchor_tree::edited(Buffer*, const Buffer_edit& edit)
+{
+    if (!root)
+        return;
+
+    Anchor* before;
+    Anchor* inside;
+    Anchor* after;
+    Anchor* rest;
+    split(root, edit.offset, &before, &rest);
+    split(detach(rest), edit.offset + edit.removed, &inside, &after);
+
+    stretch(detach(before), edit);
+    place(detach(inside), edit);
+    if (detach(after))
+        shift_by(after, (long)edit.inserted - (long)edit.removed);
+
+    root = detach(merge(merge(before, inside), after));
+}
+
+Anchor* Anchor_tree::add(size_t start, size_t end)
+{
+    Anchor* anchor = new Anchor(start, std::max(start, end));
+    Anchor* before;
+    Anchor* after;
+    split(root, start, &before, &after);
+    root = detach(merge(merge(detach(before), anchor), detach(after)));
+    ++count;
+    return anchor;
+}
+
+void Anchor_tree::remove(Anchor* anchor)
+{
+    // What the ancestors owe is handed down first, so the subtrees left
+    // behind are exact where they are put.
+    std::vector<Anchor*> path;
+    for (Anchor* up = anchor->parent; up; up = up->parent)
+        path.push_back(up);
+    for (std::vector<Anchor*>::reverse_iterator it = path.rbegin(),
+            end = path.rend();
+            it != end;
+            ++it)
+    {
+        push(*it);
+    }
+    push(anchor);
+
+    Anchor* parent = anchor->parent;
+    Anchor* joined = merge(detach(anchor->left), detach(anchor->right));
+    if (joined)
+        joined->parent = parent;
+
+    if (!parent)
+        root = joined;
+    else if (parent->left == anchor)
+        parent->left = joined;
+    else
+        parent->right = joined;
+
+    for (Anchor* up = parent; up; up = up->parent)
+        update(up);
+
+    anchor->left = anchor->right = NULL;
+    delete anchor;
+    --count;
+}
+
+void Anchor_tree::clear()
+{
+    delete root;
+    root = NULL;
+    count = 0;
+}
+
+size_t Anchor_tree::start(const Anchor* anchor) const
+{
+    return anchor->start + owed(anchor);
+}
+
+size_t Anchor_tree::end(const Anchor* anchor) const
+{
+    return anchor->end + owed(anchor);
+}
+
+void Anchor_tree::find(size_t begin, size_t end, Anchor_list* found) const
+{
+    find_in(root, 0, begin, end, found);
+}
@@ -0,0 +1,884 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/buffer.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Inserted text is appended to blocks of this size. Anything at least
+// LARGE_INSERT bytes gets a block of its own with a newline index, so a
+// block without an index is never bigger than ADD_BLOCK_SIZE and scanning
+// it for newlines stays cheap.
+const size_t ADD_BLOCK_SIZE = 64 * 1024;
+const size_t LARGE_INSERT = 4 * 1024;
+
+// How far into a block looks_binary() looks for a NUL, as git does.
+const size_t BINARY_SNIFF = 8 * 1024;
+
+// Treap priorities. Edits only ever happen on the main thread.
+unsigned next_priority()
+{
+    static unsigned state = 2463534242U;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+size_t count_bytes(const Ref<Piece_node>& node)
+{
+    return node.empty() ? 0 : node->bytes;
+}
+
+size_t count_newlines(const Ref<Piece_node>& node)
+{
+    return node.empty() ? 0 : node->newlines;
+}
+
+Ref<Piece_node> make(const Ref<Piece_node>& left,
+        const Ref<Piece_node>& right,
+        const Piece& piece,
+        unsigned priority)
+{
+    return Ref<Piece_node>(new Piece_node(left, right, piece, priority));
+}
+
+Ref<Piece_node> leaf(const Piece& piece)
+{
+    return make(Ref<Piece_node>(), Ref<Piece_node>(), piece, next_priority());
+}
+
+// Joins two trees where every byte of a comes before every byte of b.
+// Only the nodes along the seam are copied.
+Ref<Piece_node> merge(const Ref<Piece_node>& a, const Ref<Piece_node>& b)
+{
+    if (a.empty())
+        return b;
+    if (b.empty())
+        return a;
+
+    if (a->priority > b->priority)
+        return make(a->left, merge(a->right, b), a->piece, a->priority);
+
+    return make(merge(a, b->left), b->right, b->piece, b->priority);
+}
+
+// Splits a tree into the bytes before offset and the bytes after it,
+// cutting a piece in two if the offset falls inside of it.
+void split(const Ref<Piece_node>& node,
+        size_t offset,
+        Ref<Piece_node>* left,
+        Ref<Piece_node>* right)
+{
+    if (node.empty() || offset == 0) {
+        *left = Ref<Piece_node>();
+        *right = node;
+        return;
+    }
+
+    if (offset >= node->bytes) {
+        *left = node;
+        *right = Ref<Piece_node>();
+        return;
+    }
+
+    size_t left_bytes = count_bytes(node->left);
+    size_t piece_end = left_bytes + node->piece.length;
+
+    if (offset <= left_bytes) {
+        Ref<Piece_node> l, r;
+        split(node->left, offset, &l, &r);
+        *left = l;
+        *right = make(r, node->right, node->piece, node->priority);
+    } else if (offset >= piece_end) {
+        Ref<Piece_node> l, r;
+        split(node->right, offset - piece_end, &l, &r);
+        *left = make(node->left, l, node->piece, node->priority);
+        *right = r;
+    } else {
+        const Piece& piece = node->piece;
+        size_t cut = offset - left_bytes;
+        Piece head(piece.block, piece.start, cut);
+        Piece tail(piece.block, piece.start + cut, piece.length - cut);
+        *left = merge(node->left, leaf(head));
+        *right = merge(leaf(tail), node->right);
+    }
+}
+
+// Builds a treap over pieces in their order in linear time. The shape is
+// worked out on indices first, keeping a stack of the right spine, and
+// the nodes are then made from the bottom up.
+const size_t NO_CHILD = (size_t)-1;
+
+class Piece_builder {
+public:
+    explicit Piece_builder(const Piece_list& pieces)
+        : pieces(pieces), priorities(pieces.size()),
+          lefts(pieces.size(), NO_CHILD),
+          rights(pieces.size(), NO_CHILD) { }
+
+    Ref<Piece_node> build()
+    {
+        std::vector<size_t> spine;
+        for (size_t i = 0; i < pieces.size(); ++i) {
+            priorities[i] = next_priority();
+            size_t below = NO_CHILD;
+            while (!spine.empty() && priorities[spine.back()] < priorities[i]) {
+                below = spine.back();
+                spine.pop_back();
+            }
+            lefts[i] = below;
+            if (!spine.empty())
+                rights[spine.back()] = i;
+            spine.push_back(i);
+        }
+        return spine.empty() ? Ref<Piece_node>() : make_node(spine.front());
+    }
+
+private:
+    // Recursion only goes as deep as the treap, which is O(log n).
+    Ref<Piece_node> make_node(size_t i)
+    {
+        Ref<Piece_node> left, right;
+        if (lefts[i] != NO_CHILD)
+            left = make_node(lefts[i]);
+        if (rights[i] != NO_CHILD)
+            right = make_node(rights[i]);
+        return make(left, right, pieces[i], priorities[i]);
+    }
+
+    const Piece_list& pieces;
+    std::vector<unsigned> priorities;
+    std::vector<size_t> lefts, rights;
+};
+
+// Writes out the pieces of a rebuilt run of a document, front to back.
+// Long runs of the old text stay pieces of the blocks they are in. Short
+// ones, and short replacement text, are copied into new blocks instead,
+// so replacing densely costs bytes rather than a piece each.
+class Piece_writer {
+public:
+    Piece_writer(const Buffer_snapshot& snapshot, Piece_list* pieces)
+        : it(snapshot, 0), pieces(pieces), piece(NULL), start(0) { }
+
+    ~Piece_writer() { flush(); }
+
+    // Bytes [from, to) of the old text. Runs have to come in order.
+    void copy(size_t from, size_t to)
+    {
+        bool inline_copy = to - from < SHORT_RUN;
+        if (!inline_copy)
+            flush();
+
+        while (from < to) {
+            size_t skip;
+            while (piece == NULL || start + piece->length <= from) {
+                if (piece != NULL)
+                    start += piece->length;
+                if (!it.next_piece(&piece, &skip))
+                    return;
+            }
+
+            size_t begin = from - start;
+            size_t end = std::min(to - start, piece->length);
+            if (inline_copy)
+                put(piece->data() + begin, end - begin);
+            else if (begin == 0 && end == piece->length)
+                pieces->push_back(*piece);
+            else
+                pieces->push_back(
+                        Piece(piece->block, piece->start + begin, end - begin));
+            from = start + end;
+        }
+    }
+
+    // New text, kept in text unless it is short.
+    void insert(const Piece& text)
+    {
+        if (text.length < SHORT_RUN) {
+            put(text.data(), text.length);
+        } else {
+            flush();
+            pieces->push_back(text);
+        }
+    }
+
+private:
+    void put(const char* data, size_t size)
+    {
+        while (size) {
+            if (block.empty())
+                block = Ref<Buffer_block>(new Buffer_block(BLOCK_SIZE));
+
+            size_t room = std::min(size, block->capacity - block->used);
+            memcpy(block->data + block->used, data, room);
+            block->used += room;
+            data += room;
+            size -= room;
+            if (block->used == block->capacity)
+                flush();
+        }
+    }
+
+    void flush()
+    {
+        if (block.empty())
+            return;
+
+        block->build_index();
+        pieces->push_back(Piece(block, 0, block->used));
+        block.reset();
+    }
+
+    static const size_t SHORT_RUN = LARGE_INSERT;
+    static const size_t BLOCK_SIZE = 1024 * 1024;
+
+    Piece_iterator it;
+    Piece_list* pieces;
+    const Piece* piece;
+    size_t start;
+    Ref<Buffer_block> block;
+};
+
+const Piece* last_piece(const Ref<Piece_node>& node)
+{
+    const Piece_node* n = node.get();
+    if (n == NULL)
+        return NULL;
+    while (!n->right.empty())
+        n = n->right.get();
+    return &n->piece;
+}
+
+} // namespace
+
+Buffer_block::Buffer_block(size_t capacity)
+    : refs(0), data(new char[capacity]), capacity(capacity), used(0),
+      fd(-1), mapped(false), indexed(false), binary(false)
+{
+}
+
+Buffer_block::Buffer_block(char* mapping, size_t size, int fd)
+    : refs(0), data(mapping), capacity(size), used(size),
+      fd(fd), mapped(true), indexed(false), binary(false)
+{
+}
+
+Buffer_block::~Buffer_block()
+{
+    if (mapped) {
+        munmap(data, capacity);
+        if (fd >= 0)
+            close(fd);
+    } else {
+        delete[] data;
+    }
+}
+
+void Buffer_block::build_index()
+{
+    newlines.clear();
+    const char* begin = data;
+    const char* end = data + used;
+    const char* p = begin;
+    while ((p = (const char*)memchr(p, '\n', end - p)) != NULL) {
+        newlines.push_back(p - begin);
+        ++p;
+    }
+    indexed = true;
+}
+
+bool Buffer_block::looks_binary() const
+{
+    return memchr(data, '\0', std::min(used, BINARY_SNIFF)) != NULL;
+}
+
+void Buffer_block::cut(size_t size)
+{
+    if (!mapped || size >= capacity)
+        return;
+
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t from = (size + page - 1) / page * page;
+    if (from < capacity) {
+        mmap(data + from, capacity - from, PROT_READ,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    }
+}
+
+size_t Buffer_block::count_newlines(size_t start, size_t length) const
+{
+    if (binary)
+        return 0;
+
+    if (indexed) {
+        Offset_list::const_iterator lo =
+            std::lower_bound(newlines.begin(), newlines.end(), start);
+        Offset_list::const_iterator hi =
+            std::lower_bound(lo, newlines.end(), start + length);
+        return hi - lo;
+    }
+
+    size_t count = 0;
+    const char* p = data + start;
+    const char* end = p + length;
+    while ((p = (const char*)memchr(p, '\n', end - p)) != NULL) {
+        ++count;
+        ++p;
+    }
+    return count;
+}
+
+size_t Buffer_block::find_newline(size_t start, size_t n) const
+{
+    if (indexed) {
+        Offset_list::const_iterator lo =
+            std::lower_bound(newlines.begin(), newlines.end(), start);
+        assert((size_t)(newlines.end() - lo) > n && "Newline out of range");
+        return *(lo + n);
+    }
+
+    const char* p = data + start;
+    const char* end = data + used;
+    for (;;) {
+        p = (const char*)memchr(p, '\n', end - p);
+        assert(p != NULL && "Newline out of range");
+        if (n-- == 0)
+            return p - data;
+        ++p;
+    }
+}
+
+Piece::Piece(const Ref<Buffer_block>& block, size_t start, size_t length)
+    : block(block), start(start), length(length),
+      newlines(block->count_newlines(start, length))
+{
+}
+
+Piece_node::Piece_node(const Ref<Piece_node>& left,
+        const Ref<Piece_node>& right,
+        const Piece& piece,
+        unsigned priority)
+    : refs(0), left(left), right(right), piece(piece), priority(priority)
+{
+    bytes = count_bytes(left) + piece.length + count_bytes(right);
+    newlines = count_newlines(left) + piece.newlines + count_newlines(right);
+}
+
+size_t Buffer_snapshot::size() const
+{
+    return count_bytes(root);
+}
+
+size_t Buffer_snapshot::lines() const
+{
+    return count_newlines(root) + 1;
+}
+
+size_t Buffer_snapshot::newline_offset(size_t n) const
+{
+    const Piece_node* node = root.get();
+    size_t base = 0;
+    while (node) {
+        size_t left_newlines = count_newlines(node->left);
+        if (n < left_newlines) {
+            node = node->left.get();
+            continue;
+        }
+
+        n -= left_newlines;
+        base += count_bytes(node->left);
+
+        const Piece& piece = node->piece;
+        if (n < piece.newlines)
+            return base + piece.block->find_newline(piece.start, n)
+                - piece.start;
+
+        n -= piece.newlines;
+        base += piece.length;
+        node = node->right.get();
+    }
+    return size();
+}
+
+size_t Buffer_snapshot::line_start(size_t line) const
+{
+    if (line == 0)
+        return 0;
+    size_t newlines = count_newlines(root);
+    if (line > newlines)
+        line = newlines;
+    return line ? newline_offset(line - 1) + 1 : 0;
+}
+
+size_t Buffer_snapshot::line_end(size_t line) const
+{
+    if (line >= count_newlines(root))
+        return size();
+    return newline_offset(line);
+}
+
+size_t Buffer_snapshot::line_of(size_t offset) const
+{
+    const Piece_node* node = root.get();
+    size_t line = 0;
+    while (node && offset) {
+        size_t left_bytes = count_bytes(node->left);
+        if (offset <= left_bytes) {
+            node = node->left.get();
+            continue;
+        }
+
+        line += count_newlines(node->left);
+        offset -= left_bytes;
+
+        const Piece& piece = node->piece;
+        if (offset <= piece.length)
+            return line + piece.block->count_newlines(piece.start, offset);
+
+        line += piece.newlines;
+        offset -= piece.length;
+        node = node->right.get();
+    }
+    return line;
+}
+
+size_t Buffer_snapshot::read(size_t offset, size_t size, char* out) const
+{
+    Piece_iterator it(*this, offset);
+    const char* data;
+    size_t run, copied = 0;
+    while (copied < size && it.next(&data, &run)) {
+        run = std::min(run, size - copied);
+        memcpy(out + copied, data, run);
+        copied += run;
+    }
+    return copied;
+}
+
+std::string Buffer_snapshot::text(size_t offset, size_t size) const
+{
+    size_t total = this->size();
+    if (offset >= total)
+        return std::string();
+    size = std::min(size, total - offset);
+
+    std::string s(size, '\0');
+    if (size)
+        read(offset, size, &s[0]);
+    return s;
+}
+
+char Buffer_snapshot::at(size_t offset) const
+{
+    char c = '\0';
+    read(offset, 1, &c);
+    return c;
+}
+
+Buffer_snapshot Buffer_snapshot::slice(size_t offset, size_t size) const
+{
+    Ref<Piece_node> left, middle, right, rest;
+    split(root, offset, &left, &rest);
+    split(rest, size, &middle, &right);
+    return Buffer_snapshot(middle);
+}
+
+Buffer_snapshot::Buffer_snapshot(const Ref<Buffer_block>& block)
+{
+    if (!block.empty() && block->used)
+        root = leaf(Piece(block, 0, block->used));
+}
+
+bool map_file(int fd, Ref<Buffer_block>* block)
+{
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+
+    if (st.st_size == 0) {
+        close(fd);
+        *block = Ref<Buffer_block>();
+        return true;
+    }
+
+    void* mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return false;
+    }
+
+    *block = Ref<Buffer_block>(
+            new Buffer_block((char*)mapping, st.st_size, fd));
+    return true;
+}
+
+// Descend to the piece holding offset, remembering every node where we
+// went left; those are exactly the nodes still to be visited in order.
+Piece_iterator::Piece_iterator(const Buffer_snapshot& snapshot, size_t offset)
+    : snapshot(snapshot), skip(0), position(offset)
+{
+    const Piece_node* node = snapshot.root.get();
+    while (node) {
+        size_t left_bytes = count_bytes(node->left);
+        if (offset < left_bytes) {
+            stack.push_back(node);
+            node = node->left.get();
+        } else if (offset < left_bytes + node->piece.length) {
+            stack.push_back(node);
+            skip = offset - left_bytes;
+            break;
+        } else {
+            offset -= left_bytes + node->piece.length;
+            node = node->right.get();
+        }
+    }
+}
+
+void Piece_iterator::push_left(const Piece_node* node)
+{
+    while (node) {
+        stack.push_back(node);
+        node = node->left.get();
+    }
+}
+
+bool Piece_iterator::next_piece(const Piece** piece, size_t* skipped)
+{
+    if (stack.empty())
+        return false;
+
+    const Piece_node* node = stack.back();
+    stack.pop_back();
+    push_left(node->right.get());
+
+    *piece = &node->piece;
+    *skipped = skip;
+    position += node->piece.length - skip;
+    skip = 0;
+    return true;
+}
+
+bool Piece_iterator::next(const char** data, size_t* size)
+{
+    const Piece* piece;
+    size_t skipped;
+    if (!next_piece(&piece, &skipped))
+        return false;
+
+    *data = piece->data() + skipped;
+    *size = piece->length - skipped;
+    return true;
+}
+
+Buffer::Buffer()
+    : generation(0), modified(false), binary(false)
+{
+}
+
+bool Buffer::open(const std::string& file)
+{
+    Ref<Buffer_block> block;
+    int fd = ::open(file.c_str(), O_RDONLY);
+
+    if (fd < 0) {
+        if (errno != ENOENT)
+            return false;
+    } else if (!map_file(fd, &block)) {
+        return false;
+    }
+
+    binary = !block.empty() && block->looks_binary();
+    if (binary)
+        block->binary = true;
+    else if (!block.empty())
+        block->build_index();
+    Buffer_snapshot mapped(block);
+
+    Buffer_edit edit;
+    edit.removed = size();
+    edit.removed_lines = lines() - 1;
+    edit.inserted = count_bytes(mapped.root);
+    edit.inserted_lines = count_newlines(mapped.root);
+
+    path = file;
+    saved = mapped;
+    commit(mapped.root, &edit);
+    return true;
+}
+
+// Copies new text into an add block and returns the piece describing it.
+Piece Buffer::append(const char* data, size_t size)
+{
+    if (size >= LARGE_INSERT) {
+        Ref<Buffer_block> block(new Buffer_block(size));
+        memcpy(block->data, data, size);
+        block->used = size;
+        block->build_index();
+        return Piece(block, 0, size);
+    }
+
+    if (add_block.empty() || add_block->capacity - add_block->used < size)
+        add_block = Ref<Buffer_block>(new Buffer_block(ADD_BLOCK_SIZE));
+
+    size_t start = add_block->used;
+    memcpy(add_block->data + start, data, size);
+    add_block->used += size;
+    return Piece(add_block, start, size);
+}
+
+void Buffer::insert(size_t offset, const char* data, size_t size)
+{
+    if (size == 0)
+        return;
+
+    offset = std::min(offset, this->size());
+
+    Buffer_edit edit;
+    edit.offset = offset;
+    edit.inserted = size;
+    edit.line = current.line_of(offset);
+
+    Ref<Piece_node> left, right;
+    split(current.root, offset, &left, &right);
+
+    // Typing appends to the piece that was written last. Grow that piece
+    // instead of adding a new one for every key.
+    const Piece* last = last_piece(left);
+    if (size < LARGE_INSERT
+            && last != NULL
+            && last->block == add_block
+            && last->start + last->length == add_block->used
+            && add_block->capacity - add_block->used >= size) {
+        Piece grown = *last;
+        Piece tail = append(data, size);
+        grown.length += tail.length;
+        grown.newlines += tail.newlines;
+        edit.inserted_lines = tail.newlines;
+
+        Ref<Piece_node> head, old;
+        split(left, left->bytes - last->length, &head, &old);
+        left = merge(head, leaf(grown));
+    } else {
+        Piece piece = append(data, size);
+        edit.inserted_lines = piece.newlines;
+        left = merge(left, leaf(piece));
+    }
+
+    commit(merge(left, right), &edit);
+}
+
+void Buffer::insert(size_t offset, const std::string& text)
+{
+    insert(offset, text.data(), text.size());
+}
+
+void Buffer::insert(size_t offset, const Buffer_snapshot& text,
+        size_t count)
+{
+    if (text.root.empty() || count == 0)
+        return;
+
+    offset = std::min(offset, this->size());
+
+    Piece_list pieces;
+    for (size_t i = 0; i < count; ++i) {
+        Piece_iterator it(text, 0);
+        const Piece* piece;
+        size_t skip;
+        while (it.next_piece(&piece, &skip))
+            pieces.push_back(*piece);
+    }
+
+    Buffer_edit edit;
+    edit.offset = offset;
+    edit.line = current.line_of(offset);
+
+    Ref<Piece_node> built = Piece_builder(pieces).build();
+    edit.inserted = count_bytes(built);
+    edit.inserted_lines = count_newlines(built);
+
+    Ref<Piece_node> left, right;
+    split(current.root, offset, &left, &right);
+    commit(merge(merge(left, built), right), &edit);
+}
+
+void Buffer::remove(size_t offset, size_t size)
+{
+    size_t total = this->size();
+    if (offset >= total || size == 0)
+        return;
+    size = std::min(size, total - offset);
+
+    Buffer_edit edit;
+    edit.offset = offset;
+    edit.removed = size;
+    edit.line = current.line_of(offset);
+
+    Ref<Piece_node> left, middle, right, rest;
+    split(current.root, offset, &left, &rest);
+    split(rest, size, &middle, &right);
+    edit.removed_lines = count_newlines(middle);
+
+    commit(merge(left, right), &edit);
+}
+
+size_t Buffer::replace(const Range_list& ranges, const char* data,
+        size_t size)
+{
+    size_t total = this->size();
+    Range_list::const_iterator it = ranges.begin(), end = ranges.end();
+    while (it != end && it->offset > total)
+        ++it;
+    if (it == end)
+        return 0;
+
+    // Only the part of the tree from the first range to the last is
+    // rebuilt; the rest is shared with the document before.
+    size_t first = it->offset;
+    size_t last = first;
+    for (Range_list::const_iterator rit = it; rit != end; ++rit) {
+        if (rit->offset >= last && rit->offset <= total)
+            last = std::min(rit->offset + rit->length, total);
+    }
+
+    Ref<Piece_node> left, middle, right, rest;
+    split(current.root, first, &left, &rest);
+    split(rest, last - first, &middle, &right);
+
+    Piece text;
+    if (size)
+        text = append(data, size);
+
+    Piece_list pieces;
+    size_t at = first, replaced = 0;
+    {
+        Piece_writer writer(Buffer_snapshot(middle), &pieces);
+        for (; it != end; ++it) {
+            if (it->offset < at || it->offset > total)
+                continue;
+
+            writer.copy(at - first, it->offset - first);
+            if (size)
+                writer.insert(text);
+            at = std::min(it->offset + it->length, total);
+            ++replaced;
+        }
+    }
+
+    Buffer_edit edit;
+    edit.offset = first;
+    edit.removed = last - first;
+    edit.line = current.line_of(first);
+    edit.removed_lines = count_newlines(middle);
+
+    Ref<Piece_node> built = Piece_builder(pieces).build();
+    edit.inserted = count_bytes(built);
+    edit.inserted_lines = count_newlines(built);
+
+    commit(merge(merge(left, built), right), &edit);
+    return replaced;
+}
+
+void Buffer::restore(const Buffer_snapshot& snapshot,
+        size_t offset, size_t removed, size_t inserted)
+{
+    Buffer_edit edit;
+    edit.offset = offset;
+    edit.removed = removed;
+    edit.inserted = inserted;
+    edit.line = current.line_of(offset);
+    edit.removed_lines = current.line_of(offset + removed) - edit.line;
+    edit.inserted_lines = snapshot.line_of(offset + inserted) - edit.line;
+
+    commit(snapshot.root, &edit);
+}
+
+void Buffer::listen(Buffer_listener* listener)
+{
+    listeners.push_back(listener);
+}
+
+void Buffer::unlisten(Buffer_listener* listener)
+{
+    listeners.erase(
+            std::remove(listeners.begin(), listeners.end(), listener),
+            listeners.end());
+}
+
+// Installs a new tree and tells everyone about it.
+void Buffer::set_saved(const Buffer_snapshot& snapshot)
+{
+    saved = snapshot;
+    modified = current.root != saved.root;
+
+    for (Listener_list::const_iterator cit = listeners.begin(),
+            end = listeners.end();
+            cit != end;
+            ++cit)
+    {
+        (*cit)->written(this);
+    }
+}
+
+void Buffer::append_saved(const Buffer_snapshot& text)
+{
+    if (text.root.empty())
+        return;
+
+    Buffer_edit edit;
+    edit.offset = this->size();
+    edit.line = current.line_of(edit.offset);
+    edit.inserted = text.size();
+    edit.inserted_lines = count_newlines(text.root);
+
+    Ref<Piece_node> root = merge(current.root, text.root);
+    if (!modified)
+        saved = Buffer_snapshot(root);
+    commit(root, &edit);
+}
+
+void Buffer::commit(const Ref<Piece_node>& root, Buffer_edit* edit)
+{
+    edit->before = current;
+    edit->generation = ++generation;
+    current = Buffer_snapshot(root);
+    modified = current.root != saved.root;
+
+    for (Listener_list::const_iterator cit = listeners.begin(),
+            end = listeners.end();
+            cit != end;
+            ++cit)
+    {
+        (*cit)->edited(this, *edit);
+    }
+}
@@ -0,0 +1,487 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/completion.hpp>
+#include <rotide/events.hpp>
+#include <rotide/thread.hpp>
+#include <rotide/view.hpp>
+
+#include <algorithm>
+#include <queue>
+
+namespace {
+
+// Words shorter than this are not worth completing, and ones longer than
+// this are more likely data than names.
+const size_t MIN_WORD = 3;
+const size_t MAX_WORD = 64;
+
+// Edits reading more than this are counted on the thread pool.
+const size_t SYNC_BYTES = 64 * 1024;
+
+// How many completions are cycled through.
+const size_t MAX_CHOICES = 32;
+
+const unsigned NOT_FOUND = unsigned(-1);
+
+bool is_word(char c)
+{
+    unsigned char byte = c;
+    return (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z')
+        || (byte >= '0' && byte <= '9') || byte == '_' || byte >= 0x80;
+}
+
+bool cancelled(Word_run* run)
+{
+    return run != NULL && __sync_fetch_and_add(&run->cancelled, 0) != 0;
+}
+
+// Where the word holding offset starts. A word too long to be counted
+// is cut off, and the caller told.
+size_t word_start(const Buffer_snapshot& snapshot, size_t offset,
+        bool* clipped)
+{
+    size_t start = offset;
+    while (start > 0 && is_word(snapshot.at(start - 1))) {
+        if (offset - start == MAX_WORD) {
+            *clipped = true;
+            break;
+        }
+        --start;
+    }
+    return start;
+}
+
+size_t word_end(const Buffer_snapshot& snapshot, size_t offset,
+        bool* clipped)
+{
+    Piece_iterator it(snapshot, offset);
+    const char* data;
+    size_t size, end = offset;
+    while (it.next(&data, &size)) {
+        for (size_t i = 0; i < size; ++i, ++end) {
+            if (!is_word(data[i]))
+                return end;
+            if (end - offset == MAX_WORD) {
+                *clipped = true;
+                return end;
+            }
+        }
+    }
+    return end;
+}
+
+// Counts the words in [begin, end) by delta. A word cut off at either
+// end is left out. Returns false if the run was cancelled.
+bool count_words(const Buffer_snapshot& snapshot, size_t begin, size_t end,
+        bool skip_first, bool skip_last, int delta, Word_trie* counts,
+        Word_run* run)
+{
+    if (begin >= end)
+        return true;
+
+    char word[MAX_WORD];
+    size_t length = 0;
+    bool skipping = skip_first;
+
+    Piece_iterator it(snapshot, begin);
+    const char* data;
+    size_t size, at = begin;
+    while (at < end && it.next(&data, &size)) {
+        if (cancelled(run))
+            return false;
+
+        size = std::min(size, end - at);
+        for (size_t i = 0; i < size; ++i) {
+            if (is_word(data[i])) {
+                if (length < MAX_WORD)
+                    word[length] = data[i];
+                ++length;
+                continue;
+            }
+
+            if (length == 0)
+                continue;
+            if (!skipping && length >= MIN_WORD && length <= MAX_WORD
+                    && !(word[0] >= '0' && word[0] <= '9'))
+            {
+                counts->add(word, length, delta);
+            }
+            skipping = false;
+            length = 0;
+        }
+        at += size;
+    }
+
+    if (length >= MIN_WORD && length <= MAX_WORD && !skipping && !skip_last
+            && !(word[0] >= '0' && word[0] <= '9'))
+    {
+        counts->add(word, length, delta);
+    }
+    return true;
+}
+
+// A choice while completing: a word with its count, or a subtree with
+// the best count in it. Words go before subtrees that are as good, so
+// the shorter of two equally common words comes first.
+struct Candidate {
+    Candidate(int value, unsigned node, bool whole)
+        : value(value), node(node), whole(whole) { }
+
+    bool operator<(const Candidate& other) const
+    {
+        if (value != other.value)
+            return value < other.value;
+        return !whole && other.whole;
+    }
+
+    int value;
+    unsigned node;
+    bool whole;
+};
+
+class Words_counted : public Event {
+public:
+    Words_counted(Word_index* index, const Ref<Word_run>& run,
+            Word_trie* counts)
+        : index(index), counting(run), counts(counts) { }
+    ~Words_counted() { delete counts; }
+
+    void run() { index->counted(counting.get(), counts); }
+
+private:
+    Word_index* index;
+    Ref<Word_run> counting;
+    Word_trie* counts;
+};
+
+// Counts what an edit took out of before and put into after.
+class Word_job : public Job {
+public:
+    Word_job(Word_index* index, Event_queue* events,
+            const Ref<Word_run>& run, const Buffer_snapshot& before,
+            size_t begin, size_t before_end, const Buffer_snapshot& after,
+            size_t after_end, bool clipped_begin, bool clipped_end)
+        : index(index), events(events), counting(run), before(before),
+          after(after), begin(begin), before_end(before_end),
+          after_end(after_end), clipped_begin(clipped_begin),
+          clipped_end(clipped_end)
+    {
+    }
+
+    void run();
+
+private:
+    Word_index* index;
+    Event_queue* events;
+    Ref<Word_run> counting;
+    Buffer_snapshot before, after;
+    size_t begin, before_end, after_end;
+    bool clipped_begin, clipped_end;
+};
+
+void Word_job::run()
+{
+    Word_trie* counts = new Word_trie;
+    if (!count_words(before, begin, before_end, clipped_begin, clipped_end,
+                -1, counts, counting.get())
+            || !count_words(after, begin, after_end, clipped_begin,
+                clipped_end, 1, counts, counting.get()))
+    {
+        delete counts;
+        return;
+    }
+    events->post(new Words_counted(index, counting, counts));
+}
+
+} // namespace
+
+Word_trie::Word_trie()
+{
+    Word_node root = { 0, 0, 0, 0, 0, 0 };
+    nodes.push_back(root);
+}
+
+// The nodes on the way down are made if they are missing, even for a
+// negative delta: the word may be counted in a trie that is added later.
+// The best counts are then fixed on the way back up, as far as they
+// change; only a count going down has to look at siblings.
+void Word_trie::add(const char* word, size_t size, int delta)
+{
+    unsigned node = 0;
+    for (size_t i = 0; i < size; ++i)
+        node = child_of(node, word[i]);
+
+    nodes[node].count += delta;
+
+    // A count going up can only raise the best counts above it.
+    if (delta > 0) {
+        int count = nodes[node].count;
+        for (;;) {
+            if (nodes[node].best >= count)
+                break;
+            nodes[node].best = count;
+            if (node == 0)
+                break;
+            node = nodes[node].parent;
+        }
+        return;
+    }
+
+    for (;;) {
+        int best = std::max(nodes[node].count, 0);
+        for (unsigned child = nodes[node].child; child != 0;
+                child = nodes[child].sibling)
+        {
+            best = std::max(best, nodes[child].best);
+        }
+
+        if (best == nodes[node].best)
+            break;
+        nodes[node].best = best;
+        if (node == 0)
+            break;
+        node = nodes[node].parent;
+    }
+}
+
+// Best first: the most promising word or subtree is always taken next,
+// so once limit words are out nothing else can beat them.
+void Word_trie::complete(const std::string& prefix, size_t limit,
+        Word_list* words) const
+{
+    unsigned start = find(prefix.data(), prefix.size());
+    if (start == NOT_FOUND || nodes[start].best <= 0)
+        return;
+
+    std::priority_queue<Candidate> queue;
+    for (unsigned child = nodes[start].child; child != 0;
+            child = nodes[child].sibling)
+    {
+        if (nodes[child].best > 0)
+            queue.push(Candidate(nodes[child].best, child, false));
+    }
+
+    size_t found = 0;
+    while (!queue.empty() && found < limit) {
+        Candidate next = queue.top();
+        queue.pop();
+
+        if (next.whole) {
+            words->push_back(word_of(next.node));
+            ++found;
+            continue;
+        }
+
+        const Word_node& node = nodes[next.node];
+        if (node.count > 0)
+            queue.push(Candidate(node.count, next.node, true));
+        for (unsigned child = node.child; child != 0;
+                child = nodes[child].sibling)
+        {
+            if (nodes[child].best > 0)
+                queue.push(Candidate(nodes[child].best, child, false));
+        }
+    }
+}
+
+// Nodes always come after their parents, so walking other in order
+// finds every parent already placed here. The best counts are then
+// redone from the deepest touched node up.
+void Word_trie::merge(const Word_trie& other)
+{
+    std::vector<unsigned> placed(other.nodes.size(), 0);
+    for (unsigned node = 1; node < other.nodes.size(); ++node) {
+        const Word_node& from = other.nodes[node];
+        placed[node] = child_of(placed[from.parent], from.byte);
+        nodes[placed[node]].count += from.count;
+    }
+
+    std::sort(placed.begin(), placed.end());
+    for (std::vector<unsigned>::reverse_iterator it = placed.rbegin(),
+            end = placed.rend();
+            it != end;
+            ++it)
+    {
+        Word_node& node = nodes[*it];
+        node.best = std::max(node.count, 0);
+        for (unsigned child = node.child; child != 0;
+                child = nodes[child].sibling)
+        {
+            node.best = std::max(node.best, nodes[child].best);
+        }
+    }
+}
+
+unsigned Word_trie::child_of(unsigned node, char byte)
+{
+    unsigned child = nodes[node].child;
+    while (child != 0 && nodes[child].byte != byte)
+        child = nodes[child].sibling;
+
+    if (child == 0) {
+        Word_node made = { node, 0, nodes[node].child, 0, 0, byte };
+        child = nodes.size();
+        nodes.push_back(made);
+        nodes[node].child = child;
+    }
+    return child;
+}
+
+unsigned Word_trie::find(const char* word, size_t size) const
+{
+    unsigned node = 0;
+    for (size_t i = 0; i < size; ++i) {
+        unsigned child = nodes[node].child;
+        while (child != 0 && nodes[child].byte != word[i])
+            child = nodes[child].sibling;
+        if (child == 0)
+            return NOT_FOUND;
+        node = child;
+    }
+    return node;
+}
+
+std::string Word_trie::word_of(unsigned node) const
+{
+    std::string word;
+    for (; node != 0; node = nodes[node].parent)
+        word += nodes[node].byte;
+    std::reverse(word.begin(), word.end());
+    return word;
+}
+
+Word_index::Word_index(Thread_pool* pool, Event_queue* events)
+    : pool(pool), events(events), completed_buffer(NULL),
+      completed_generation(0), completed_start(0), completed_end(0),
+      choice(-1)
+{
+    run = new Word_run;
+}
+
+Word_index::~Word_index()
+{
+    __sync_lock_test_and_set(&run->cancelled, 1);
+    for (std::vector<Buffer*>::iterator it = buffers.begin(),
+            end = buffers.end();
+            it != end;
+            ++it)
+    {
+        (*it)->unlisten(this);
+    }
+}
+
+// A buffer's words are counted like an edit that put in all of it.
+void Word_index::watch(Buffer* buffer)
+{
+    buffers.push_back(buffer);
+    buffer->listen(this);
+
+    // Binary content is not read for words, only what is typed into it.
+    if (!buffer->binary) {
+        count(Buffer_snapshot(), 0, 0, buffer->snapshot(), buffer->size(),
+                false, false);
+    }
+}
+
+// The words that were around the edited text before and after it are
+// told apart from the rest by the text in front of the edit, which is
+// the same in both, and the text after it.
+void Word_index::edited(Buffer* buffer, const Buffer_edit& edit)
+{
+    bool clipped_begin = false, clipped_end = false;
+    size_t begin = word_start(edit.before, edit.offset, &clipped_begin);
+    size_t before_end = word_end(edit.before, edit.offset + edit.removed,
+            &clipped_end);
+    size_t after_end = before_end - edit.removed + edit.inserted;
+    count(edit.before, begin, before_end, buffer->snapshot(), after_end,
+            clipped_begin, clipped_end);
+}
+
+void Word_index::complete(const std::string& prefix, size_t limit,
+        Word_list* words) const
+{
+    this->words.complete(prefix, limit, words);
+}
+
+bool Word_index::complete(Buffer_view* view, int step)
+{
+    Buffer* buffer = view->buffer;
+    size_t cursor = view->cursor;
+    bool cycling = completed_buffer == buffer
+        && completed_generation == buffer->generation
+        && completed_end == cursor && !choices.empty();
+
+    if (!cycling) {
+        bool clipped = false;
+        size_t start = word_start(buffer->snapshot(), cursor, &clipped);
+        if (clipped || start == cursor)
+            return false;
+
+        typed = buffer->text(start, cursor - start);
+        choices.clear();
+        words.complete(typed, MAX_CHOICES, &choices);
+        if (choices.empty())
+            return false;
+        completed_start = start;
+        choice = -1;
+    }
+
+    // What was typed sits between the last choice and the first.
+    int places = choices.size() + 1;
+    choice = ((choice + 1 + step) % places + places) % places - 1;
+    const std::string& word = choice < 0 ? typed : choices[choice];
+
+    Range_list ranges(1, Buffer_range(completed_start,
+                cursor - completed_start));
+    buffer->replace(ranges, word.data(), word.size());
+    view->set_offset(completed_start + word.size());
+
+    completed_buffer = buffer;
+    completed_generation = buffer->generation;
+    completed_end = view->cursor;
+    return true;
+}
+
+// The bigger of the two tries is kept and the smaller added to it, so
+// taking in a whole buffer costs only what was edited while it was read.
+void Word_index::counted(Word_run* finished, Word_trie* counts)
+{
+    if (finished != run.get())
+        return;
+
+    if (counts->size() > words.size())
+        words.swap(*counts);
+    words.merge(*counts);
+}
+
+void Word_index::count(const Buffer_snapshot& before, size_t begin,
+        size_t before_end, const Buffer_snapshot& after, size_t after_end,
+        bool clipped_begin, bool clipped_end)
+{
+    if ((before_end - begin) + (after_end - begin) > SYNC_BYTES) {
+        pool->submit(new Word_job(this, events, run, before, begin,
+                    before_end, after, after_end, clipped_begin,
+                    clipped_end));
+        return;
+    }
+
+    count_words(before, begin, before_end, clipped_begin, clipped_end, -1,
+            &words, NULL);
+    count_words(after, begin, after_end, clipped_begin, clipped_end, 1,
+            &words, NULL);
+}
@@ -14,6 +14,14 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
 #include "rotide/curses.hpp"
 
 #include <csignal>
@@ -31,6 +39,59 @@ namespace {
 typedef std::vector<Curses*> Curses_instances;
 Curses_instances instances;
 
+// Terminals that support it wrap pasted text in these sequences once
+// bracketed paste mode is turned on.
+const char PASTE_ON[] = "\033[?2004h";
+const char PASTE_OFF[] = "\033[?2004l";
+const char PASTE_BEGIN[] = "[200~";
+const char PASTE_END[] = "\033[201~";
+
+// A burst is at least this many bytes already waiting to be read. It
+// lasts for as long as more keeps arriving within BURST_WAIT ms.
+const size_t BURST_SIZE = 32;
+const int BURST_WAIT = 5;
+
+// Bytes the terminal has sent that nobody has read yet.
+size_t queued_input()
+{
+    int bytes = 0;
+    if (ioctl(STDIN_FILENO, FIONREAD, &bytes) < 0)
+        return 0;
+    return bytes;
+}
+
+bool wait_for_input(int ms)
+{
+    struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+    return poll(&fd, 1, ms) > 0;
+}
+
+// Reads whatever is available straight from the terminal, skipping the
+// per-character path through curses. The terminal sends Enter as CR, so
+// CR becomes NL here as wgetch would make it in nl() mode. A CR LF pair,
+// which pasted line breaks can come as, is one NL.
+ssize_t read_input(std::string* text, size_t most)
+{
+    char chunk[64 * 1024];
+    ssize_t bytes;
+    do {
+        bytes = read(STDIN_FILENO, chunk, std::min(most, sizeof(chunk)));
+    } while (bytes < 0 && errno == EINTR);
+
+    for (ssize_t i = 0; i < bytes; ++i) {
+        if (chunk[i] != '\r')
+            *text += chunk[i];
+        else if (i + 1 == bytes || chunk[i + 1] != '\n')
+            *text += '\n';
+    }
+    return bytes;
+}
+
+bool not_text(char c)
+{
+    return !is_text(c);
+}
+
 } // namespace
 
 
@@ -54,7 +115,7 @@ void terminal_resized(int signal)
     }
 }
 
-Curses::Curses()
+Curses::Curses() : held(0)
 {
     int row, col;
     std::signal(SIGWINCH, terminal_resized);
@@ -75,6 +136,10 @@ Curses::Curses()
     keypad(stdscr, TRUE);
     noecho();
 
+    // Ask the terminal to mark pastes so they can skip the key bindings.
+    fputs(PASTE_ON, stdout);
+    fflush(stdout);
+
     // Create a screen buffer
     getmaxyx(stdscr, row, col);
     active_window = newwin(row - 2, col, 0, 0);
@@ -137,14 +202,32 @@ void Curses::resize()
 //                 down, all the instances shut down. DANGER WILL ROBINSON.
 void Curses::shutdown()
 {
+    fputs(PASTE_OFF, stdout);
+    fflush(stdout);
     endwin();
 }
 
 // Refresh the active_window window. Make the curses go to the appropriate position.
 void Curses::refresh()
 {
-    wrefresh(status_window);
-    wrefresh(touched_window);
+    if (held)
+        return;
+
+    wnoutrefresh(status_window);
+    wnoutrefresh(touched_window);
+    doupdate();
+}
+
+void Curses::hold()
+{
+    ++held;
+}
+
+void Curses::release()
+{
+    assert(held > 0);
+    if (--held == 0)
+        refresh();
 }
 
 // Draws a line in the terminal at the current position.
@@ -174,13 +257,122 @@ bool Curses::check_cursor(int mx, int my)
 // TODO(justinvh): The CTRL_C break is a temporary thing.
 bool Curses::get(char* s)
 {
-    *s = wgetch(active_window);
+    if (!pending.empty()) {
+        *s = pending.front();
+        pending.pop_front();
+    } else {
+        *s = wgetch(active_window);
+    }
     last_key = (int)*s;
     if (*s == CTRL_C)
         return false;
     return true;
 }
 
+// Keys the terminal has already sent are moved to the pending queue
+// with a raw read. Going through wgetch instead would refresh the active
+// window and show whatever half of a frame has been drawn so far.
+bool Curses::ready()
+{
+    if (pending.empty()) {
+        std::string text;
+        size_t queued = queued_input();
+        if (queued && read_input(&text, queued) > 0)
+            pending.insert(pending.end(), text.begin(), text.end());
+    }
+    return !pending.empty();
+}
+
+// A signal such as a resize counts as a key, since curses turns it into
+// one.
+bool Curses::idle(int fd)
+{
+    if (!pending.empty())
+        return true;
+
+    struct pollfd fds[2] = {
+        { STDIN_FILENO, POLLIN, 0 },
+        { fd, POLLIN, 0 }
+    };
+    if (poll(fds, 2, -1) < 0)
+        return true;
+    return fds[0].revents != 0 || fds[1].revents == 0;
+}
+
+// Looks at what follows an ESC for the start of a bracketed paste. If
+// it is one, everything up to the closing sequence is read in as is. If it
+// is not, the bytes looked at are queued up for get() again.
+//
+// Waiting for the next byte costs at most ESCDELAY, the same delay curses
+// would spend telling ESC apart from an escape sequence.
+bool Curses::get_paste(std::string* text)
+{
+    std::string head;
+    while (head.size() < sizeof(PASTE_BEGIN) - 1) {
+        if (!pending.empty()) {
+            head += pending.front();
+            pending.pop_front();
+        } else if (!wait_for_input(ESCDELAY) || read_input(&head, 1) <= 0) {
+            break;
+        }
+
+        if (head.compare(0, head.size(), PASTE_BEGIN, head.size()) != 0)
+            break;
+    }
+
+    if (head != PASTE_BEGIN) {
+        pending.insert(pending.begin(), head.begin(), head.end());
+        return false;
+    }
+
+    text->assign(pending.begin(), pending.end());
+    pending.clear();
+
+    size_t end, searched = 0;
+    const size_t marker = sizeof(PASTE_END) - 1;
+    while ((end = text->find(PASTE_END, searched)) == std::string::npos) {
+        searched = text->size() < marker ? 0 : text->size() - marker;
+        if (read_input(text, 64 * 1024) <= 0)
+            break;
+    }
+
+    if (end != std::string::npos) {
+        pending.insert(pending.end(), text->begin() + end + marker,
+                text->end());
+        text->resize(end);
+    }
+
+    return true;
+}
+
+// Collects a burst of input. The burst stops in front of the first byte
+// that is not text (see is_text), so ESC, CTRL+C, backspace and the
+// other keys with bindings still go through get().
+bool Curses::get_burst(const char c, std::string* text)
+{
+    if (pending.size() + queued_input() < BURST_SIZE)
+        return false;
+
+    text->assign(1, c);
+    text->append(pending.begin(), pending.end());
+    pending.clear();
+
+    do {
+        size_t queued = queued_input();
+        if (queued && read_input(text, queued) <= 0)
+            break;
+    } while (wait_for_input(BURST_WAIT));
+
+    size_t stop = std::find_if(text->begin(), text->end(), not_text)
+        - text->begin();
+    if (stop < text->size()) {
+        pending.insert(pending.end(), text->begin() + stop, text->end());
+        text->resize(stop);
+    }
+
+    return true;
+}
+
 // Inserts a character into the screen buffer. This is different then
 // echoing characters onto the screen.
 void Curses::insert(const int row, const int col, const char c)
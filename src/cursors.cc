@@ -0,0 +1,357 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/cursors.hpp>
+#include <rotide/curses_types.hpp>
+
+#include <cstdlib>
+
+#include <rotide/curses.hpp>
+
+using namespace curses_lib;
+
+namespace {
+
+bool by_start(const Selection& a, const Selection& b)
+{
+    return a.start() < b.start()
+        || (a.start() == b.start() && a.end() < b.end());
+}
+
+bool ends_before(const Selection& selection, size_t offset)
+{
+    return selection.end() < offset;
+}
+
+// Where an offset ends up after an edit someone else made. One in text
+// that was replaced keeps its place in the new text if it can.
+size_t moved(size_t offset, const Buffer_edit& edit)
+{
+    if (offset < edit.offset)
+        return offset;
+    if (offset >= edit.offset + edit.removed)
+        return offset + edit.inserted - edit.removed;
+    return edit.offset + std::min(offset - edit.offset, edit.inserted);
+}
+
+size_t char_before(const Buffer* buffer, size_t offset)
+{
+    if (offset == 0)
+        return 0;
+
+    --offset;
+    while (offset > 0 && (buffer->at(offset) & 0xC0) == 0x80)
+        --offset;
+    return offset;
+}
+
+} // namespace
+
+Cursor_set::Cursor_set(Buffer_view* view)
+    : view(view), buffer(view->buffer), primary(0), editing(false)
+{
+    cursor_attr = COLOR_PAIR(COLOR(BLACK, WHITE)());
+    selection_attr = COLOR_PAIR(COLOR(WHITE, BLUE)());
+
+    buffer->listen(this);
+    view->add_highlighter(this);
+}
+
+Cursor_set::~Cursor_set()
+{
+    view->remove_highlighter(this);
+    buffer->unlisten(this);
+}
+
+// Edits made some other way, such as undo, move the cursors like
+// anchors. The ones made here place the cursors themselves.
+void Cursor_set::edited(Buffer*, const Buffer_edit& edit)
+{
+    if (editing)
+        return;
+
+    for (Selection_list::iterator it = selections.begin(),
+            end = selections.end();
+            it != end;
+            ++it)
+    {
+        *it = Selection(moved(it->anchor, edit), moved(it->head, edit));
+    }
+}
+
+// Only the selections overlapping [begin, end) are looked at. The main
+// cursor is the terminal's own.
+void Cursor_set::highlight(size_t begin, size_t end,
+        Highlight_list* highlights)
+{
+    if (!active() || begin >= end)
+        return;
+
+    Selection_list::const_iterator first = selections.begin();
+    Selection_list::const_iterator last = selections.end();
+    Selection_list::const_iterator it = std::lower_bound(first, last, begin,
+            ends_before);
+    for (; it != last && it->start() < end; ++it) {
+        if (it->end() > it->start()) {
+            highlights->push_back(Highlight(it->start(),
+                        it->end() - it->start(), selection_attr));
+        }
+
+        if (size_t(it - first) != primary && it->head >= begin
+                && it->head < end)
+        {
+            highlights->push_back(Highlight(it->head, 1, cursor_attr));
+        }
+    }
+}
+
+bool Cursor_set::active() const
+{
+    return view->buffer == buffer && !selections.empty();
+}
+
+size_t Cursor_set::count() const
+{
+    return active() ? selections.size() : 1;
+}
+
+bool Cursor_set::select(const Range_list& ranges)
+{
+    if (view->buffer != buffer || ranges.empty())
+        return false;
+
+    selections.clear();
+    for (Range_list::const_iterator it = ranges.begin(), end = ranges.end();
+            it != end;
+            ++it)
+    {
+        selections.push_back(Selection(it->offset, it->offset + it->length));
+    }
+
+    normalize(view->cursor);
+    view->set_offset(selections[primary].head);
+    return true;
+}
+
+bool Cursor_set::add_column(long lines)
+{
+    if (view->buffer != buffer || lines == 0)
+        return false;
+
+    take_cursor();
+    size_t head = selections[primary].head;
+    size_t line = buffer->line_of(head);
+    size_t column = head - buffer->line_start(line);
+    size_t added = 0;
+
+    for (long step = 1; step <= std::abs(lines); ++step) {
+        if (lines < 0 && (size_t)step > line)
+            break;
+        size_t target = lines < 0 ? line - step : line + step;
+        if (target >= buffer->lines())
+            break;
+
+        size_t at = std::min(buffer->line_start(target) + column,
+                buffer->line_end(target));
+        selections.push_back(Selection(at, at));
+        ++added;
+    }
+
+    normalize(head);
+    return added > 0;
+}
+
+void Cursor_set::clear()
+{
+    selections.clear();
+    primary = 0;
+}
+
+void Cursor_set::insert(const char* data, size_t size)
+{
+    take_cursor();
+
+    Range_list ranges;
+    ranges.reserve(selections.size());
+    for (Selection_list::const_iterator it = selections.begin(),
+            end = selections.end();
+            it != end;
+            ++it)
+    {
+        ranges.push_back(Buffer_range(it->start(), it->end() - it->start()));
+    }
+    apply(ranges, data, size);
+}
+
+// The character a cursor takes back can be the last one of the selection
+// before it, which is already going; then it takes nothing.
+void Cursor_set::backspace()
+{
+    take_cursor();
+
+    Range_list ranges;
+    ranges.reserve(selections.size());
+    size_t done = 0;
+    for (Selection_list::const_iterator it = selections.begin(),
+            end = selections.end();
+            it != end;
+            ++it)
+    {
+        size_t start = it->start();
+        if (start == it->end())
+            start = std::max(char_before(buffer, start), done);
+        ranges.push_back(Buffer_range(start, it->end() - start));
+        done = it->end();
+    }
+    apply(ranges, NULL, 0);
+}
+
+void Cursor_set::move_columns(long delta)
+{
+    take_cursor();
+
+    for (Selection_list::iterator it = selections.begin(),
+            stop = selections.end();
+            it != stop;
+            ++it)
+    {
+        size_t head = it->head;
+        size_t line = buffer->line_of(head);
+        size_t start = buffer->line_start(line);
+        size_t end = buffer->line_end(line);
+        long left = delta;
+
+        for (; left > 0 && head < end; --left) {
+            ++head;
+            while (head < end && (buffer->at(head) & 0xC0) == 0x80)
+                ++head;
+        }
+
+        for (; left < 0 && head > start; ++left) {
+            --head;
+            while (head > start && (buffer->at(head) & 0xC0) == 0x80)
+                --head;
+        }
+
+        *it = Selection(head, head);
+    }
+
+    normalize(selections[primary].head);
+    view->set_offset(selections[primary].head);
+}
+
+void Cursor_set::move_lines(long delta)
+{
+    take_cursor();
+
+    long last = (long)buffer->lines() - 1;
+    for (Selection_list::iterator it = selections.begin(),
+            stop = selections.end();
+            it != stop;
+            ++it)
+    {
+        size_t line = buffer->line_of(it->head);
+        size_t column = it->head - buffer->line_start(line);
+        size_t target = std::max(0L, std::min((long)line + delta, last));
+        size_t head = std::min(buffer->line_start(target) + column,
+                buffer->line_end(target));
+        *it = Selection(head, head);
+    }
+
+    normalize(selections[primary].head);
+    view->set_offset(selections[primary].head);
+}
+
+// The view's cursor is the main one, wherever it has been moved to.
+void Cursor_set::take_cursor()
+{
+    if (selections.empty()) {
+        selections.push_back(Selection(view->cursor, view->cursor));
+        primary = 0;
+    } else if (selections[primary].head != view->cursor) {
+        selections[primary] = Selection(view->cursor, view->cursor);
+    }
+    normalize(view->cursor);
+}
+
+// Sorts the selections and joins those that overlap, or that touch when
+// one of them is a plain cursor. The main one is then the one holding
+// head, or the first after it.
+void Cursor_set::normalize(size_t head)
+{
+    std::sort(selections.begin(), selections.end(), by_start);
+
+    Selection_list joined;
+    joined.reserve(selections.size());
+    for (Selection_list::const_iterator it = selections.begin(),
+            end = selections.end();
+            it != end;
+            ++it)
+    {
+        if (!joined.empty()) {
+            Selection& last = joined.back();
+            bool touching = it->start() == last.end()
+                && (it->start() == it->end() || last.start() == last.end());
+            if (it->start() < last.end() || touching) {
+                size_t start = last.start();
+                size_t stop = std::max(last.end(), it->end());
+                last = last.head < last.anchor
+                    ? Selection(stop, start) : Selection(start, stop);
+                continue;
+            }
+        }
+        joined.push_back(*it);
+    }
+    selections.swap(joined);
+
+    primary = std::lower_bound(selections.begin(), selections.end(), head,
+            ends_before) - selections.begin();
+    if (primary == selections.size())
+        primary = selections.size() - 1;
+    if (view->cursor != selections[primary].head)
+        view->set_offset(selections[primary].head);
+}
+
+// The ranges are those of the selections, in the same order, and do not
+// overlap, so each cursor's place follows from the ones before it.
+void Cursor_set::apply(const Range_list& ranges, const char* data,
+        size_t size)
+{
+    bool changes = size > 0;
+    for (Range_list::const_iterator it = ranges.begin(), end = ranges.end();
+            !changes && it != end;
+            ++it)
+    {
+        changes = it->length > 0;
+    }
+    if (!changes)
+        return;
+
+    editing = true;
+    buffer->replace(ranges, data, size);
+    editing = false;
+
+    long shift = 0;
+    for (size_t i = 0; i < ranges.size(); ++i) {
+        size_t at = ranges[i].offset + shift + size;
+        selections[i] = Selection(at, at);
+        shift += (long)size - (long)ranges[i].length;
+    }
+
+    normalize(selections[primary].head);
+    view->set_offset(selections[primary].head);
+}
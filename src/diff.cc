@@ -0,0 +1,259 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/diff.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Middles bigger than this, in bytes or lines on either side, are not
+// diffed by lines.
+const size_t MAX_DIFF_BYTES = 16 * 1024 * 1024;
+const size_t MAX_DIFF_LINES = 256 * 1024;
+
+// Past this many lines taken out or put in the middle is one hunk.
+const int MAX_EDITS = 4096;
+
+// The back is compared this much at a time.
+const size_t CHUNK = 64 * 1024;
+
+struct Diff_line {
+    size_t offset, size;
+    unsigned long long hash;
+};
+
+typedef std::vector<Diff_line> Diff_line_list;
+
+// How many bytes at the front of before are the first bytes of after.
+// Only a piece of after itself is passed over without comparing it.
+size_t common_prefix(const Buffer_snapshot& before, const Buffer_block& after)
+{
+    Piece_iterator it(before, 0);
+    const Piece* piece;
+    size_t skip, at = 0;
+    while (at < after.used && it.next_piece(&piece, &skip)) {
+        const Buffer_block* block = piece->block.get();
+        size_t start = piece->start + skip;
+        size_t size = std::min(piece->length - skip, after.used - at);
+        if (block == &after && start == at) {
+            at += size;
+            continue;
+        }
+
+        const char* a = block->data + start;
+        const char* b = after.data + at;
+        if (memcmp(a, b, size) != 0) {
+            size_t i = 0;
+            while (a[i] == b[i])
+                ++i;
+            return at + i;
+        }
+        at += size;
+    }
+    return at;
+}
+
+// How many bytes at the back of before are the last bytes of after, up
+// to most.
+size_t common_suffix(const Buffer_snapshot& before, const Buffer_block& after,
+        size_t most)
+{
+    std::vector<char> chunk(CHUNK);
+    size_t size = before.size(), matched = 0;
+    while (matched < most) {
+        size_t run = std::min(CHUNK, most - matched);
+        before.read(size - matched - run, run, &chunk[0]);
+        const char* a = &chunk[0];
+        const char* b = after.data + after.used - matched - run;
+        if (memcmp(a, b, run) == 0) {
+            matched += run;
+            continue;
+        }
+
+        size_t i = run;
+        while (a[i - 1] == b[i - 1])
+            --i;
+        return matched + run - i;
+    }
+    return matched;
+}
+
+// FNV-1a over each line, newline included.
+void split_lines(const char* data, size_t size, Diff_line_list* lines)
+{
+    Diff_line line = { 0, 0, 14695981039346656037ULL };
+    for (size_t i = 0; i < size; ++i) {
+        line.hash = (line.hash ^ (unsigned char)data[i]) * 1099511628211ULL;
+        if (data[i] == '\n') {
+            line.size = i + 1 - line.offset;
+            lines->push_back(line);
+            line.offset = i + 1;
+            line.hash = 14695981039346656037ULL;
+        }
+    }
+    if (line.offset < size) {
+        line.size = size - line.offset;
+        lines->push_back(line);
+    }
+}
+
+bool equal(const Diff_line& a, const Diff_line& b)
+{
+    return a.hash == b.hash && a.size == b.size;
+}
+
+// Where line i starts, or the end for one past the last.
+size_t line_offset(const Diff_line_list& lines, size_t i, size_t size)
+{
+    return i < lines.size() ? lines[i].offset : size;
+}
+
+// Myers' greedy diff over lines, keeping every round's furthest points
+// to walk the shortest edit script back from the end. The hunks are in
+// lines. Returns false if it takes more than MAX_EDITS.
+bool diff_lines(const Diff_line_list& a, const Diff_line_list& b,
+        Diff_hunk_list* hunks)
+{
+    int n = a.size(), m = b.size();
+    int most = std::min(n + m, MAX_EDITS);
+    int zero = most + 1;
+    std::vector<int> v(2 * most + 3, 0);
+    std::vector<std::vector<int> > trace;
+    int found = -1;
+
+    for (int d = 0; d <= most && found < 0; ++d) {
+        for (int k = -d; k <= d; k += 2) {
+            int x;
+            if (k == -d || (k != d && v[zero + k - 1] < v[zero + k + 1]))
+                x = v[zero + k + 1];
+            else
+                x = v[zero + k - 1] + 1;
+
+            int y = x - k;
+            while (x < n && y < m && equal(a[x], b[y])) {
+                ++x;
+                ++y;
+            }
+            v[zero + k] = x;
+
+            if (x >= n && y >= m) {
+                found = d;
+                break;
+            }
+        }
+        trace.push_back(std::vector<int>(v.begin() + zero - d,
+                    v.begin() + zero + d + 1));
+    }
+    if (found < 0)
+        return false;
+
+    // Each round back is one line taken out or put in, after which the
+    // script follows a diagonal. Edits next to each other make one hunk.
+    Diff_hunk_list reversed;
+    int x = n, y = m;
+    for (int d = found; d > 0; --d) {
+        const std::vector<int>& prev = trace[d - 1];
+        int k = x - y;
+        bool down = k == -d
+            || (k != d && prev[k - 1 + d - 1] < prev[k + 1 + d - 1]);
+        int prev_k = down ? k + 1 : k - 1;
+        int prev_x = prev[prev_k + d - 1];
+        int prev_y = prev_x - prev_k;
+        int edit_x = down ? prev_x : prev_x + 1;
+        int edit_y = edit_x - k;
+
+        if (!reversed.empty()
+                && (int)reversed.back().offset == edit_x
+                && (int)reversed.back().from == edit_y)
+        {
+            Diff_hunk& hunk = reversed.back();
+            hunk.removed += hunk.offset - prev_x;
+            hunk.inserted += hunk.from - prev_y;
+            hunk.offset = prev_x;
+            hunk.from = prev_y;
+        } else {
+            reversed.push_back(Diff_hunk(prev_x, edit_x - prev_x,
+                        prev_y, edit_y - prev_y));
+        }
+        x = prev_x;
+        y = prev_y;
+    }
+
+    hunks->insert(hunks->end(), reversed.rbegin(), reversed.rend());
+    return true;
+}
+
+} // namespace
+
+void diff(const Buffer_snapshot& before, const Buffer_block& after,
+        Diff_hunk_list* hunks)
+{
+    size_t old_size = before.size(), new_size = after.used;
+    size_t prefix = common_prefix(before, after);
+    if (prefix == old_size && prefix == new_size)
+        return;
+
+    size_t suffix = common_suffix(before, after,
+            std::min(old_size, new_size) - prefix);
+    size_t removed = old_size - prefix - suffix;
+    size_t inserted = new_size - prefix - suffix;
+    Diff_hunk whole(prefix, removed, prefix, inserted);
+    if (removed == 0 || inserted == 0
+            || removed > MAX_DIFF_BYTES || inserted > MAX_DIFF_BYTES)
+    {
+        hunks->push_back(whole);
+        return;
+    }
+
+    std::string old_text = before.text(prefix, removed);
+    Diff_line_list a, b;
+    split_lines(old_text.data(), removed, &a);
+    split_lines(after.data + prefix, inserted, &b);
+
+    Diff_hunk_list lines;
+    if (a.size() > MAX_DIFF_LINES || b.size() > MAX_DIFF_LINES
+            || !diff_lines(a, b, &lines))
+    {
+        hunks->push_back(whole);
+        return;
+    }
+
+    for (Diff_hunk_list::const_iterator cit = lines.begin(),
+            end = lines.end();
+            cit != end;
+            ++cit)
+    {
+        size_t offset = line_offset(a, cit->offset, removed);
+        size_t from = line_offset(b, cit->from, inserted);
+        hunks->push_back(Diff_hunk(prefix + offset,
+                    line_offset(a, cit->offset + cit->removed, removed)
+                        - offset,
+                    prefix + from,
+                    line_offset(b, cit->from + cit->inserted, inserted)
+                        - from));
+    }
+}
+
+bool same(const Buffer_snapshot& before, const Buffer_block& after)
+{
+    return before.size() == after.used
+        && common_prefix(before, after) == after.used;
+}
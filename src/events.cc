@@ -0,0 +1,85 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/events.hpp>
+
+#include <cstddef>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+Event_queue::Event_queue()
+{
+    if (pipe(wake) < 0) {
+        wake[0] = wake[1] = -1;
+        return;
+    }
+
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+    fcntl(wake[0], F_SETFD, FD_CLOEXEC);
+    fcntl(wake[1], F_SETFD, FD_CLOEXEC);
+}
+
+Event_queue::~Event_queue()
+{
+    for (Event_list::iterator it = events.begin(), end = events.end();
+            it != end;
+            ++it)
+    {
+        delete *it;
+    }
+
+    if (wake[0] >= 0) {
+        close(wake[0]);
+        close(wake[1]);
+    }
+}
+
+// Only the first event of a batch writes to the pipe; a full pipe is
+// fine since the reader is going to wake up anyway.
+void Event_queue::post(Event* event)
+{
+    Lock lock(mutex);
+    events.push_back(event);
+    if (events.size() == 1 && wake[1] >= 0) {
+        char byte = 0;
+        ssize_t written = write(wake[1], &byte, 1);
+        (void)written;
+    }
+}
+
+bool Event_queue::dispatch()
+{
+    Event_list batch;
+    {
+        Lock lock(mutex);
+        batch.swap(events);
+
+        char drain[64];
+        while (wake[0] >= 0 && read(wake[0], drain, sizeof(drain)) > 0)
+            ;
+    }
+
+    for (Event_list::iterator it = batch.begin(), end = batch.end();
+            it != end;
+            ++it)
+    {
+        (*it)->run();
+        delete *it;
+    }
+    return !batch.empty();
+}
@@ -0,0 +1,926 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/file_index.hpp>
+#include <rotide/events.hpp>
+#include <rotide/view.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// What the watches are told about.
+const uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MOVED_FROM
+    | IN_MOVED_TO | IN_ONLYDIR;
+
+// Queries score this many entries at a time.
+const size_t CHUNK = 16384;
+
+// The picks show this many paths.
+const size_t PICK_LIMIT = 100;
+
+// Removed entries are squeezed out once there are this many and they
+// are more than half of the index.
+const size_t COMPACT_AT = 4096;
+
+// What a query character is worth, and the bonuses for where it falls.
+const int MATCH_SCORE = 16;
+const int WORD_BONUS = 24;
+const int RUN_BONUS = 16;
+const int NAME_BONUS = 48;
+const int NO_MATCH = INT_MIN;
+
+typedef std::vector<std::string> Name_list;
+
+// Lower case bytes, and the mask bit of each byte. Letters and digits
+// get a bit each; punctuation shares what is left.
+struct Tables {
+    Tables()
+    {
+        for (int c = 0; c < 256; ++c) {
+            lower[c] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+            int l = lower[c];
+            if (l >= 'a' && l <= 'z')
+                bits[c] = uint64_t(1) << (l - 'a');
+            else if (c >= '0' && c <= '9')
+                bits[c] = uint64_t(1) << (26 + c - '0');
+            else if (c > ' ' && c < 127)
+                bits[c] = uint64_t(1) << (36 + c % 28);
+            else
+                bits[c] = 0;
+        }
+    }
+
+    unsigned char lower[256];
+    uint64_t bits[256];
+};
+
+const Tables tables;
+
+uint64_t mask_of(const char* text, size_t length)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < length; ++i)
+        mask |= tables.bits[(unsigned char)text[i]];
+    return mask;
+}
+
+bool starts_word(const char* path, size_t i)
+{
+    if (i == 0)
+        return true;
+
+    char before = path[i - 1];
+    return before == '/' || before == '_' || before == '-' || before == '.'
+        || before == ' '
+        || (before >= 'a' && before <= 'z' && path[i] >= 'A'
+            && path[i] <= 'Z');
+}
+
+// The next byte at or after at that is c, or end. Letters are matched in
+// either case by or-ing in fold, the case bit, first. Eight bytes are
+// looked at a time where they can be: a byte of the word xor'd with c is
+// zero where they match, and the lowest zero byte is found with the
+// usual borrow trick.
+const unsigned char* find_byte(const unsigned char* at,
+        const unsigned char* end, unsigned char c, unsigned char fold)
+{
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    uint64_t want = ones * c, folds = ones * fold;
+    for (; end - at >= 8; at += 8) {
+        uint64_t word;
+        memcpy(&word, at, sizeof(word));
+        word = (word | folds) ^ want;
+        uint64_t zero = (word - ones) & ~word & highs;
+        if (zero)
+            return at + (__builtin_ctzll(zero) >> 3);
+    }
+#endif
+    for (; at != end; ++at) {
+        if ((*at | fold) == c)
+            return at;
+    }
+    return end;
+}
+
+// Scores the query's characters taken in order from path[from, length),
+// each where it first turns up after the one before, or returns NO_MATCH
+// if they are not all there.
+int match(const char* path, size_t length, size_t from,
+        const std::string& query)
+{
+    const unsigned char* begin = (const unsigned char*)path;
+    const unsigned char* at = begin + from;
+    const unsigned char* end = begin + length;
+    int total = 0, run = 0;
+    for (size_t i = 0; i < query.size(); ++i) {
+        unsigned char c = query[i];
+        const unsigned char* found = find_byte(at, end, c,
+                (c >= 'a' && c <= 'z') ? 0x20 : 0);
+        if (found == end)
+            return NO_MATCH;
+
+        run = (i > 0 && found == at) ? run + 1 : 0;
+        total += MATCH_SCORE + RUN_BONUS * run;
+        if (starts_word(path, found - begin))
+            total += WORD_BONUS;
+        at = found + 1;
+    }
+    return total - int(length / 4);
+}
+
+// Whether the query's characters are all in path, in order.
+bool contains(const char* path, size_t length, const std::string& query)
+{
+    const unsigned char* at = (const unsigned char*)path;
+    const unsigned char* end = at + length;
+    for (size_t i = 0; i < query.size(); ++i) {
+        unsigned char c = query[i];
+        at = find_byte(at, end, c, (c >= 'a' && c <= 'z') ? 0x20 : 0);
+        if (at == end)
+            return false;
+        ++at;
+    }
+    return true;
+}
+
+// The longest path that could still score at least worst for a query of
+// this size: one with every character starting a word of the file name,
+// each right after the one before.
+size_t longest_scoring(size_t query, int worst)
+{
+    int runs = int(query * (query - 1) / 2);
+    int best = int(query) * (MATCH_SCORE + WORD_BONUS) + RUN_BONUS * runs
+        + NAME_BONUS;
+    return best < worst ? 0 : size_t(best - worst) * 4 + 3;
+}
+
+// The query is looked for in the file name first, since that is usually
+// what it is meant to name.
+int score(const char* names, const Index_entry& entry,
+        const std::string& query)
+{
+    const char* path = names + entry.offset;
+    int in_name = match(path, entry.length, entry.name, query);
+    if (in_name != NO_MATCH)
+        return in_name + NAME_BONUS;
+    return match(path, entry.length, 0, query);
+}
+
+struct Scored {
+    int score;
+    size_t entry;
+};
+
+typedef std::vector<Scored> Scored_list;
+
+// Higher scores first, then shorter paths, then earlier ones.
+class Better {
+public:
+    explicit Better(const Index_entry* entries) : entries(entries) { }
+
+    bool operator()(const Scored& a, const Scored& b) const
+    {
+        if (a.score != b.score)
+            return a.score > b.score;
+        if (entries[a.entry].length != entries[b.entry].length)
+            return entries[a.entry].length < entries[b.entry].length;
+        return a.entry < b.entry;
+    }
+
+private:
+    const Index_entry* entries;
+};
+
+// One query. The chunks are taken by whoever gets to them first, the
+// main thread or a worker, and each keeps the best few of its own along
+// with every entry that matched. The index can not change while the main
+// thread waits for the last chunk, and a worker that turns up after
+// that finds nothing left to take.
+struct Find_run {
+    Find_run() : refs(0), next(0), done(0) { }
+
+    int refs;
+
+    const char* names;
+    const Index_entry* entries;
+    const size_t* candidates;   // NULL for every entry
+    size_t count;
+
+    std::string query;
+    uint64_t mask;
+    size_t limit;
+
+    size_t chunks;
+    int next;
+    size_t done;
+    Mutex mutex;
+    Condition finished;
+
+    std::vector<Scored_list> best;
+    std::vector<std::vector<size_t> > hits;
+};
+
+void score_chunk(Find_run* find, size_t chunk)
+{
+    size_t begin = chunk * CHUNK;
+    size_t end = std::min(begin + CHUNK, find->count);
+    Better better(find->entries);
+    Scored_list& best = find->best[chunk];
+    std::vector<size_t>& hits = find->hits[chunk];
+
+    size_t longest = size_t(-1);
+    for (size_t i = begin; i < end; ++i) {
+        size_t index = find->candidates ? find->candidates[i] : i;
+        const Index_entry& entry = find->entries[index];
+        if ((entry.mask & find->mask) != find->mask || entry.length == 0)
+            continue;
+
+        // Once there are enough, a path too long to beat the worst of them
+        // is only checked for a match, for the next query to start from.
+        if (entry.length > longest) {
+            if (contains(find->names + entry.offset, entry.length,
+                        find->query))
+                hits.push_back(index);
+            continue;
+        }
+
+        Scored scored;
+        scored.score = score(find->names, entry, find->query);
+        if (scored.score == NO_MATCH)
+            continue;
+
+        scored.entry = index;
+        hits.push_back(index);
+        if (best.size() < find->limit) {
+            best.push_back(scored);
+            std::push_heap(best.begin(), best.end(), better);
+        } else if (better(scored, best.front())) {
+            std::pop_heap(best.begin(), best.end(), better);
+            best.back() = scored;
+            std::push_heap(best.begin(), best.end(), better);
+        } else {
+            continue;
+        }
+
+        if (best.size() == find->limit) {
+            longest = longest_scoring(find->query.size(),
+                    best.front().score);
+        }
+    }
+}
+
+// Scores chunks until there are none left to take.
+void score_chunks(Find_run* find)
+{
+    for (;;) {
+        size_t chunk = __sync_fetch_and_add(&find->next, 1);
+        if (chunk >= find->chunks)
+            return;
+
+        score_chunk(find, chunk);
+
+        Lock lock(find->mutex);
+        if (++find->done == find->chunks)
+            find->finished.signal();
+    }
+}
+
+class Find_job : public Job {
+public:
+    explicit Find_job(const Ref<Find_run>& find) : find(find) { }
+
+    void run() { score_chunks(find.get()); }
+
+private:
+    Ref<Find_run> find;
+};
+
+bool cancelled(Index_run* run)
+{
+    return __sync_fetch_and_add(&run->cancelled, 0) != 0;
+}
+
+// Where a directory of the index is on disk.
+std::string disk_path(const std::string& root, const std::string& path)
+{
+    if (root == ".")
+        return path.empty() ? "." : path;
+    if (!root.empty() && root[root.size() - 1] == '/')
+        return root + path;
+    return root + "/" + path;
+}
+
+bool same_file(const std::string& a, const std::string& b)
+{
+    char real_a[PATH_MAX], real_b[PATH_MAX];
+    return realpath(a.c_str(), real_a) != NULL
+        && realpath(b.c_str(), real_b) != NULL
+        && strcmp(real_a, real_b) == 0;
+}
+
+class Index_found : public Event {
+public:
+    Index_found(File_index* index, const Ref<Index_run>& build,
+            const std::string& path, int watch, const Name_list& files)
+        : index(index), build(build), path(path), watch(watch),
+          files(files) { }
+
+    void run() { index->add(build.get(), path, watch, files); }
+
+private:
+    File_index* index;
+    Ref<Index_run> build;
+    std::string path;
+    int watch;
+    Name_list files;
+};
+
+class Index_done : public Event {
+public:
+    Index_done(File_index* index, const Ref<Index_run>& build)
+        : index(index), build(build) { }
+
+    void run() { index->finished(build.get()); }
+
+private:
+    File_index* index;
+    Ref<Index_run> build;
+};
+
+class Index_changed : public Event {
+public:
+    Index_changed(File_index* index, const Index_change_list& changes)
+        : index(index), changes(changes) { }
+
+    void run() { index->change(changes); }
+
+private:
+    File_index* index;
+    Index_change_list changes;
+};
+
+// Lists one directory, watching it first so nothing made while it is
+// listed is missed, and queues a job for each directory in it. Like the
+// jobs of a :grep, each is counted in pending until it is gone.
+class Directory_job : public Job {
+public:
+    Directory_job(File_index* index, Thread_pool* pool,
+            Event_queue* events, const Ref<Index_run>& build, int inotify,
+            const std::string& root, const std::string& path)
+        : index(index), pool(pool), events(events), build(build),
+          inotify(inotify), root(root), path(path) { }
+
+    ~Directory_job()
+    {
+        if (__sync_sub_and_fetch(&build->pending, 1) == 0)
+            events->post(new Index_done(index, build));
+    }
+
+    static void queue(Thread_pool* pool, Directory_job* job)
+    {
+        __sync_add_and_fetch(&job->build->pending, 1);
+        pool->submit(job);
+    }
+
+    void run()
+    {
+        if (cancelled(build.get()))
+            return;
+
+        std::string disk = disk_path(root, path);
+        int watch = inotify < 0 ? -1
+            : inotify_add_watch(inotify, disk.c_str(), WATCH_MASK);
+
+        DIR* dir = opendir(disk.c_str());
+        if (dir == NULL) {
+            if (watch >= 0)
+                events->post(new Index_found(index, build, path, watch,
+                            Name_list()));
+            return;
+        }
+
+        Name_list files;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL && !cancelled(build.get())) {
+            if (entry->d_name[0] == '.')
+                continue;
+
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                std::string child = disk_path(root, path + entry->d_name);
+                if (lstat(child.c_str(), &st) < 0)
+                    continue;
+                type = S_ISDIR(st.st_mode) ? DT_DIR
+                    : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+
+            if (type == DT_DIR) {
+                queue(pool, new Directory_job(index, pool, events, build,
+                            inotify, root,
+                            path + entry->d_name + "/"));
+            } else if (type == DT_REG) {
+                files.push_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+
+        events->post(new Index_found(index, build, path, watch, files));
+    }
+
+private:
+    File_index* index;
+    Thread_pool* pool;
+    Event_queue* events;
+    Ref<Index_run> build;
+    int inotify;
+    std::string root;
+    std::string path;
+};
+
+} // namespace
+
+File_index::Watcher::Watcher(File_index* index, Event_queue* events, int fd)
+    : index(index), events(events), fd(fd)
+{
+    if (pipe(wake) < 0)
+        wake[0] = wake[1] = -1;
+}
+
+File_index::Watcher::~Watcher()
+{
+    if (wake[0] >= 0) {
+        close(wake[0]);
+        close(wake[1]);
+    }
+}
+
+void File_index::Watcher::stop()
+{
+    if (wake[1] >= 0 && write(wake[1], "", 1) < 0)
+        return;
+    join();
+}
+
+// Reads the watches until stopped, posting what each read brings in
+// one go.
+void File_index::Watcher::run()
+{
+    char data[64 * 1024]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        struct pollfd fds[2];
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake[0];
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[1].revents)
+            return;
+
+        ssize_t size = read(fd, data, sizeof(data));
+        if (size <= 0)
+            continue;
+
+        Index_change_list changes;
+        for (char* at = data; at < data + size; ) {
+            struct inotify_event* event = (struct inotify_event*)at;
+            Index_change change;
+            change.watch = event->wd;
+            change.mask = event->mask;
+            if (event->len)
+                change.name = event->name;
+            changes.push_back(change);
+            at += sizeof(struct inotify_event) + event->len;
+        }
+        events->post(new Index_changed(index, changes));
+    }
+}
+
+File_index::File_index(Thread_pool* pool, Event_queue* events)
+    : pool(pool), events(events), removed(0), indexing(false),
+      inotify(inotify_init()), watcher(NULL), last_valid(false),
+      other(NULL), other_cursor(0)
+{
+    if (inotify >= 0) {
+        fcntl(inotify, F_SETFD, FD_CLOEXEC);
+        watcher = new Watcher(this, events, inotify);
+        if (!watcher->start()) {
+            delete watcher;
+            watcher = NULL;
+        }
+    }
+}
+
+File_index::~File_index()
+{
+    if (!run.empty())
+        __sync_lock_test_and_set(&run->cancelled, 1);
+    if (watcher != NULL) {
+        watcher->stop();
+        delete watcher;
+    }
+    if (inotify >= 0)
+        close(inotify);
+}
+
+bool File_index::start(const std::string& root)
+{
+    struct stat st;
+    if (stat(root.c_str(), &st) < 0 || !S_ISDIR(st.st_mode))
+        return false;
+
+    clear();
+    this->root = root;
+    run = new Index_run;
+    walk("");
+    return true;
+}
+
+void File_index::clear()
+{
+    if (!run.empty())
+        __sync_lock_test_and_set(&run->cancelled, 1);
+
+    for (Watch_map::iterator it = watches.begin(), end = watches.end();
+            it != end;
+            ++it)
+    {
+        inotify_rm_watch(inotify, it->first);
+    }
+
+    names.clear();
+    entries.clear();
+    directories.clear();
+    watches.clear();
+    by_path.clear();
+    removed = 0;
+    last_valid = false;
+    indexing = false;
+}
+
+void File_index::walk(const std::string& path)
+{
+    indexing = true;
+    Directory_job::queue(pool, new Directory_job(this, pool, events, run,
+                inotify, root, path));
+}
+
+void File_index::find(const std::string& query, size_t limit,
+        File_match_list* matches)
+{
+    matches->clear();
+    if (query.empty() || limit == 0) {
+        last_valid = false;
+        return;
+    }
+
+    Ref<Find_run> find(new Find_run);
+    find->names = names.data();
+    find->entries = entries.empty() ? NULL : &entries[0];
+    find->limit = limit;
+    for (size_t i = 0; i < query.size(); ++i)
+        find->query += tables.lower[(unsigned char)query[i]];
+    find->mask = mask_of(find->query.data(), find->query.size());
+
+    // A query typed on from the last one can only match what it did.
+    std::vector<size_t> candidates;
+    if (last_valid && query.compare(0, last_query.size(), last_query) == 0) {
+        candidates.swap(last_hits);
+        find->candidates = candidates.empty() ? NULL : &candidates[0];
+        find->count = candidates.size();
+    } else {
+        find->candidates = NULL;
+        find->count = entries.size();
+    }
+
+    find->chunks = (find->count + CHUNK - 1) / CHUNK;
+    find->best.resize(find->chunks);
+    find->hits.resize(find->chunks);
+
+    size_t helpers = std::min(pool->size(), find->chunks);
+    for (size_t i = 1; i < helpers; ++i)
+        pool->submit(new Find_job(find));
+    score_chunks(find.get());
+    {
+        Lock lock(find->mutex);
+        while (find->done < find->chunks)
+            find->finished.wait(find->mutex);
+    }
+
+    Better better(find->entries);
+    Scored_list best;
+    last_hits.clear();
+    for (size_t i = 0; i < find->chunks; ++i) {
+        best.insert(best.end(), find->best[i].begin(), find->best[i].end());
+        last_hits.insert(last_hits.end(), find->hits[i].begin(),
+                find->hits[i].end());
+    }
+    last_query = query;
+    last_valid = true;
+
+    std::sort(best.begin(), best.end(), better);
+    if (best.size() > limit)
+        best.resize(limit);
+
+    for (Scored_list::const_iterator it = best.begin(), end = best.end();
+            it != end;
+            ++it)
+    {
+        const Index_entry& entry = entries[it->entry];
+        File_match match;
+        match.path.assign(names, entry.offset, entry.length);
+        match.score = it->score;
+        matches->push_back(match);
+    }
+}
+
+size_t File_index::pick(Buffer_view* view, const std::string& query)
+{
+    File_match_list matches;
+    find(query, PICK_LIMIT, &matches);
+
+    std::string text;
+    for (File_match_list::const_iterator it = matches.begin(),
+            end = matches.end();
+            it != end;
+            ++it)
+    {
+        text += it->path;
+        text += '\n';
+    }
+
+    picks.remove(0, picks.size());
+    picks.insert(0, text);
+    if (view->buffer != &picks) {
+        other = view->buffer;
+        other_cursor = view->cursor;
+        view->show(&picks);
+    } else {
+        view->set_offset(0);
+    }
+    return matches.size();
+}
+
+bool File_index::open(Buffer_view* view)
+{
+    if (view->buffer != &picks || other == NULL)
+        return false;
+
+    size_t start = picks.line_start(view->line());
+    std::string path = picks.text(start, picks.line_end(view->line()) - start);
+    if (path.empty() || !same_file(disk_path(root, path), other->path))
+        return false;
+
+    view->show(other);
+    view->set_offset(other_cursor);
+    return true;
+}
+
+void File_index::add(Index_run* build, const std::string& path, int watch,
+        const std::vector<std::string>& files)
+{
+    if (build != run.get()) {
+        if (watch >= 0 && watches.find(watch) == watches.end())
+            inotify_rm_watch(inotify, watch);
+        return;
+    }
+
+    bool fresh;
+    size_t at = directory(path, &fresh);
+    if (watch >= 0) {
+        directories[at].watch = watch;
+        watches[watch] = at;
+    }
+
+    for (std::vector<std::string>::const_iterator it = files.begin(),
+            end = files.end();
+            it != end;
+            ++it)
+    {
+        add_file(at, *it, !fresh);
+    }
+}
+
+void File_index::change(const Index_change_list& changes)
+{
+    for (Index_change_list::const_iterator it = changes.begin(),
+            end = changes.end();
+            it != end;
+            ++it)
+    {
+        // Changes were dropped, so the index can't be trusted any more.
+        if (it->mask & IN_Q_OVERFLOW) {
+            start(root);
+            return;
+        }
+
+        Watch_map::iterator watch = watches.find(it->watch);
+        if (watch == watches.end())
+            continue;
+
+        size_t at = watch->second;
+        if (it->mask & IN_IGNORED) {
+            directories[at].watch = -1;
+            watches.erase(watch);
+            continue;
+        }
+        if (it->name.empty() || it->name[0] == '.')
+            continue;
+
+        bool gone = it->mask & (IN_DELETE | IN_MOVED_FROM);
+        if (it->mask & IN_ISDIR) {
+            std::string path = directories[at].path + it->name + "/";
+            if (gone)
+                remove_directory(path);
+            else
+                walk(path);
+        } else if (gone) {
+            remove_file(at, it->name);
+        } else {
+            struct stat st;
+            std::string disk = disk_path(root,
+                    directories[at].path + it->name);
+            if (lstat(disk.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+                add_file(at, it->name, true);
+        }
+    }
+}
+
+void File_index::finished(Index_run* build)
+{
+    if (build == run.get())
+        indexing = false;
+}
+
+// The directory at path, made if it is new.
+size_t File_index::directory(const std::string& path, bool* fresh)
+{
+    std::map<std::string, size_t>::iterator it = by_path.find(path);
+    if (it != by_path.end()) {
+        *fresh = false;
+        return it->second;
+    }
+
+    Index_directory made;
+    made.path = path;
+    made.watch = -1;
+    made.removed = false;
+    directories.push_back(made);
+    by_path[path] = directories.size() - 1;
+    *fresh = true;
+    return directories.size() - 1;
+}
+
+// Adds a file to a directory. Unless check is false, one that is there
+// already is left alone.
+void File_index::add_file(size_t at, const std::string& name, bool check)
+{
+    Index_directory& directory = directories[at];
+    if (check) {
+        for (std::vector<size_t>::const_iterator
+                it = directory.files.begin(), end = directory.files.end();
+                it != end;
+                ++it)
+        {
+            const Index_entry& entry = entries[*it];
+            if (names.compare(entry.offset + entry.name,
+                        entry.length - entry.name, name) == 0)
+                return;
+        }
+    }
+
+    Index_entry entry;
+    entry.offset = names.size();
+    entry.length = directory.path.size() + name.size();
+    entry.name = directory.path.size();
+    names += directory.path;
+    names += name;
+    entry.mask = mask_of(names.data() + entry.offset, entry.length);
+
+    directory.files.push_back(entries.size());
+    entries.push_back(entry);
+    last_valid = false;
+}
+
+void File_index::remove_file(size_t at, const std::string& name)
+{
+    std::vector<size_t>& files = directories[at].files;
+    for (std::vector<size_t>::iterator it = files.begin(), end = files.end();
+            it != end;
+            ++it)
+    {
+        Index_entry& entry = entries[*it];
+        if (names.compare(entry.offset + entry.name,
+                    entry.length - entry.name, name) != 0)
+            continue;
+
+        entry.length = 0;
+        files.erase(it);
+        ++removed;
+        last_valid = false;
+        break;
+    }
+
+    if (removed >= COMPACT_AT && removed > entries.size() / 2)
+        compact();
+}
+
+// Drops the directory at path and everything under it.
+void File_index::remove_directory(const std::string& path)
+{
+    std::map<std::string, size_t>::iterator it = by_path.lower_bound(path);
+    while (it != by_path.end()
+            && it->first.compare(0, path.size(), path) == 0)
+    {
+        Index_directory& directory = directories[it->second];
+        for (std::vector<size_t>::const_iterator
+                file = directory.files.begin(), end = directory.files.end();
+                file != end;
+                ++file)
+        {
+            entries[*file].length = 0;
+            ++removed;
+        }
+        directory.files.clear();
+        directory.removed = true;
+
+        if (directory.watch >= 0) {
+            inotify_rm_watch(inotify, directory.watch);
+            watches.erase(directory.watch);
+            directory.watch = -1;
+        }
+        by_path.erase(it++);
+    }
+
+    last_valid = false;
+    if (removed >= COMPACT_AT && removed > entries.size() / 2)
+        compact();
+}
+
+// Squeezes out removed entries and the names of removed files.
+void File_index::compact()
+{
+    std::string kept_names;
+    Index_entry_list kept;
+    kept_names.reserve(names.size());
+    kept.reserve(entries.size() - removed);
+
+    for (Index_directory_list::iterator it = directories.begin(),
+            end = directories.end();
+            it != end;
+            ++it)
+    {
+        for (std::vector<size_t>::iterator file = it->files.begin(),
+                files_end = it->files.end();
+                file != files_end;
+                ++file)
+        {
+            Index_entry entry = entries[*file];
+            kept_names.append(names, entry.offset, entry.length);
+            entry.offset = kept_names.size() - entry.length;
+            *file = kept.size();
+            kept.push_back(entry);
+        }
+    }
+
+    names.swap(kept_names);
+    entries.swap(kept);
+    removed = 0;
+    last_valid = false;
+}
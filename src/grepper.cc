@@ -0,0 +1,480 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/grepper.hpp>
+#include <rotide/events.hpp>
+#include <rotide/thread.hpp>
+#include <rotide/view.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <regex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <rotide/curses.hpp>
+
+namespace {
+
+// Files are searched this many to a job.
+const size_t FILES_PER_JOB = 32;
+
+// A file with a NUL byte this close to the start is taken to be binary.
+const size_t BINARY_PROBE = 8000;
+
+// Files this big or bigger are mapped rather than read.
+const size_t MAP_SIZE = 1024 * 1024;
+
+// Matching lines are cut short after this many bytes.
+const size_t MAX_LINE = 200;
+
+const int REGEX_FLAGS = REG_EXTENDED | REG_NEWLINE;
+
+typedef std::vector<std::string> Path_list;
+
+bool cancelled(Grep_run* run)
+{
+    return __sync_fetch_and_add(&run->cancelled, 0) != 0;
+}
+
+size_t count_lines(const char* begin, const char* end)
+{
+    size_t count = 0;
+    while ((begin = (const char*)memchr(begin, '\n', end - begin)) != NULL) {
+        ++count;
+        ++begin;
+    }
+    return count;
+}
+
+// The first match in [begin, end) of a mapped file, or NULL.
+const char* find(Grep_run* search, regex_t* regex, const char* data,
+        const char* begin, const char* end)
+{
+    if (!search->regex)
+        return search->literal.find(begin, end);
+
+    regmatch_t match;
+    match.rm_so = begin - data;
+    match.rm_eo = end - data;
+    if (regexec(regex, data, 1, &match, REG_STARTEND) != 0)
+        return NULL;
+    return data + match.rm_so;
+}
+
+// Appends the lines of a file's text that match to out. Returns false if
+// it looks binary.
+bool grep_text(Grep_run* search, regex_t* regex, const std::string& path,
+        const char* data, size_t size, size_t* matches, std::string* out)
+{
+    const char* end = data + size;
+    if (memchr(data, '\0', std::min(size, BINARY_PROBE)) != NULL)
+        return false;
+
+    // Every search starts at the beginning of a line, and only one match
+    // is reported per line.
+    std::ostringstream lines;
+    size_t line = 1;
+    const char* counted = data;
+    const char* from = data;
+    while (from < end) {
+        const char* hit = find(search, regex, data, from, end);
+        if (hit == NULL)
+            break;
+
+        const char* start = hit;
+        while (start > from && start[-1] != '\n')
+            --start;
+        const char* stop = (const char*)memchr(hit, '\n', end - hit);
+        if (stop == NULL)
+            stop = end;
+
+        line += count_lines(counted, start);
+        counted = start;
+
+        size_t length = std::min<size_t>(stop - start, MAX_LINE);
+        lines << path << ':' << line << ':';
+        lines.write(start, length);
+        lines << '\n';
+        ++*matches;
+
+        from = stop + 1;
+    }
+
+    out->append(lines.str());
+    return true;
+}
+
+// Appends the matching lines of a file to out. Small files are read into
+// scratch, since unmapping a file makes every core drop its cached page
+// mappings; big ones are mapped. Returns false if the file could not be
+// read or looks binary.
+bool grep_file(Grep_run* search, regex_t* regex, const std::string& path,
+        std::string* scratch, size_t* matches, std::string* out)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = st.st_size;
+    if (size < MAP_SIZE) {
+        scratch->resize(size);
+        size_t done = 0;
+        while (done < size) {
+            ssize_t got = read(fd, &(*scratch)[done], size - done);
+            if (got <= 0)
+                break;
+            done += got;
+        }
+        close(fd);
+        return done == size && (size == 0
+                || grep_text(search, regex, path, scratch->data(), size,
+                    matches, out));
+    }
+
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        return false;
+
+    bool text = grep_text(search, regex, path, (const char*)mapping, size,
+            matches, out);
+    munmap(mapping, size);
+    return text;
+}
+
+class Grep_found : public Event {
+public:
+    Grep_found(Grepper* grepper, const Ref<Grep_run>& search,
+            const std::string& lines)
+        : grepper(grepper), search(search), lines(lines) { }
+
+    void run() { grepper->found(search.get(), lines); }
+
+private:
+    Grepper* grepper;
+    Ref<Grep_run> search;
+    std::string lines;
+};
+
+class Grep_done : public Event {
+public:
+    Grep_done(Grepper* grepper, const Ref<Grep_run>& search)
+        : grepper(grepper), search(search) { }
+
+    void run() { grepper->finished(search.get()); }
+
+private:
+    Grepper* grepper;
+    Ref<Grep_run> search;
+};
+
+// Every job is counted in pending from when it is queued until it is
+// gone, so the last one to go knows the search is over.
+class Grep_job : public Job {
+public:
+    Grep_job(Grepper* grepper, Thread_pool* pool, Event_queue* events,
+            const Ref<Grep_run>& search)
+        : grepper(grepper), pool(pool), events(events), search(search) { }
+
+    ~Grep_job()
+    {
+        if (__sync_sub_and_fetch(&search->pending, 1) == 0)
+            events->post(new Grep_done(grepper, search));
+    }
+
+    static void queue(Thread_pool* pool, Grep_job* job)
+    {
+        __sync_add_and_fetch(&job->search->pending, 1);
+        pool->submit(job);
+    }
+
+protected:
+    Grepper* grepper;
+    Thread_pool* pool;
+    Event_queue* events;
+    Ref<Grep_run> search;
+};
+
+class File_job : public Grep_job {
+public:
+    File_job(Grepper* grepper, Thread_pool* pool, Event_queue* events,
+            const Ref<Grep_run>& search, const Path_list& paths)
+        : Grep_job(grepper, pool, events, search), paths(paths) { }
+
+    void run()
+    {
+        regex_t regex;
+        if (search->regex
+                && regcomp(&regex, search->pattern.c_str(), REGEX_FLAGS))
+            return;
+
+        std::string scratch;
+        for (Path_list::const_iterator it = paths.begin(), end = paths.end();
+                it != end && !cancelled(search.get());
+                ++it)
+        {
+            size_t matches = 0;
+            std::string lines;
+            if (!grep_file(search.get(), &regex, *it, &scratch, &matches,
+                        &lines))
+                continue;
+
+            __sync_add_and_fetch(&search->files, 1);
+            if (matches) {
+                __sync_add_and_fetch(&search->matches, matches);
+                events->post(new Grep_found(grepper, search, lines));
+            }
+        }
+
+        if (search->regex)
+            regfree(&regex);
+    }
+
+private:
+    Path_list paths;
+};
+
+class Directory_job : public Grep_job {
+public:
+    Directory_job(Grepper* grepper, Thread_pool* pool, Event_queue* events,
+            const Ref<Grep_run>& search, const std::string& path)
+        : Grep_job(grepper, pool, events, search), path(path) { }
+
+    void run()
+    {
+        if (cancelled(search.get()))
+            return;
+
+        DIR* dir = opendir(path.c_str());
+        if (dir == NULL)
+            return;
+
+        Path_list files;
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL && !cancelled(search.get())) {
+            if (entry->d_name[0] == '.')
+                continue;
+
+            std::string child = join(entry->d_name);
+            unsigned char type = entry->d_type;
+            if (type == DT_UNKNOWN) {
+                struct stat st;
+                if (lstat(child.c_str(), &st) < 0)
+                    continue;
+                type = S_ISDIR(st.st_mode) ? DT_DIR
+                    : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+            }
+
+            if (type == DT_DIR) {
+                queue(pool, new Directory_job(grepper, pool, events, search,
+                            child));
+            } else if (type == DT_REG) {
+                files.push_back(child);
+                if (files.size() == FILES_PER_JOB) {
+                    queue(pool, new File_job(grepper, pool, events, search,
+                                files));
+                    files.clear();
+                }
+            }
+        }
+        closedir(dir);
+
+        if (!files.empty())
+            queue(pool, new File_job(grepper, pool, events, search, files));
+    }
+
+private:
+    // Paths under "." are given without it.
+    std::string join(const char* name) const
+    {
+        if (path == ".")
+            return name;
+        if (!path.empty() && path[path.size() - 1] == '/')
+            return path + name;
+        return path + "/" + name;
+    }
+
+    std::string path;
+};
+
+// The path of a result line and its line number, from 1. The path is
+// whatever comes before the first ":<digits>:".
+bool parse_result(const std::string& text, std::string* path, size_t* line)
+{
+    for (size_t colon = text.find(':'); colon != std::string::npos;
+            colon = text.find(':', colon + 1))
+    {
+        size_t digits = colon + 1;
+        while (digits < text.size() && text[digits] >= '0'
+                && text[digits] <= '9')
+            ++digits;
+
+        if (digits > colon + 1 && digits < text.size()
+                && text[digits] == ':')
+        {
+            *path = text.substr(0, colon);
+            *line = strtoul(text.c_str() + colon + 1, NULL, 10);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool same_file(const std::string& a, const std::string& b)
+{
+    char real_a[PATH_MAX], real_b[PATH_MAX];
+    return realpath(a.c_str(), real_a) != NULL
+        && realpath(b.c_str(), real_b) != NULL
+        && strcmp(real_a, real_b) == 0;
+}
+
+} // namespace
+
+Grep_run::Grep_run(const std::string& pattern, bool regex)
+    : refs(0), pattern(pattern), regex(regex), literal(pattern),
+      cancelled(0), pending(0), files(0), matches(0)
+{
+}
+
+Grepper::Grepper(Thread_pool* pool, Event_queue* events, Curses* curses)
+    : pool(pool), events(events), curses(curses), searching(false),
+      other(NULL), other_cursor(0)
+{
+}
+
+Grepper::~Grepper()
+{
+    cancel();
+}
+
+bool Grepper::start(const std::string& pattern, const std::string& root,
+        bool regex, std::string* error)
+{
+    cancel();
+    if (pattern.empty()) {
+        *error = "Empty pattern";
+        return false;
+    }
+
+    if (regex) {
+        regex_t compiled;
+        int failed = regcomp(&compiled, pattern.c_str(), REGEX_FLAGS);
+        if (failed) {
+            char message[256];
+            regerror(failed, &compiled, message, sizeof(message));
+            *error = message;
+            return false;
+        }
+        regfree(&compiled);
+    }
+
+    struct stat st;
+    if (stat(root.c_str(), &st) < 0 || !S_ISDIR(st.st_mode)) {
+        *error = root + " is not a directory";
+        return false;
+    }
+
+    results.remove(0, results.size());
+    this->root = root;
+    run = new Grep_run(pattern, regex);
+    searching = true;
+
+    curses->status() << CLEAR << "Searching " << root << " for " << pattern
+        << " ...";
+    Grep_job::queue(pool, new Directory_job(this, pool, events, run, root));
+    return true;
+}
+
+void Grepper::cancel()
+{
+    if (!run.empty())
+        __sync_lock_test_and_set(&run->cancelled, 1);
+    searching = false;
+}
+
+void Grepper::toggle(Buffer_view* view)
+{
+    if (view->buffer != &results) {
+        other = view->buffer;
+        other_cursor = view->cursor;
+        view->show(&results);
+    } else if (other != NULL) {
+        view->show(other);
+        view->set_offset(other_cursor);
+    }
+}
+
+bool Grepper::open(Buffer_view* view)
+{
+    if (view->buffer != &results || other == NULL)
+        return false;
+
+    std::string path;
+    size_t line;
+    const std::string& text = results.text(
+            results.line_start(view->line()),
+            results.line_end(view->line()) - results.line_start(view->line()));
+    if (!parse_result(text, &path, &line) || !same_file(path, other->path))
+        return false;
+
+    toggle(view);
+    view->set_line(line ? line - 1 : 0);
+    return true;
+}
+
+void Grepper::found(Grep_run* done, const std::string& lines)
+{
+    if (done != run.get() || !searching)
+        return;
+
+    results.insert(results.size(), lines);
+    report();
+}
+
+void Grepper::finished(Grep_run* done)
+{
+    if (done != run.get())
+        return;
+
+    searching = false;
+    report();
+}
+
+// The counts so far, in the status bar.
+void Grepper::report()
+{
+    Curses_pos& status = curses->status();
+    status << CLEAR << run->matches << " matches in " << run->files
+        << " files";
+    if (searching)
+        status << " ...";
+}
@@ -0,0 +1,88 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/scripting.hpp>
+#include <rotide/structure.hpp>
+#include <rotide/view.hpp>
+#include <rotide/js/blocks.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+using namespace v8;
+
+// Extends the ro object with bracket matching and folding.
+//
+// ro =
+//      match_bracket   : function ()
+//      fold            : function ()
+//      unfold          : function ()
+//      unfold_all      : function ()
+//
+namespace {
+
+Accessors accessors[] = {
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Blocks, match_bracket),
+    FUNCTION_MAP(Blocks, fold),
+    FUNCTION_MAP(Blocks, unfold),
+    FUNCTION_MAP(Blocks, unfold_all),
+    { NULL, NULL, NULL }
+};
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Blocks::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.match_bracket()
+// Moves the cursor to the bracket matching the one under it, or the
+// first one after it on the line. Returns false if there is none.
+FUNCTION_DEFINE(Blocks, match_bracket)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    return Boolean::New(self->structure->jump());
+}
+
+// JavaScript method: ro.fold()
+// Folds the block the cursor's line opens: the lines inside the bracket
+// it leaves open, or those indented further than it.
+FUNCTION_DEFINE(Blocks, fold)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    return Boolean::New(self->structure->fold());
+}
+
+// JavaScript method: ro.unfold()
+// Opens the fold under the cursor's line.
+FUNCTION_DEFINE(Blocks, unfold)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    return Boolean::New(self->view->unfold(self->view->line()));
+}
+
+// JavaScript method: ro.unfold_all()
+// Opens every fold.
+FUNCTION_DEFINE(Blocks, unfold_all)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    self->view->unfold_all();
+    return Undefined();
+}
@@ -0,0 +1,105 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/completion.hpp>
+#include <rotide/scripting.hpp>
+#include <rotide/js/completion.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+
+using namespace v8;
+
+// Extends the ro object with word completion.
+//
+// ro =
+//      complete        : function (String, [Int32])
+//      complete_word   : function (Int32)
+//
+namespace {
+
+// How many completions ro.complete gives without a limit.
+const int32_t DEFAULT_LIMIT = 10;
+
+Accessors accessors[] = {
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Completion, complete),
+    FUNCTION_MAP(Completion, complete_word),
+    { NULL, NULL, NULL }
+};
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Completion::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.complete(String, [Int32])
+// Returns the words in the buffer that start with the prefix, the most
+// frequent first, at most as many as the limit.
+//
+// EXAMPLE:
+//  ro.complete("buf", 5);     // ["buffer", "buffers", "buf_size"]
+FUNCTION_DEFINE(Completion, complete)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string prefix;
+    int32_t limit = DEFAULT_LIMIT;
+    if (!smart_convert(args[0], &prefix)
+            || (args.Length() > 1 && !smart_convert(args[1], &limit)))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.complete(String, [Int32])."));
+    }
+
+    Word_list words;
+    if (limit > 0)
+        self->words->complete(prefix, limit, &words);
+
+    Local<Array> list = Array::New(words.size());
+    for (uint32_t i = 0; i < words.size(); ++i)
+        list->Set(i, String::New(words[i].data(), words[i].size()));
+    return list;
+}
+
+// JavaScript method: ro.complete_word(Int32)
+// Completes the word in front of the cursor, or, called again, moves
+// that many completions on. Returns false if nothing starts with it.
+//
+// EXAMPLE:
+//  ro.complete_word(1);       // the next completion
+//  ro.complete_word(-1);      // the one before
+FUNCTION_DEFINE(Completion, complete_word)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int32_t step;
+    if (!smart_convert(args[0], &step)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.complete_word(Int32)."));
+    }
+
+    return Boolean::New(self->words->complete(self->view, step));
+}
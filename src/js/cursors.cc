@@ -0,0 +1,129 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/cursors.hpp>
+#include <rotide/scripting.hpp>
+#include <rotide/searcher.hpp>
+#include <rotide/js/cursors.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+
+#include <rotide/curses.hpp>
+
+using namespace v8;
+
+// Extends the ro object with multiple cursors.
+//
+// ro =
+//      cursor_count    : Number
+//
+//      select_matches  : function (String, [Boolean])
+//      add_cursors     : function (Int32)
+//      clear_cursors   : function ()
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_GETTER_MAP(Cursors, cursor_count),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Cursors, select_matches),
+    FUNCTION_MAP(Cursors, add_cursors),
+    FUNCTION_MAP(Cursors, clear_cursors),
+    { NULL, NULL, NULL }
+};
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Cursors::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.select_matches(String, [Boolean])
+// Puts a cursor at the end of every match of the pattern, with the match
+// selected, so what is typed next replaces all of them. The pattern is a
+// regular expression if the second argument is true. Returns how many
+// there are, or -1, saying why in the status bar, if the pattern is no
+// good.
+//
+// EXAMPLE:
+//  ro.select_matches("colour");
+FUNCTION_DEFINE(Cursors, select_matches)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string pattern, error;
+    bool regex = false;
+    if (!smart_convert(args[0], &pattern)
+            || (args.Length() > 1 && !smart_convert(args[1], &regex)))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.select_matches(String, [Boolean])."));
+    }
+
+    Match_list matches;
+    if (!self->searcher->collect(pattern, regex, &matches, &error)) {
+        self->curses->status() << CLEAR << error;
+        return Number::New(-1);
+    }
+
+    if (!self->cursors->select(matches))
+        return Number::New(0);
+    return Number::New(self->cursors->count());
+}
+
+// JavaScript method: ro.add_cursors(Int32)
+// Adds a cursor at the cursor's column on each of the next lines, or on
+// the ones above for a negative count.
+//
+// EXAMPLE:
+//  ro.add_cursors(9);      // a column of ten cursors
+FUNCTION_DEFINE(Cursors, add_cursors)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int32_t lines;
+    if (!smart_convert(args[0], &lines)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.add_cursors(Int32)."));
+    }
+
+    return Boolean::New(self->cursors->add_column(lines));
+}
+
+// JavaScript method: ro.clear_cursors()
+// Goes back to the one cursor.
+FUNCTION_DEFINE(Cursors, clear_cursors)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    self->cursors->clear();
+    return Undefined();
+}
+
+// JavaScript getter: ro.cursor_count : Number
+ACCESSOR_GETTER_DEFINE(Cursors, cursor_count)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Number::New(self->cursors->count());
+}
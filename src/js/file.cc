@@ -0,0 +1,143 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/scripting.hpp>
+#include <rotide/js/file.hpp>
+#include <rotide/saver.hpp>
+#include <rotide/view.hpp>
+#include <rotide/watcher.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+
+using namespace v8;
+
+// Extends the ro object with saving, reloading and following.
+//
+// ro =
+//      saving          : boolean
+//      modified        : boolean
+//      following       : boolean
+//
+//      save            : function ([String])
+//      reload          : function ()
+//      follow          : function (Boolean)
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_GETTER_MAP(File, saving),
+    ACCESSOR_GETTER_MAP(File, modified),
+    ACCESSOR_GETTER_MAP(File, following),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(File, save),
+    FUNCTION_MAP(File, reload),
+    FUNCTION_MAP(File, follow),
+    { NULL, NULL, NULL }
+};
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair File::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.save([String])
+// Starts writing the buffer to a file, its own if none is given. The
+// save goes on in the background and the status bar tells how it went.
+// Returns false if a save is already under way.
+//
+// EXAMPLE:
+//  ro.save();
+//  ro.save("copy.txt");
+FUNCTION_DEFINE(File, save)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string path;
+    if (args.Length() > 0 && !args[0]->IsUndefined() && !args[0]->IsNull()
+            && !smart_convert(args[0], &path))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.save([String])."));
+    }
+
+    return Boolean::New(self->saver->save(path));
+}
+
+// JavaScript method: ro.reload()
+// Reads the buffer's file again in the background, replacing unsaved
+// edits too. Only what differs from the buffer is edited in, as one
+// undo step.
+//
+// EXAMPLE:
+//  ro.reload();
+FUNCTION_DEFINE(File, reload)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    self->watcher->reload(true);
+    return Undefined();
+}
+
+// JavaScript method: ro.follow(Boolean)
+// Starts or stops following the buffer's file as it grows, like tail -f.
+// Returns false if the buffer has no file to follow.
+//
+// EXAMPLE:
+//  ro.follow(!ro.following);
+FUNCTION_DEFINE(File, follow)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    bool on;
+    if (args.Length() != 1 || !smart_convert(args[0], &on)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.follow(Boolean)."));
+    }
+
+    return Boolean::New(self->watcher->follow(on));
+}
+
+// JavaScript getter: ro.saving : boolean
+// True while a save is being written.
+ACCESSOR_GETTER_DEFINE(File, saving)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Boolean::New(self->saver->busy());
+}
+
+// JavaScript getter: ro.modified : boolean
+// True if the buffer differs from what was last saved.
+ACCESSOR_GETTER_DEFINE(File, modified)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Boolean::New(self->view->buffer->modified);
+}
+
+// JavaScript getter: ro.following : boolean
+// True while the buffer follows its file as it grows.
+ACCESSOR_GETTER_DEFINE(File, following)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Boolean::New(self->watcher->following());
+}
@@ -0,0 +1,137 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/scripting.hpp>
+#include <rotide/file_index.hpp>
+#include <rotide/js/finder.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+
+using namespace v8;
+
+// Extends the ro object with finding files by name.
+//
+// ro =
+//      indexing        : boolean
+//      indexed         : number
+//
+//      find_files      : function (String, [Int32])
+//      pick_files      : function (String)
+//      pick_open       : function ()
+//
+namespace {
+
+// How many paths find_files gives back unless told otherwise.
+const int32_t FIND_LIMIT = 20;
+
+Accessors accessors[] = {
+    ACCESSOR_GETTER_MAP(Finder, indexing),
+    ACCESSOR_GETTER_MAP(Finder, indexed),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Finder, find_files),
+    FUNCTION_MAP(Finder, pick_files),
+    FUNCTION_MAP(Finder, pick_open),
+    { NULL, NULL, NULL }
+};
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Finder::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.find_files(String, [Int32])
+// The paths under the directory the editor started in that best match a
+// few of their characters, best first, 20 of them unless told otherwise.
+//
+// EXAMPLE:
+//  ro.find_files("bufcc");     // ["src/buffer.cc", ...]
+FUNCTION_DEFINE(Finder, find_files)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string query;
+    int32_t limit = FIND_LIMIT;
+    if (!smart_convert(args[0], &query)
+            || (args.Length() > 1 && (!smart_convert(args[1], &limit)
+                    || limit < 0)))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.find_files(String, [Int32])."));
+    }
+
+    File_match_list matches;
+    self->files->find(query, limit, &matches);
+
+    Local<Array> paths = Array::New(matches.size());
+    for (uint32_t i = 0; i < matches.size(); ++i) {
+        paths->Set(i, String::New(matches[i].path.data(),
+                    matches[i].path.size()));
+    }
+    return paths;
+}
+
+// JavaScript method: ro.pick_files(String)
+// Shows the best matches for a query, one path to a line. Returns how
+// many there are.
+//
+// EXAMPLE:
+//  ro.pick_files("view");
+FUNCTION_DEFINE(Finder, pick_files)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string query;
+    if (!smart_convert(args[0], &query)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.pick_files(String)."));
+    }
+
+    return Number::New(self->files->pick(self->view, query));
+}
+
+// JavaScript method: ro.pick_open()
+// Goes back to the file being edited if it is the path on the cursor's
+// line of the picks. Returns false otherwise.
+FUNCTION_DEFINE(Finder, pick_open)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    return Boolean::New(self->files->open(self->view));
+}
+
+// JavaScript getter: ro.indexing : boolean
+// True while the files are still being listed.
+ACCESSOR_GETTER_DEFINE(Finder, indexing)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Boolean::New(self->files->busy());
+}
+
+// JavaScript getter: ro.indexed : number
+// How many files the index knows of.
+ACCESSOR_GETTER_DEFINE(Finder, indexed)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Number::New(self->files->size());
+}
@@ -0,0 +1,117 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/scripting.hpp>
+#include <rotide/grepper.hpp>
+#include <rotide/js/grep.hpp>
+#include <rotide/view.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+
+#include <rotide/curses.hpp>
+
+using namespace v8;
+
+// Extends the ro object with searching the files under a directory.
+//
+// ro =
+//      grepping        : boolean
+//
+//      grep            : function (String, [String], [Boolean])
+//      grep_results    : function ()
+//      grep_open       : function ()
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_GETTER_MAP(Grep, grepping),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Grep, grep),
+    FUNCTION_MAP(Grep, grep_results),
+    FUNCTION_MAP(Grep, grep_open),
+    { NULL, NULL, NULL }
+};
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Grep::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.grep(String, [String], [Boolean])
+// Searches every file under a directory, the current one if none is
+// given, and shows the matching lines as they are found. The pattern is
+// a regular expression if the third argument is true. Returns false, and
+// says why in the status bar, if the search could not start.
+//
+// EXAMPLE:
+//  ro.grep("TODO", "src");
+FUNCTION_DEFINE(Grep, grep)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string pattern, root = ".", error;
+    bool regex = false;
+    if (!smart_convert(args[0], &pattern)
+            || (args.Length() > 1 && !smart_convert(args[1], &root))
+            || (args.Length() > 2 && !smart_convert(args[2], &regex)))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.grep(String, [String], [Boolean])."));
+    }
+
+    if (!self->grepper->start(pattern, root, regex, &error)) {
+        self->curses->status() << CLEAR << error;
+        return Boolean::New(false);
+    }
+
+    if (self->view->buffer != &self->grepper->results)
+        self->grepper->toggle(self->view);
+    return Boolean::New(true);
+}
+
+// JavaScript method: ro.grep_results()
+// Switches between the results of the last grep and the file.
+FUNCTION_DEFINE(Grep, grep_results)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    self->grepper->toggle(self->view);
+    return Boolean::New(true);
+}
+
+// JavaScript method: ro.grep_open()
+// Goes to the match on the cursor's line of the results, if it is in
+// the file being edited. Returns false otherwise.
+FUNCTION_DEFINE(Grep, grep_open)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    return Boolean::New(self->grepper->open(self->view));
+}
+
+// JavaScript getter: ro.grepping : boolean
+// True while a grep is still searching.
+ACCESSOR_GETTER_DEFINE(Grep, grepping)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Boolean::New(self->grepper->busy());
+}
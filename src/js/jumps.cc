@@ -0,0 +1,130 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/marks.hpp>
+#include <rotide/scripting.hpp>
+#include <rotide/js/jumps.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+
+using namespace v8;
+
+// Extends the ro object with marks and the jump list.
+//
+// ro =
+//      mark            : function ([String])
+//      go_mark         : function ([String])
+//      jump_back       : function ()
+//      jump_forward    : function ()
+//
+namespace {
+
+Accessors accessors[] = {
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Jumps, mark),
+    FUNCTION_MAP(Jumps, go_mark),
+    FUNCTION_MAP(Jumps, jump_back),
+    FUNCTION_MAP(Jumps, jump_forward),
+    { NULL, NULL, NULL }
+};
+
+// A mark is named by the first character of a string. Leaving it out
+// makes the next key name it, which is reported as 0.
+bool convert_name(const Handle<Value>& value, int* name)
+{
+    std::string text;
+    if (value->IsUndefined() || value->IsNull()) {
+        *name = 0;
+        return true;
+    }
+
+    if (!smart_convert(value, &text) || text.empty())
+        return false;
+
+    *name = (unsigned char)text[0];
+    return true;
+}
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Jumps::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.mark([String])
+// Marks the cursor's place under a name. Without one the next key pressed
+// names it.
+//
+// EXAMPLE:
+//  ro.mark("a");
+FUNCTION_DEFINE(Jumps, mark)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int name;
+    if (!convert_name(args[0], &name)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.mark([String])."));
+    }
+
+    return Boolean::New(self->mark(name));
+}
+
+// JavaScript method: ro.go_mark([String])
+// Moves the cursor to a mark, wherever edits have taken its text since.
+// Without a name the next key pressed names it. Returns false if there
+// is no such mark.
+//
+// EXAMPLE:
+//  ro.go_mark("a");
+FUNCTION_DEFINE(Jumps, go_mark)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int name;
+    if (!convert_name(args[0], &name)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.go_mark([String])."));
+    }
+
+    return Boolean::New(self->go_mark(name));
+}
+
+// JavaScript method: ro.jump_back()
+// Moves the cursor to where it was before the last jump. Returns false
+// at the oldest one.
+FUNCTION_DEFINE(Jumps, jump_back)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    return Boolean::New(self->marks->back());
+}
+
+// JavaScript method: ro.jump_forward()
+// Undoes a jump_back().
+FUNCTION_DEFINE(Jumps, jump_forward)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    return Boolean::New(self->marks->forward());
+}
@@ -0,0 +1,131 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/scripting.hpp>
+#include <rotide/js/macro.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+
+using namespace v8;
+
+// Extends the ro object with macros.
+//
+// ro =
+//      recording       : boolean
+//
+//      record          : function ([String])
+//      stop_recording  : function ()
+//      replay          : function ([String], [Int32])
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_GETTER_MAP(Macro, recording),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Macro, record),
+    FUNCTION_MAP(Macro, stop_recording),
+    FUNCTION_MAP(Macro, replay),
+    { NULL, NULL, NULL }
+};
+
+// A register is named by the first character of a string. Leaving it out
+// makes the next key name it, which is reported as 0.
+bool convert_register(const Handle<Value>& value, int* reg)
+{
+    std::string name;
+    if (value->IsUndefined() || value->IsNull()) {
+        *reg = 0;
+        return true;
+    }
+
+    if (!smart_convert(value, &name) || name.empty())
+        return false;
+
+    *reg = (unsigned char)name[0];
+    return true;
+}
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Macro::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.record([String])
+// Starts recording keys into a register. Without a register the next
+// key pressed names it. Returns false if a recording is already going.
+//
+// EXAMPLE:
+//  ro.record("a");
+FUNCTION_DEFINE(Macro, record)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int reg;
+    if (!convert_register(args[0], &reg)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.record([String])."));
+    }
+
+    return Boolean::New(self->record(reg));
+}
+
+// JavaScript method: ro.stop_recording()
+// Stops recording; the register keeps what was recorded so far.
+FUNCTION_DEFINE(Macro, stop_recording)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    self->stop_recording();
+    return Undefined();
+}
+
+// JavaScript method: ro.replay([String], [Int32])
+// Replays a register count times once the current key has been handled.
+// Without a register the next key pressed names it.
+//
+// EXAMPLE:
+//  ro.replay("a", 10000);
+FUNCTION_DEFINE(Macro, replay)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int reg;
+    int32_t count = 1;
+    if (!convert_register(args[0], &reg)
+            || (args.Length() > 1 && !smart_convert(args[1], &count)))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.replay([String], [Int32])."));
+    }
+
+    return Boolean::New(self->replay(reg, count));
+}
+
+// JavaScript getter: ro.recording : boolean
+// True while keys are being recorded into a register.
+ACCESSOR_GETTER_DEFINE(Macro, recording)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Boolean::New(self->recording());
+}
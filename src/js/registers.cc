@@ -0,0 +1,249 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/registers.hpp>
+#include <rotide/scripting.hpp>
+#include <rotide/js/registers.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+
+using namespace v8;
+
+// Extends the ro object with registers for yanked text.
+//
+// ro =
+//      copy_command    : String
+//      paste_command   : String
+//
+//      yank            : function (String, Number, Number)
+//      yank_lines      : function ([String], [Int32])
+//      put             : function ([String], [Int32])
+//      register_size   : function ([String])
+//      copy_register   : function ([String])
+//      paste_clipboard : function ()
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_MAP(Registers, copy_command),
+    ACCESSOR_MAP(Registers, paste_command),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Registers, yank),
+    FUNCTION_MAP(Registers, yank_lines),
+    FUNCTION_MAP(Registers, put),
+    FUNCTION_MAP(Registers, register_size),
+    FUNCTION_MAP(Registers, copy_register),
+    FUNCTION_MAP(Registers, paste_clipboard),
+    { NULL, NULL, NULL }
+};
+
+// A register is named by the first character of a string. Leaving it out
+// means the unnamed one.
+bool convert_register(const Handle<Value>& value, int* reg)
+{
+    std::string name;
+    if (value->IsUndefined() || value->IsNull()) {
+        *reg = UNNAMED_REGISTER;
+        return true;
+    }
+
+    if (!smart_convert(value, &name) || name.empty())
+        return false;
+
+    *reg = (unsigned char)name[0];
+    return true;
+}
+
+// Counts left out are 1.
+bool convert_count(const Handle<Value>& value, int32_t* count)
+{
+    if (value->IsUndefined() || value->IsNull()) {
+        *count = 1;
+        return true;
+    }
+    return smart_convert(value, count) && *count > 0;
+}
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Registers::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.yank(String, Number, Number)
+// Yanks size bytes at offset into a register, without copying them.
+//
+// EXAMPLE:
+//  ro.yank("a", ro.offset, 100);
+FUNCTION_DEFINE(Registers, yank)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int reg;
+    double offset, size;
+    if (!convert_register(args[0], &reg)
+            || !smart_convert(args[1], &offset) || offset < 0
+            || !smart_convert(args[2], &size) || size < 0)
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.yank(String, Number, Number)."));
+    }
+
+    self->yanks->yank(reg, (size_t)offset, (size_t)size);
+    return Undefined();
+}
+
+// JavaScript method: ro.yank_lines([String], [Int32])
+// Yanks count lines from the cursor's down. Returns how many bytes that
+// came to.
+//
+// EXAMPLE:
+//  ro.yank_lines("a", 1000000);
+FUNCTION_DEFINE(Registers, yank_lines)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int reg;
+    int32_t count;
+    if (!convert_register(args[0], &reg) || !convert_count(args[1], &count))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.yank_lines([String], [Int32])."));
+    }
+
+    self->yanks->yank_lines(reg, count);
+    return Number::New(self->yanks->size(reg));
+}
+
+// JavaScript method: ro.put([String], [Int32])
+// Puts a register in count times: lines under the cursor's line and
+// anything else at the cursor. Returns false if the register is empty.
+//
+// EXAMPLE:
+//  ro.put("a", 3);
+FUNCTION_DEFINE(Registers, put)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int reg;
+    int32_t count;
+    if (!convert_register(args[0], &reg) || !convert_count(args[1], &count))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.put([String], [Int32])."));
+    }
+
+    return Boolean::New(self->yanks->put(reg, count));
+}
+
+// JavaScript method: ro.register_size([String])
+// Returns how many bytes a register holds.
+FUNCTION_DEFINE(Registers, register_size)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int reg;
+    if (!convert_register(args[0], &reg)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.register_size([String])."));
+    }
+
+    return Number::New(self->yanks->size(reg));
+}
+
+// JavaScript method: ro.copy_register([String])
+// Hands a register to ro.copy_command in the background. Returns false
+// if it is empty or the clipboard is busy.
+FUNCTION_DEFINE(Registers, copy_register)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int reg;
+    if (!convert_register(args[0], &reg)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.copy_register([String])."));
+    }
+
+    return Boolean::New(self->yanks->copy(reg));
+}
+
+// JavaScript method: ro.paste_clipboard()
+// Reads what ro.paste_command prints into the + register, and the
+// unnamed one, in the background. Returns false if the clipboard is
+// busy.
+FUNCTION_DEFINE(Registers, paste_clipboard)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    return Boolean::New(self->yanks->paste());
+}
+
+// JavaScript getter: ro.copy_command : String
+ACCESSOR_GETTER_DEFINE(Registers, copy_command)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    const std::string& command = self->yanks->copy_command;
+    return String::New(command.data(), command.size());
+}
+
+// JavaScript setter: ro.copy_command : String
+// The shell command that takes the clipboard on its standard input.
+//
+// EXAMPLE:
+//  ro.copy_command = "wl-copy";
+ACCESSOR_SETTER_DEFINE(Registers, copy_command)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    if (!smart_convert(value, &self->yanks->copy_command)) {
+        Exception::Error(
+                String::New(
+                    "copy_command is a string"));
+    }
+}
+
+// JavaScript getter: ro.paste_command : String
+ACCESSOR_GETTER_DEFINE(Registers, paste_command)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    const std::string& command = self->yanks->paste_command;
+    return String::New(command.data(), command.size());
+}
+
+// JavaScript setter: ro.paste_command : String
+// The shell command that prints the clipboard.
+//
+// EXAMPLE:
+//  ro.paste_command = "wl-paste -n";
+ACCESSOR_SETTER_DEFINE(Registers, paste_command)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    if (!smart_convert(value, &self->yanks->paste_command)) {
+        Exception::Error(
+                String::New(
+                    "paste_command is a string"));
+    }
+}
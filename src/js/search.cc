@@ -0,0 +1,260 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/scripting.hpp>
+#include <rotide/js/search.hpp>
+#include <rotide/search.hpp>
+#include <rotide/searcher.hpp>
+#include <rotide/view.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <algorithm>
+#include <string>
+
+#include <rotide/curses.hpp>
+
+using namespace v8;
+
+// Extends the ro object with search.
+//
+// ro =
+//      search_count    : Number
+//      search_done     : boolean
+//
+//      search          : function (String, [Number])
+//      search_backward : function (String, [Number])
+//      search_start    : function (String, [Boolean])
+//      search_next     : function ([Boolean])
+//      search_prompt   : function ()
+//      replace         : function (String, String, [Boolean])
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_GETTER_MAP(Search, search_count),
+    ACCESSOR_GETTER_MAP(Search, search_done),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Search, search),
+    FUNCTION_MAP(Search, search_backward),
+    FUNCTION_MAP(Search, search_start),
+    FUNCTION_MAP(Search, search_next),
+    FUNCTION_MAP(Search, search_prompt),
+    FUNCTION_MAP(Search, replace),
+    { NULL, NULL, NULL }
+};
+
+// A search takes a pattern and where to start, which is the cursor if it
+// is left out.
+bool convert_search(const Arguments& args, Scripting_engine* self,
+        std::string* pattern, size_t* from)
+{
+    double offset = self->view->cursor;
+    if (!smart_convert(args[0], pattern)
+            || (args.Length() > 1 && !smart_convert(args[1], &offset))
+            || offset < 0)
+        return false;
+
+    *from = (size_t)offset;
+    return true;
+}
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Search::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.search(String, [Number])
+// The offset of the first match at or after from, going on from the top
+// of the buffer if there is none below. Returns -1 if the pattern is not
+// in the buffer at all.
+//
+// EXAMPLE:
+//  ro.offset = ro.search("needle", ro.offset + 1);
+FUNCTION_DEFINE(Search, search)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string pattern;
+    size_t from;
+    if (!convert_search(args, self, &pattern, &from)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.search(String, [Number])."));
+    }
+
+    const Buffer_snapshot& snapshot = self->view->buffer->snapshot();
+    Literal_search search(pattern);
+    size_t at;
+    if (search.forward(snapshot, from, snapshot.size(), &at)
+            || search.forward(snapshot, 0, from, &at))
+        return Number::New(at);
+    return Number::New(-1);
+}
+
+// JavaScript method: ro.search_backward(String, [Number])
+// The offset of the last match before from, going on from the bottom of
+// the buffer if there is none above. Returns -1 if there is no match.
+FUNCTION_DEFINE(Search, search_backward)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string pattern;
+    size_t from;
+    if (!convert_search(args, self, &pattern, &from)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.search_backward(String, [Number])."));
+    }
+
+    const Buffer_snapshot& snapshot = self->view->buffer->snapshot();
+    Literal_search search(pattern);
+    size_t at;
+    if (search.backward(snapshot, 0, from, &at)
+            || search.backward(snapshot, from, snapshot.size(), &at))
+        return Number::New(at);
+    return Number::New(-1);
+}
+
+// JavaScript method: ro.search_start(String, [Boolean])
+// Finds every match in the buffer in the background and moves to the
+// first one after the cursor as soon as it is found. The pattern is a
+// regular expression if the second argument is true. Returns false, and
+// says why in the status bar, if the pattern is no good.
+//
+// EXAMPLE:
+//  ro.search_start("fo+", true);
+FUNCTION_DEFINE(Search, search_start)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string pattern, error;
+    bool regex = false;
+    if (!smart_convert(args[0], &pattern)
+            || (args.Length() > 1 && !smart_convert(args[1], &regex)))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.search_start(String, [Boolean])."));
+    }
+
+    if (!self->searcher->start(pattern, regex, &error)) {
+        self->curses->status() << CLEAR << error;
+        return Boolean::New(false);
+    }
+    return Boolean::New(true);
+}
+
+// JavaScript method: ro.search_next([Boolean])
+// Moves to the next match of the last search, or the previous one if the
+// argument is true, wrapping around the buffer. Returns false if nothing
+// was searched for yet.
+FUNCTION_DEFINE(Search, search_next)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    bool backward = false;
+    if (args.Length() > 0 && !smart_convert(args[0], &backward)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.search_next([Boolean])."));
+    }
+
+    return Boolean::New(self->searcher->next(backward));
+}
+
+// JavaScript method: ro.search_prompt()
+// Opens the search prompt, which searches for the text as it is typed
+// and highlights the matches on the screen.
+FUNCTION_DEFINE(Search, search_prompt)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    self->prompt_search();
+    return Boolean::New(true);
+}
+
+// JavaScript method: ro.replace(String, String, [Boolean])
+// Replaces every match of the pattern in the buffer with the text, all
+// in one edit that undoes in one step. The pattern is a regular
+// expression if the third argument is true; the text is always taken
+// as it is. The cursor stays on the same text. Returns how many matches
+// were replaced, or -1, saying why in the status bar, if the pattern is
+// no good.
+//
+// EXAMPLE:
+//  ro.replace("colour", "color");
+FUNCTION_DEFINE(Search, replace)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string pattern, text, error;
+    bool regex = false;
+    if (!smart_convert(args[0], &pattern)
+            || !smart_convert(args[1], &text)
+            || (args.Length() > 2 && !smart_convert(args[2], &regex)))
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.replace(String, String, [Boolean])."));
+    }
+
+    Match_list matches;
+    if (!self->searcher->collect(pattern, regex, &matches, &error)) {
+        self->curses->status() << CLEAR << error;
+        return Number::New(-1);
+    }
+
+    // The cursor moves by what changed in front of it.
+    Buffer_view* view = self->view;
+    size_t cursor = view->cursor, shifted = cursor, end = 0;
+    for (Match_list::const_iterator it = matches.begin(),
+            stop = matches.end();
+            it != stop && it->offset < cursor;
+            ++it)
+    {
+        if (it->offset < end)
+            continue;
+        end = it->offset + it->length;
+        shifted = shifted - std::min(it->length, cursor - it->offset)
+            + text.size();
+    }
+
+    size_t replaced = view->buffer->replace(matches, text.data(),
+            text.size());
+    view->set_offset(shifted);
+    return Number::New(replaced);
+}
+
+// JavaScript getter: ro.search_count : Number
+// Matches of the last search found so far.
+ACCESSOR_GETTER_DEFINE(Search, search_count)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Number::New(self->searcher->count());
+}
+
+// JavaScript getter: ro.search_done : boolean
+// True once the whole buffer has been searched.
+ACCESSOR_GETTER_DEFINE(Search, search_done)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Boolean::New(self->searcher->complete());
+}
@@ -0,0 +1,193 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/scripting.hpp>
+#include <rotide/syntax.hpp>
+#include <rotide/js/syntax.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <string>
+#include <vector>
+
+#include <rotide/curses.hpp>
+
+using namespace v8;
+
+// Extends the ro object with grammars for coloring files.
+//
+// ro =
+//      syntax          : string
+//
+//      grammar         : function (String, Array, Object)
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_GETTER_MAP(Syntax, syntax),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Syntax, grammar),
+    { NULL, NULL, NULL }
+};
+
+// Adds the rules of one state: [pattern, style, [next state]] each.
+bool add_rules(Grammar* grammar, int state, const Handle<Array>& rules,
+        std::string* error)
+{
+    for (uint32_t i = 0; i < rules->Length(); ++i) {
+        Handle<Value> value = rules->Get(i);
+        if (!value->IsArray()) {
+            *error = "A rule is [pattern, style, [next state]]";
+            return false;
+        }
+
+        Handle<Array> rule = value.As<Array>();
+        std::string pattern, style_name, next_name;
+        if (rule->Length() < 2 || rule->Length() > 3
+                || !smart_convert(rule->Get(0), &pattern)
+                || !smart_convert(rule->Get(1), &style_name)
+                || (rule->Length() > 2
+                    && !smart_convert(rule->Get(2), &next_name)))
+        {
+            *error = "A rule is [pattern, style, [next state]]";
+            return false;
+        }
+
+        int style = syntax_style(style_name);
+        if (style < 0) {
+            *error = style_name + " is not a style";
+            return false;
+        }
+
+        // A state that was not given is made here, and caught after.
+        int next = next_name.empty() ? -1 : grammar->state(next_name);
+
+        if (!grammar->add_rule(state, pattern, style, next, error))
+            return false;
+    }
+    return true;
+}
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Syntax::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.grammar(String, Array, Object)
+// Defines a grammar for the files with the given extensions. Each
+// property of the object is a state: a list of rules, or an object with
+// the style of the text none of its rules match and the rules. A rule is
+// an extended regular expression, the style of what it matches and
+// optionally the state to go to after it. Lexing starts in "start".
+// Returns false, and says why in the status bar, if the grammar is no
+// good.
+//
+// EXAMPLE:
+//  ro.grammar("c", [".c", ".h"], {
+//      start: [["/\\*", "comment", "comment"],
+//              ["\\b(if|else|while)\\b", "keyword"]],
+//      comment: { style: "comment", rules: [["\\*/", "comment", "start"]] }
+//  });
+FUNCTION_DEFINE(Syntax, grammar)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::string name;
+    std::vector<std::string> extensions;
+    if (args.Length() != 3 || !smart_convert(args[0], &name)
+            || !smart_convert(args[1], &extensions) || !args[2]->IsObject())
+    {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.grammar(String, Array, Object)."));
+    }
+
+    Ref<Grammar> grammar(new Grammar(name));
+    grammar->extensions = extensions;
+
+    // Every state is made first so rules can name the ones after them.
+    Handle<Object> states = args[2]->ToObject();
+    Handle<Array> names = states->GetPropertyNames();
+    for (uint32_t i = 0; i < names->Length(); ++i) {
+        std::string state;
+        smart_convert(names->Get(i), &state);
+        grammar->state(state);
+    }
+    size_t defined = grammar->states.size();
+
+    std::string error;
+    for (uint32_t i = 0; i < names->Length() && error.empty(); ++i) {
+        std::string state_name;
+        smart_convert(names->Get(i), &state_name);
+        int state = grammar->state(state_name);
+
+        Handle<Value> value = states->Get(names->Get(i));
+        Handle<Array> rules;
+        if (value->IsArray()) {
+            rules = value.As<Array>();
+        } else if (value->IsObject()) {
+            Handle<Object> object = value->ToObject();
+            std::string style_name;
+            Handle<Value> style = object->Get(String::New("style"));
+            Handle<Value> list = object->Get(String::New("rules"));
+            if (!style->IsUndefined()) {
+                if (!smart_convert(style, &style_name)
+                        || syntax_style(style_name) < 0)
+                {
+                    error = state_name + " has no such style";
+                    break;
+                }
+                grammar->states[state].style = syntax_style(style_name);
+            }
+            if (!list->IsArray()) {
+                error = state_name + " has no rules";
+                break;
+            }
+            rules = list.As<Array>();
+        } else {
+            error = state_name + " is not a state";
+            break;
+        }
+
+        add_rules(grammar.get(), state, rules, &error);
+    }
+
+    if (error.empty() && grammar->states.size() != defined)
+        error = "A rule goes to " + grammar->states.back().name
+            + ", which is not a state";
+
+    if (!error.empty()) {
+        self->curses->status() << CLEAR << name << ": " << error;
+        return Boolean::New(false);
+    }
+
+    self->syntax->add(grammar);
+    return Boolean::New(true);
+}
+
+// JavaScript getter: ro.syntax : string
+// The name of the grammar coloring the buffer, or "".
+ACCESSOR_GETTER_DEFINE(Syntax, syntax)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    const Grammar* grammar = self->syntax->grammar();
+    return String::New(grammar ? grammar->name.c_str() : "");
+}
@@ -0,0 +1,127 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/scripting.hpp>
+#include <rotide/js/undo.hpp>
+#include <rotide/undo.hpp>
+#include <rotide/view.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+using namespace v8;
+
+// Extends the ro object with undo and redo.
+//
+// ro =
+//      undo_budget     : Int32
+//
+//      undo            : function ()
+//      redo            : function ()
+//      undo_branch     : function (Int32)
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_MAP(Undo, undo_budget),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(Undo, undo),
+    FUNCTION_MAP(Undo, redo),
+    FUNCTION_MAP(Undo, undo_branch),
+    { NULL, NULL, NULL }
+};
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair Undo::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.undo()
+// Takes back the last step and puts the cursor where it was made.
+// Returns false when there is nothing left to undo.
+FUNCTION_DEFINE(Undo, undo)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    size_t offset;
+    if (!self->undo->undo(&offset))
+        return Boolean::New(false);
+
+    self->view->set_offset(offset);
+    return Boolean::New(true);
+}
+
+// JavaScript method: ro.redo()
+// Makes the step that was undone last on the chosen branch again.
+// Returns false when there is nothing to redo.
+FUNCTION_DEFINE(Undo, redo)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    size_t offset;
+    if (!self->undo->redo(&offset))
+        return Boolean::New(false);
+
+    self->view->set_offset(offset);
+    return Boolean::New(true);
+}
+
+// JavaScript method: ro.undo_branch(Int32)
+// Changes the branch redo follows by the given number of branches and
+// returns how many there are to choose from.
+//
+// EXAMPLE:
+//  ro.undo_branch(1);
+//  ro.redo();
+FUNCTION_DEFINE(Undo, undo_branch)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int32_t delta;
+    if (!smart_convert(args[0], &delta)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.undo_branch(Int32)."));
+    }
+
+    self->undo->branch(delta);
+    return Int32::New(self->undo->branches());
+}
+
+// JavaScript getter: ro.undo_budget : Int32
+// Bytes the undo history may hold on to before old steps are dropped.
+ACCESSOR_GETTER_DEFINE(Undo, undo_budget)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Int32::New(self->undo->budget());
+}
+
+// JavaScript setter: ro.undo_budget : Int32
+// Changes the budget. Lowering it drops old steps right away.
+ACCESSOR_SETTER_DEFINE(Undo, undo_budget)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    int32_t budget;
+    if (!smart_convert(value, &budget) || budget <= 0) {
+        Exception::Error(
+                String::New(
+                    "undo_budget is a positive Int32"));
+        return;
+    }
+    self->undo->set_budget(budget);
+}
@@ -0,0 +1,226 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/cursors.hpp>
+#include <rotide/scripting.hpp>
+#include <rotide/js/view.hpp>
+#include <rotide/view.hpp>
+#include <rotide/v8/type_conversion.hpp>
+
+#include <vector>
+
+using namespace v8;
+
+// Extends the ro object with the buffer view.
+//
+// ro =
+//      line            : Int32
+//      column          : Int32
+//      offset          : Number
+//      hex             : boolean
+//
+//      move_rows       : function (Int32)
+//      move_columns    : function (Int32)
+//      overwrite       : function (Array)
+//
+namespace {
+
+Accessors accessors[] = {
+    ACCESSOR_MAP(View, line),
+    ACCESSOR_MAP(View, column),
+    ACCESSOR_MAP(View, offset),
+    ACCESSOR_MAP(View, hex),
+    { NULL, NULL, NULL }
+};
+
+Function_mapping functions[] = {
+    FUNCTION_MAP(View, move_rows),
+    FUNCTION_MAP(View, move_columns),
+    FUNCTION_MAP(View, overwrite),
+    { NULL, NULL, NULL }
+};
+
+} // namespace
+
+// The accessors and functions that get merged into the ro template.
+Mapping_pair View::extension()
+{
+    return Mapping_pair(accessors, functions);
+}
+
+// JavaScript method: ro.move_rows(Int32)
+// Moves the cursor by visual rows, so a long wrapped line is walked one
+// screen row at a time. With more than one cursor, each moves by lines.
+FUNCTION_DEFINE(View, move_rows)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int32_t rows;
+    if (!smart_convert(args[0], &rows)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.move_rows(Int32)."));
+    }
+
+    if (self->cursors->active())
+        self->cursors->move_lines(rows);
+    else
+        self->view->move_rows(rows);
+    return Undefined();
+}
+
+// JavaScript method: ro.move_columns(Int32)
+// Moves the cursor, or every cursor, by characters within its line.
+FUNCTION_DEFINE(View, move_columns)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int32_t columns;
+    if (!smart_convert(args[0], &columns)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.move_columns(Int32)."));
+    }
+
+    if (self->cursors->active())
+        self->cursors->move_columns(columns);
+    else
+        self->view->move_columns(columns);
+    return Undefined();
+}
+
+// JavaScript method: ro.overwrite(Array)
+// Replaces the bytes under the cursor with the values in the array, one
+// byte each, and moves the cursor past them.
+//
+// EXAMPLE:
+//  ro.overwrite([0x90, 0x90]);
+FUNCTION_DEFINE(View, overwrite)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    std::vector<int32_t> values;
+    if (args.Length() != 1 || !smart_convert(args[0], &values)) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.overwrite(Array)."));
+    }
+
+    std::string bytes;
+    for (size_t i = 0; i < values.size(); ++i) {
+        if (values[i] < 0 || values[i] > 255) {
+            return Exception::TypeError(
+                    String::New(
+                        "ro.overwrite takes byte values from 0 to 255."));
+        }
+        bytes += (char)values[i];
+    }
+
+    self->view->overwrite(bytes.data(), bytes.size());
+    return Undefined();
+}
+
+// JavaScript getter: ro.line : Int32
+// The line of the cursor, starting from 0.
+ACCESSOR_GETTER_DEFINE(View, line)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Number::New(self->view->line());
+}
+
+// JavaScript setter: ro.line : Int32
+// Moves the cursor to the start of a line.
+ACCESSOR_SETTER_DEFINE(View, line)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    int32_t line;
+    if (!smart_convert(value, &line) || line < 0) {
+        Exception::Error(
+                String::New(
+                    "line is a positive Int32"));
+        return;
+    }
+    self->view->set_line(line);
+}
+
+// JavaScript getter: ro.column : Int32
+// The byte column of the cursor in its line.
+ACCESSOR_GETTER_DEFINE(View, column)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Number::New(self->view->column());
+}
+
+// JavaScript setter: ro.column : Int32
+// Moves the cursor within its line, stopping at the end of the line.
+ACCESSOR_SETTER_DEFINE(View, column)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    int32_t column;
+    if (!smart_convert(value, &column) || column < 0) {
+        Exception::Error(
+                String::New(
+                    "column is a positive Int32"));
+        return;
+    }
+    self->view->set_column(column);
+}
+
+// JavaScript getter: ro.offset : Number
+// The byte offset of the cursor in the buffer.
+ACCESSOR_GETTER_DEFINE(View, offset)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Number::New(self->view->cursor);
+}
+
+// JavaScript setter: ro.offset : Number
+// Moves the cursor to a byte offset, stopping at the end of the buffer.
+ACCESSOR_SETTER_DEFINE(View, offset)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    double offset;
+    if (!smart_convert(value, &offset) || offset < 0) {
+        Exception::Error(
+                String::New(
+                    "offset is a positive Number"));
+        return;
+    }
+    self->view->set_offset((size_t)offset);
+}
+
+// JavaScript getter: ro.hex : boolean
+// True while the buffer is shown as a hex dump.
+ACCESSOR_GETTER_DEFINE(View, hex)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Boolean::New(self->view->hex());
+}
+
+// JavaScript setter: ro.hex : boolean
+// Shows the buffer as a hex dump or as text. A binary buffer stays hex.
+ACCESSOR_SETTER_DEFINE(View, hex)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    bool hex;
+    if (!smart_convert(value, &hex)) {
+        Exception::Error(
+                String::New(
+                    "hex is a boolean"));
+        return;
+    }
+    self->view->set_hex(hex);
+}
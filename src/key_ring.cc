@@ -0,0 +1,188 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/key_ring.hpp>
+#include <rotide/varint.hpp>
+
+#include <algorithm>
+
+// Positions inside the ring are counted in bytes from the start of the
+// oldest entry, so they run from 0 to used no matter where the bytes
+// wrapped around to.
+
+namespace {
+
+size_t entry_size(size_t length)
+{
+    return 2 * varint_size(length) + length;
+}
+
+} // namespace
+
+Key_ring::Key_ring(size_t capacity)
+    : data(std::max(capacity, (size_t)1)), head(0), used(0), entries(0)
+{
+}
+
+unsigned char Key_ring::byte(size_t at) const
+{
+    return data[(head + at) % data.size()];
+}
+
+void Key_ring::write(size_t at, const unsigned char* from, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+        data[(head + at + i) % data.size()] = from[i];
+}
+
+// Reads the varint at *at and moves past it.
+size_t Key_ring::read_varint(size_t* at) const
+{
+    unsigned char buffer[MAX_VARINT];
+    size_t size = 0;
+    do {
+        buffer[size] = byte(*at + size);
+    } while ((buffer[size++] & 0x80) && size < MAX_VARINT);
+
+    unsigned long length = 0;
+    get_varint(buffer, buffer + size, &length);
+    *at += size;
+    return length;
+}
+
+// Reads the trailing length of the entry ending at *end and moves in
+// front of it. The low bits are last, so this walks backwards.
+size_t Key_ring::read_trailer(size_t* end) const
+{
+    unsigned long length = 0;
+    int shift = 0;
+    unsigned char b;
+    do {
+        b = byte(--*end);
+        length |= (unsigned long)(b & 0x7F) << shift;
+        shift += 7;
+    } while (b & 0x80);
+    return length;
+}
+
+void Key_ring::drop_oldest()
+{
+    size_t at = 0;
+    size_t length = read_varint(&at);
+    size_t size = entry_size(length);
+
+    head = (head + size) % data.size();
+    used -= size;
+    --entries;
+}
+
+void Key_ring::push(const Key_list& keys)
+{
+    size_t length = 0;
+    for (Key_list::const_iterator cit = keys.begin(), end = keys.end();
+            cit != end;
+            ++cit)
+    {
+        length += varint_size(*cit);
+    }
+
+    size_t size = entry_size(length);
+    if (size > data.size())
+        return;
+
+    while (used + size > data.size())
+        drop_oldest();
+
+    unsigned char buffer[MAX_VARINT];
+    size_t at = used;
+    size_t bytes = put_varint(length, buffer) - buffer;
+    write(at, buffer, bytes);
+    at += bytes;
+
+    for (Key_list::const_iterator cit = keys.begin(), end = keys.end();
+            cit != end;
+            ++cit)
+    {
+        size_t key_bytes = put_varint(*cit, buffer) - buffer;
+        write(at, buffer, key_bytes);
+        at += key_bytes;
+    }
+
+    // The trailer is the same varint backwards.
+    put_varint(length, buffer);
+    std::reverse(buffer, buffer + bytes);
+    write(at, buffer, bytes);
+
+    used += size;
+    ++entries;
+}
+
+void Key_ring::resize(size_t capacity)
+{
+    capacity = std::max(capacity, (size_t)1);
+
+    // Walk back from the newest entry for as long as entries still fit.
+    size_t start = used, kept = 0;
+    while (kept < entries) {
+        size_t end = start;
+        size_t length = read_trailer(&end);
+        size_t size = entry_size(length);
+        if (used - start + size > capacity)
+            break;
+        start -= size;
+        ++kept;
+    }
+
+    std::vector<unsigned char> resized(capacity);
+    for (size_t at = start; at < used; ++at)
+        resized[at - start] = byte(at);
+
+    data.swap(resized);
+    head = 0;
+    used -= start;
+    entries = kept;
+}
+
+bool Key_ring::get(size_t back, Entry* entry) const
+{
+    if (back >= entries)
+        return false;
+
+    size_t end = used;
+    size_t length = 0;
+    for (size_t i = 0; i <= back; ++i) {
+        length = read_trailer(&end);
+        end -= length;
+        if (i < back)
+            end -= varint_size(length);
+    }
+
+    entry->ring = this;
+    entry->at = end;
+    entry->left = length;
+    return true;
+}
+
+bool Key_ring::Entry::next(int* key)
+{
+    if (left == 0)
+        return false;
+
+    size_t from = at;
+    *key = ring->read_varint(&at);
+    left -= at - from;
+    return true;
+}
@@ -0,0 +1,129 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/marks.hpp>
+#include <rotide/view.hpp>
+
+namespace {
+
+// The oldest jumps are forgotten past this many.
+const size_t MAX_JUMPS = 100;
+
+} // namespace
+
+Marks::Marks(Buffer_view* view)
+    : view(view), buffer(view->buffer), anchors(view->buffer),
+      current(0), walking(false)
+{
+}
+
+bool Marks::set(int name)
+{
+    if (view->buffer != buffer)
+        return false;
+
+    Mark_map::iterator it = named.find(name);
+    if (it != named.end())
+        anchors.remove(it->second);
+    named[name] = anchors.add(view->cursor);
+    return true;
+}
+
+// Going to a mark is a jump even when it is typed at a prompt, which
+// does not count as a command of its own.
+bool Marks::go(int name)
+{
+    Mark_map::iterator it = named.find(name);
+    if (view->buffer != buffer || it == named.end())
+        return false;
+
+    push(view->cursor);
+    view->set_offset(anchors.start(it->second));
+    return true;
+}
+
+void Marks::moved(size_t from, unsigned long generation)
+{
+    if (walking) {
+        walking = false;
+        return;
+    }
+
+    if (view->buffer != buffer || buffer->generation != generation)
+        return;
+
+    size_t was = buffer->line_of(from);
+    size_t line = view->line();
+    if ((was > line ? was - line : line - was) > 1)
+        push(from);
+}
+
+// The first step back also keeps where the cursor is, so forward() can
+// return to it.
+bool Marks::back()
+{
+    if (view->buffer != buffer)
+        return false;
+
+    if (current == jumps.size()) {
+        push(view->cursor);
+        current = jumps.size() - 1;
+    }
+
+    if (current == 0)
+        return false;
+    return visit(--current);
+}
+
+bool Marks::forward()
+{
+    if (view->buffer != buffer || current + 1 >= jumps.size())
+        return false;
+    return visit(++current);
+}
+
+// A jump made after walking back drops the ones that were ahead, and one
+// to the line of the last jump is not kept twice.
+void Marks::push(size_t offset)
+{
+    while (jumps.size() > current) {
+        anchors.remove(jumps.back());
+        jumps.pop_back();
+    }
+
+    if (!jumps.empty() && buffer->line_of(anchors.start(jumps.back()))
+            == buffer->line_of(offset))
+    {
+        current = jumps.size();
+        return;
+    }
+
+    if (jumps.size() == MAX_JUMPS) {
+        anchors.remove(jumps.front());
+        jumps.erase(jumps.begin());
+    }
+
+    jumps.push_back(anchors.add(offset));
+    current = jumps.size();
+}
+
+bool Marks::visit(size_t at)
+{
+    view->set_offset(anchors.start(jumps[at]));
+    walking = true;
+    return true;
+}
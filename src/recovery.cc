@@ -0,0 +1,370 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/recovery.hpp>
+#include <rotide/varint.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[] = "RRJ1";
+const size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+
+// Edits held in memory as bytes; bigger ones are handed over as
+// snapshots.
+const size_t RING_SIZE = 256 * 1024;
+
+// A batch goes to the disk after this long, or once this much is waiting.
+const int SYNC_MS = 1000;
+const size_t SYNC_BYTES = 64 * 1024;
+
+// FNV-1a, enough to tell a torn batch from a whole one.
+unsigned long checksum(const char* data, size_t size)
+{
+    unsigned long hash = 2166136261UL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= (unsigned char)data[i];
+        hash = (hash * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+void put(std::string* out, unsigned long value)
+{
+    unsigned char buffer[MAX_VARINT];
+    out->append((char*)buffer, put_varint(value, buffer) - buffer);
+}
+
+bool get(const unsigned char** in, const unsigned char* end,
+        unsigned long* value)
+{
+    *in = get_varint(*in, end, value);
+    return *in != NULL;
+}
+
+bool write_all(int fd, const char* data, size_t size)
+{
+    while (size) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+// What the journal was made for: the file's size and mtime. A file that
+// does not exist yet is all zeroes.
+std::string file_key(const std::string& path)
+{
+    std::string key;
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0)
+        memset(&st, 0, sizeof(st));
+
+    put(&key, st.st_size);
+    put(&key, st.st_mtim.tv_sec);
+    put(&key, st.st_mtim.tv_nsec);
+    return key;
+}
+
+} // namespace
+
+std::string Recovery_journal::path_for(const std::string& file)
+{
+    size_t slash = file.rfind('/');
+    if (slash == std::string::npos)
+        return "." + file + ".recover";
+    return file.substr(0, slash + 1) + "." + file.substr(slash + 1)
+        + ".recover";
+}
+
+Recovery_journal::Recovery_journal(Buffer* buffer)
+    : buffer(buffer), fd(-1), listening(false),
+      ring(NULL), head(0), used(0), restart(false), stopping(false)
+{
+    if (buffer->path.empty())
+        return;
+
+    fd = ::open(path_for(buffer->path).c_str(),
+            O_RDWR | O_CREAT | O_APPEND, 0600);
+    if (fd >= 0)
+        ring = new char[RING_SIZE];
+}
+
+// Whatever was not written yet goes out before the journal is closed. If
+// the buffer ends up the same as the file, the journal is removed.
+Recovery_journal::~Recovery_journal()
+{
+    if (fd < 0)
+        return;
+
+    if (listening)
+        buffer->unlisten(this);
+    {
+        Lock lock(mutex);
+        stopping = true;
+        ready.signal();
+    }
+    join();
+    close(fd);
+
+    if (!buffer->modified)
+        unlink(path_for(buffer->path).c_str());
+    delete[] ring;
+}
+
+bool Recovery_journal::write_header(const std::string& file)
+{
+    std::string header(MAGIC, MAGIC_SIZE);
+    header += file_key(file);
+    return ftruncate(fd, 0) == 0
+        && write_all(fd, header.data(), header.size());
+}
+
+size_t Recovery_journal::replay()
+{
+    if (fd < 0 || listening)
+        return 0;
+
+    struct stat st;
+    std::string journal;
+    if (fstat(fd, &st) == 0)
+        journal.resize(st.st_size);
+
+    size_t done = 0;
+    while (done < journal.size()) {
+        ssize_t bytes = pread(fd, &journal[done], journal.size() - done, done);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            break;
+        done += bytes;
+    }
+    journal.resize(done);
+
+    std::string header(MAGIC, MAGIC_SIZE);
+    header += file_key(buffer->path);
+
+    size_t edits = 0;
+    if (journal.compare(0, header.size(), header) != 0) {
+        write_header(buffer->path);
+    } else {
+        const unsigned char* in = (const unsigned char*)journal.data()
+            + header.size();
+        const unsigned char* end = (const unsigned char*)journal.data()
+            + journal.size();
+        const unsigned char* valid = in;
+
+        while (in < end) {
+            unsigned long length, sum;
+            if (!get(&in, end, &length) || !get(&in, end, &sum)
+                    || length > (size_t)(end - in)
+                    || checksum((const char*)in, length) != sum)
+                break;
+
+            const unsigned char* batch_end = in + length;
+            while (in < batch_end) {
+                unsigned long offset, removed, inserted;
+                if (!get(&in, batch_end, &offset)
+                        || !get(&in, batch_end, &removed)
+                        || !get(&in, batch_end, &inserted)
+                        || inserted > (size_t)(batch_end - in)
+                        || offset + removed > buffer->size())
+                    break;
+
+                if (removed)
+                    buffer->remove(offset, removed);
+                if (inserted)
+                    buffer->insert(offset, (const char*)in, inserted);
+                in += inserted;
+                ++edits;
+            }
+
+            if (in != batch_end)
+                break;
+            valid = in;
+        }
+
+        // Anything after the last whole batch is dropped, so new batches
+        // follow on from it.
+        if (ftruncate(fd, valid - (const unsigned char*)journal.data()) < 0)
+            write_header(buffer->path);
+    }
+
+    buffer->listen(this);
+    listening = true;
+    start();
+    return edits;
+}
+
+// Only asks for it: the writer thread starts the file over before it
+// writes anything that comes after.
+void Recovery_journal::reset()
+{
+    if (fd < 0)
+        return;
+
+    Lock lock(mutex);
+    head = used = 0;
+    spilled.clear();
+    restart = true;
+    restart_file = buffer->path;
+    ready.signal();
+}
+
+void Recovery_journal::written(Buffer* buffer)
+{
+    if (fd < 0)
+        return;
+
+    reset();
+    if (buffer->snapshot().root == buffer->saved.root)
+        return;
+
+    Lock lock(mutex);
+    spill(Recovery_edit(buffer->snapshot(), 0, buffer->saved.size(),
+                buffer->size()));
+}
+
+// The only work done per edit: a few varints and the inserted bytes are
+// copied into the ring. An edit the ring cannot take is spilled for the
+// writer thread to read, which is O(1) here however big it is.
+void Recovery_journal::edited(Buffer* buffer, const Buffer_edit& edit)
+{
+    // Undone back to the file, or grown along with it: nothing to keep.
+    if (buffer->snapshot().root == buffer->saved.root) {
+        reset();
+        return;
+    }
+
+    unsigned char header[3 * MAX_VARINT];
+    unsigned char* end = header;
+    end = put_varint(edit.offset, end);
+    end = put_varint(edit.removed, end);
+    end = put_varint(edit.inserted, end);
+    size_t size = (end - header) + edit.inserted;
+
+    Lock lock(mutex);
+    if (spilled.empty() && used + size <= RING_SIZE) {
+        append((const char*)header, end - header);
+        append(buffer->snapshot(), edit.offset, edit.inserted);
+        if (used >= SYNC_BYTES)
+            ready.signal();
+    } else {
+        spill(Recovery_edit(buffer->snapshot(), edit.offset, edit.removed,
+                    edit.inserted));
+    }
+}
+
+// The mutex has to be held.
+void Recovery_journal::spill(const Recovery_edit& edit)
+{
+    spilled.push_back(edit);
+    ready.signal();
+}
+
+void Recovery_journal::append(const char* data, size_t size)
+{
+    size_t tail = (head + used) % RING_SIZE;
+    size_t first = std::min(size, RING_SIZE - tail);
+    memcpy(ring + tail, data, first);
+    memcpy(ring, data + first, size - first);
+    used += size;
+}
+
+void Recovery_journal::append(const Buffer_snapshot& snapshot,
+        size_t offset, size_t size)
+{
+    size_t tail = (head + used) % RING_SIZE;
+    size_t first = std::min(size, RING_SIZE - tail);
+    snapshot.read(offset, first, ring + tail);
+    snapshot.read(offset + first, size - first, ring);
+    used += size;
+}
+
+// Empties the ring into batch. The mutex has to be held.
+void Recovery_journal::take(std::string* batch)
+{
+    size_t first = std::min(used, RING_SIZE - head);
+    batch->append(ring + head, first);
+    batch->append(ring, used - first);
+    head = used = 0;
+}
+
+// Frames the edits in batch and writes them. Only the writer thread
+// writes, once replay() is done.
+void Recovery_journal::flush(std::string* batch)
+{
+    std::string frame;
+    put(&frame, batch->size());
+    put(&frame, checksum(batch->data(), batch->size()));
+    frame += *batch;
+    write_all(fd, frame.data(), frame.size());
+}
+
+// Everything that piled up is taken in one go under the mutex; the text
+// of spilled edits is read and the file written after letting go of it.
+void Recovery_journal::run()
+{
+    bool done = false;
+    while (!done) {
+        std::string batch, file;
+        Recovery_edit_list edits;
+        bool restarted;
+        {
+            Lock lock(mutex);
+            if (used < SYNC_BYTES && spilled.empty() && !restart
+                    && !stopping)
+                ready.wait(mutex, SYNC_MS);
+            done = stopping;
+
+            take(&batch);
+            edits.swap(spilled);
+            restarted = restart;
+            file.swap(restart_file);
+            restart = false;
+        }
+
+        for (Recovery_edit_list::const_iterator cit = edits.begin(),
+                end = edits.end();
+                cit != end;
+                ++cit)
+        {
+            put(&batch, cit->offset);
+            put(&batch, cit->removed);
+            put(&batch, cit->inserted);
+            batch += cit->after.text(cit->offset, cit->inserted);
+        }
+
+        if (restarted)
+            write_header(file);
+        if (!batch.empty())
+            flush(&batch);
+        if (restarted || !batch.empty())
+            fdatasync(fd);
+    }
+}
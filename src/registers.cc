@@ -0,0 +1,356 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/registers.hpp>
+#include <rotide/events.hpp>
+#include <rotide/thread.hpp>
+#include <rotide/view.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <rotide/curses.hpp>
+
+namespace {
+
+// Large pieces are written straight from their blocks; this is only the
+// most one write() is asked to do.
+const size_t WRITE_SIZE = 1024 * 1024;
+
+bool cancelled(Clip_run* run)
+{
+    return __sync_fetch_and_add(&run->cancelled, 0) != 0;
+}
+
+// A file nobody else can open: it is unlinked as soon as it is made, and
+// goes away with the last descriptor or mapping of it.
+int temp_file()
+{
+    const char* dir = getenv("TMPDIR");
+    std::string temp = std::string(dir && *dir ? dir : "/tmp")
+        + "/rotide.XXXXXX";
+
+    std::vector<char> name(temp.begin(), temp.end());
+    name.push_back('\0');
+
+    int fd = mkstemp(&name[0]);
+    if (fd >= 0)
+        unlink(&name[0]);
+    return fd;
+}
+
+bool write_out(int out, const Buffer_snapshot& text, Clip_run* run)
+{
+    Piece_iterator it(text, 0);
+    const char* data;
+    size_t size;
+    while (it.next(&data, &size)) {
+        if (cancelled(run)) {
+            errno = ECANCELED;
+            return false;
+        }
+
+        while (size) {
+            ssize_t written = write(out, data, std::min(size, WRITE_SIZE));
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written == 0)
+                errno = EIO;
+            if (written <= 0)
+                return false;
+
+            data += written;
+            size -= written;
+        }
+    }
+    return true;
+}
+
+// Runs command through the shell with in and out as its standard input
+// and output, and its errors thrown away so they stay off the screen.
+// Returns 0 or why it failed.
+int run_command(const std::string& command, int in, int out)
+{
+    int null = open("/dev/null", O_RDWR);
+    if (null < 0)
+        return errno;
+
+    pid_t child = fork();
+    if (child == 0) {
+        dup2(in < 0 ? null : in, 0);
+        dup2(out < 0 ? null : out, 1);
+        dup2(null, 2);
+        execl("/bin/sh", "sh", "-c", command.c_str(), (char*)NULL);
+        _exit(127);
+    }
+
+    int error = child < 0 ? errno : 0;
+    close(null);
+
+    int status;
+    while (child > 0 && waitpid(child, &status, 0) < 0) {
+        if (errno != EINTR) {
+            error = errno;
+            break;
+        }
+    }
+    if (child > 0 && !error
+            && (!WIFEXITED(status) || WEXITSTATUS(status) != 0))
+    {
+        error = ENOEXEC;
+    }
+    return error;
+}
+
+class Clip_done : public Event {
+public:
+    Clip_done(Yank_registers* registers, const Ref<Clip_run>& run,
+            const Ref<Buffer_block>& text, int error, bool pasting)
+        : registers(registers), trip(run), text(text), error(error),
+          pasting(pasting)
+    {
+    }
+
+    void run()
+    {
+        if (pasting)
+            registers->pasted(trip.get(), text, error);
+        else
+            registers->copied(trip.get(), error);
+    }
+
+private:
+    Yank_registers* registers;
+    Ref<Clip_run> trip;
+    Ref<Buffer_block> text;
+    int error;
+    bool pasting;
+};
+
+// Spills text into a temporary file and gives it to the copy command,
+// or has the paste command fill one and maps it.
+class Clip_job : public Job {
+public:
+    Clip_job(Yank_registers* registers, Event_queue* events,
+            const Ref<Clip_run>& run, const std::string& command,
+            const Buffer_snapshot& text, bool pasting)
+        : registers(registers), events(events), trip(run),
+          command(command), text(text), pasting(pasting)
+    {
+    }
+
+    void run();
+
+private:
+    Yank_registers* registers;
+    Event_queue* events;
+    Ref<Clip_run> trip;
+    std::string command;
+    Buffer_snapshot text;
+    bool pasting;
+};
+
+void Clip_job::run()
+{
+    Ref<Buffer_block> pasted;
+    int error = 0;
+    int fd = temp_file();
+    if (fd < 0) {
+        error = errno;
+    } else if (pasting) {
+        error = run_command(command, -1, fd);
+        if (error)
+            close(fd);
+        else if (!map_file(fd, &pasted))
+            error = errno;
+        else if (!pasted.empty())
+            pasted->build_index();
+    } else {
+        if (!write_out(fd, text, trip.get())
+                || lseek(fd, 0, SEEK_SET) < 0)
+        {
+            error = errno;
+        } else {
+            error = run_command(command, fd, -1);
+        }
+        close(fd);
+        text = Buffer_snapshot();
+    }
+
+    if (!cancelled(trip.get()))
+        events->post(new Clip_done(registers, trip, pasted, error, pasting));
+}
+
+} // namespace
+
+Yank_registers::Yank_registers(Buffer_view* view, Curses* curses,
+        Thread_pool* pool, Event_queue* events)
+    : copy_command("xclip -selection clipboard -i"),
+      paste_command("xclip -selection clipboard -o"),
+      view(view), curses(curses), pool(pool), events(events), busy(false)
+{
+    run = new Clip_run;
+}
+
+Yank_registers::~Yank_registers()
+{
+    __sync_lock_test_and_set(&run->cancelled, 1);
+}
+
+// The last line may not end in a newline. Its copy gets one, so that
+// putting lines always makes whole lines; only that byte is new.
+void Yank_registers::yank_lines(int name, size_t count)
+{
+    Buffer* buffer = view->buffer;
+    size_t line = buffer->line_of(view->cursor);
+    size_t start = buffer->line_start(line);
+    size_t last = line + std::max(count, (size_t)1) - 1;
+    size_t end = buffer->line_end(last);
+
+    Yank yank;
+    yank.lines = true;
+    if (end < buffer->size()) {
+        yank.text = buffer->snapshot().slice(start, end + 1 - start);
+    } else {
+        Buffer lines;
+        lines.insert(0, buffer->snapshot().slice(start, end - start), 1);
+        lines.insert(lines.size(), "\n", 1);
+        yank.text = lines.snapshot();
+    }
+    keep(name, yank);
+}
+
+void Yank_registers::yank(int name, size_t offset, size_t size)
+{
+    Yank yank;
+    yank.text = view->buffer->snapshot().slice(offset, size);
+    keep(name, yank);
+}
+
+// Lines go in front of the line after the cursor's, with the cursor
+// left at the first of them; anything else goes in at the cursor, which
+// ends up after it.
+bool Yank_registers::put(int name, size_t count)
+{
+    Yank_map::const_iterator found = registers.find(name);
+    if (found == registers.end() || found->second.text.root.empty())
+        return false;
+
+    const Yank& yank = found->second;
+    Buffer* buffer = view->buffer;
+    if (!yank.lines) {
+        size_t at = view->cursor;
+        buffer->insert(at, yank.text, count);
+        view->set_offset(at + yank.text.size() * count);
+        return true;
+    }
+
+    size_t end = buffer->line_end(buffer->line_of(view->cursor));
+    if (end == buffer->size() && end > 0 && buffer->at(end - 1) != '\n')
+        buffer->insert(end, "\n", 1);
+    size_t at = std::min(end + 1, buffer->size());
+    buffer->insert(at, yank.text, count);
+    view->set_offset(at);
+    return true;
+}
+
+size_t Yank_registers::size(int name) const
+{
+    Yank_map::const_iterator found = registers.find(name);
+    return found == registers.end() ? 0 : found->second.text.size();
+}
+
+bool Yank_registers::copy(int name)
+{
+    Yank_map::const_iterator found = registers.find(name);
+    if (busy || found == registers.end()
+            || found->second.text.root.empty())
+    {
+        return false;
+    }
+
+    busy = true;
+    curses->status() << CLEAR << "Copying " << found->second.text.size()
+        << " bytes to the clipboard ...";
+    pool->submit(new Clip_job(this, events, run, copy_command,
+                found->second.text, false));
+    return true;
+}
+
+bool Yank_registers::paste()
+{
+    if (busy)
+        return false;
+
+    busy = true;
+    curses->status() << CLEAR << "Pasting from the clipboard ...";
+    pool->submit(new Clip_job(this, events, run, paste_command,
+                Buffer_snapshot(), true));
+    return true;
+}
+
+void Yank_registers::copied(Clip_run* finished, int error)
+{
+    if (finished != run.get())
+        return;
+
+    busy = false;
+    if (error) {
+        curses->status() << CLEAR << COLOR(WHITE, RED) << BOLD
+            << "Could not copy: " << strerror(error) << RESET;
+        return;
+    }
+    curses->status() << CLEAR << "Copied to the clipboard";
+}
+
+// The clipboard lands in its own register and the unnamed one, so the
+// next put brings it in.
+void Yank_registers::pasted(Clip_run* finished,
+        const Ref<Buffer_block>& text, int error)
+{
+    if (finished != run.get())
+        return;
+
+    busy = false;
+    if (error) {
+        curses->status() << CLEAR << COLOR(WHITE, RED) << BOLD
+            << "Could not paste: " << strerror(error) << RESET;
+        return;
+    }
+
+    Yank yank;
+    yank.text = Buffer_snapshot(text);
+    keep(CLIPBOARD_REGISTER, yank);
+    curses->status() << CLEAR << yank.text.size()
+        << " bytes from the clipboard in register "
+        << (char)CLIPBOARD_REGISTER;
+}
+
+void Yank_registers::keep(int name, const Yank& yank)
+{
+    registers[name] = yank;
+    if (name != UNNAMED_REGISTER)
+        registers[UNNAMED_REGISTER] = yank;
+}
@@ -14,22 +14,119 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
-#include <rotide/curses.hpp>
+#include <rotide/buffer.hpp>
+#include <rotide/completion.hpp>
+#include <rotide/cursors.hpp>
+#include <rotide/events.hpp>
+#include <rotide/file_index.hpp>
+#include <rotide/grepper.hpp>
+#include <rotide/marks.hpp>
+#include <rotide/recovery.hpp>
+#include <rotide/registers.hpp>
+#include <rotide/undo.hpp>
+#include <rotide/undo_journal.hpp>
+#include <rotide/view.hpp>
+#include <rotide/watcher.hpp>
+#include <rotide/saver.hpp>
 #include <rotide/scripting.hpp>
+#include <rotide/searcher.hpp>
+#include <rotide/structure.hpp>
+#include <rotide/syntax.hpp>
+#include <rotide/thread.hpp>
+#include <rotide/curses.hpp>
 
 #include <clocale>
+#include <string>
+
+#include <sys/time.h>
+
+namespace {
+
+// Keys are handled for at most this long before the screen is updated,
+// so the display never trails the keyboard by more than a frame.
+const long FRAME_MS = 16;
+
+long now_ms()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+// Hands a key to the engine. Pastes skip the bindings and go into the
+// buffer as one edit.
+void handle_key(char c, Curses* curses, Scripting_engine* engine)
+{
+    std::string paste;
+    if ((c == ESC && curses->get_paste(&paste))
+            || (engine->insert_mode() && is_text(c)
+                && curses->get_burst(c, &paste)))
+    {
+        engine->paste(paste);
+        return;
+    }
+
+    engine->feed((unsigned char)c);
+}
+
+// Waits for the next key. Whatever background work finishes meanwhile
+// is taken in and shown right away.
+bool next_key(char* c, Curses* curses, Event_queue* events,
+        Buffer_view* view)
+{
+    while (!curses->idle(events->fd())) {
+        curses->hold();
+        events->dispatch();
+        view->draw();
+        curses->release();
+    }
+    return curses->get(c);
+}
+
+} // namespace
 
 int main(int argc, char** argv)
 {
     char c;
-    bool insert_mode;
+    bool running;
+    long frame;
 
     setlocale(LC_ALL, "");
 
+    Event_queue events;
+    Thread_pool pool;
+    Buffer buffer;
+    bool opened = (argc < 2) || buffer.open(argv[1]);
+    Undo_tree undo(&buffer);
+    Undo_journal journal(&undo);
+
+    // Edits that never made it to the file last time come back as one
+    // undo step.
+    Recovery_journal recovery(&buffer);
+    size_t recovered = recovery.replay();
+    undo.checkpoint();
+
     Curses curses;
     curses.refresh();
 
-    Scripting_engine engine(&curses);
+    Buffer_view view(&curses, &buffer);
+    Syntax_highlighter syntax(&view, &pool, &events);
+    Structure_index structure(&view, &pool, &events);
+    Marks marks(&view);
+    Cursor_set cursors(&view);
+    Saver saver(&buffer, &curses, &events);
+    Searcher searcher(&view, &pool, &events);
+    Grepper grepper(&pool, &events, &curses);
+    File_index files(&pool, &events);
+    files.start(".");
+    Word_index words(&pool, &events);
+    words.watch(&buffer);
+    Yank_registers yanks(&view, &curses, &pool, &events);
+    File_watcher watcher(&view, &undo, &saver, &curses, &pool, &events);
+    watcher.watch();
+    Scripting_engine engine(&curses, &view, &undo, &saver, &searcher,
+            &grepper, &files, &syntax, &structure, &marks, &cursors, &words,
+            &yanks, &watcher);
 
 
     if (!engine.good)  {
@@ -40,30 +137,42 @@ int main(int argc, char** argv)
 
     curses.clear();
     curses.draw_status_bar();
-    curses.status() << engine.status(); 
+    if (opened && recovered)
+        curses.status() << "Recovered " << recovered << " unsaved edits.";
+    else if (opened)
+        curses.status() << engine.status(); 
+    else
+        curses.status() << argv[1] << " could not be opened.";
+    view.draw();
     curses.refresh();
 
-    //curses.screen_buffer.clear();
-    Curses_pos& at = curses.at(0, 0);
-
-    while (curses.get(&c)) {
-        insert_mode = engine.insert_mode();
-
-        engine.think();
-
-        if (!engine.insert_mode())
-            insert_mode = false;
-
-        if (insert_mode) {
-            at << c;
-
-            if (c == '\n') {
-                at.row++;
-                at.col = 0;
-            }
+    running = next_key(&c, &curses, &events, &view);
+    while (running) {
+        // Everything that was typed while the last frame was drawn is
+        // handled before the next one goes out, so key repeat and fast
+        // typists cost one screen update per frame instead of one per key.
+        curses.hold();
+        frame = now_ms();
+        for (;;) {
+            handle_key(c, &curses, &engine);
+            if (now_ms() - frame >= FRAME_MS || !curses.ready())
+                break;
+            if (!(running = curses.get(&c)))
+                break;
         }
+        events.dispatch();
+        view.draw();
+        curses.release();
 
-        curses.refresh();
+        if (running)
+            running = next_key(&c, &curses, &events, &view);
+    }
+
+    // A save still being written is seen through, so the journals learn
+    // what ended up in the file.
+    if (saver.busy()) {
+        saver.join();
+        events.dispatch();
     }
     return 0;
 }
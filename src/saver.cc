@@ -0,0 +1,261 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/saver.hpp>
+#include <rotide/events.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <rotide/curses.hpp>
+
+namespace {
+
+// Small pieces are gathered into writes of this size.
+const size_t WRITE_SIZE = 1024 * 1024;
+
+// Ranges of the original file at least this long are copied in the
+// kernel instead.
+const size_t COPY_SIZE = 64 * 1024;
+
+// How often the status bar hears about progress.
+const long PROGRESS_MS = 100;
+
+long now_ms()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+class Save_progress : public Event {
+public:
+    Save_progress(Saver* saver, size_t done) : saver(saver), done(done) { }
+    void run() { saver->progress(done); }
+
+private:
+    Saver* saver;
+    size_t done;
+};
+
+class Save_done : public Event {
+public:
+    explicit Save_done(Saver* saver) : saver(saver) { }
+    void run() { saver->finish(); }
+
+private:
+    Saver* saver;
+};
+
+} // namespace
+
+Saver::Saver(Buffer* buffer, Curses* curses, Event_queue* events)
+    : buffer(buffer), curses(curses), events(events),
+      done(0), reported(0), error(0)
+{
+    // umask can only be read by setting it, so that is done once, before
+    // there is a worker to race with.
+    mask = umask(0);
+    umask(mask);
+}
+
+Saver::~Saver()
+{
+    join();
+}
+
+bool Saver::save(const std::string& file)
+{
+    if (busy())
+        return false;
+
+    path = file.empty() ? buffer->path : file;
+    if (path.empty())
+        return false;
+
+    snapshot = buffer->snapshot();
+    done = 0;
+    reported = now_ms();
+    error = 0;
+    return start();
+}
+
+void Saver::progress(size_t bytes)
+{
+    if (!busy())
+        return;
+
+    size_t size = snapshot.size();
+    curses->status() << CLEAR << "Writing " << path << " ... "
+        << (size ? bytes * 100 / size : 100) << "%";
+}
+
+// Joins the worker and takes in what it did. Only a save to the buffer's
+// own file makes the buffer count as saved.
+void Saver::finish()
+{
+    join();
+
+    if (error) {
+        curses->status() << CLEAR << COLOR(WHITE, RED) << BOLD
+            << "Could not write " << path << ": " << strerror(error)
+            << RESET;
+    } else {
+        if (buffer->path.empty())
+            buffer->path = path;
+        if (path == buffer->path)
+            buffer->set_saved(snapshot);
+
+        curses->status() << CLEAR << "\"" << path << "\" "
+            << snapshot.size() << " bytes written";
+    }
+
+    snapshot = Buffer_snapshot();
+}
+
+void Saver::run()
+{
+    size_t slash = path.rfind('/');
+    std::string temp = (slash == std::string::npos)
+        ? "." + path + ".XXXXXX"
+        : path.substr(0, slash + 1) + "." + path.substr(slash + 1)
+            + ".XXXXXX";
+
+    std::vector<char> name(temp.begin(), temp.end());
+    name.push_back('\0');
+
+    int out = mkstemp(&name[0]);
+    if (out < 0) {
+        error = errno;
+    } else {
+        // The new file keeps the permissions of the one it replaces.
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0)
+            fchmod(out, st.st_mode & 07777);
+        else
+            fchmod(out, 0666 & ~mask);
+
+        if (!write_out(out) || fsync(out) < 0)
+            error = errno;
+        if (close(out) < 0 && !error)
+            error = errno;
+        if (!error && rename(&name[0], path.c_str()) < 0)
+            error = errno;
+        if (error)
+            unlink(&name[0]);
+    }
+
+    events->post(new Save_done(this));
+}
+
+// Walks the pieces of the snapshot in order. Pieces that are still in the
+// original file and worth it are copied by the kernel; the others are
+// gathered up and written in large chunks.
+bool Saver::write_out(int out)
+{
+    std::vector<char> chunk;
+    chunk.reserve(WRITE_SIZE);
+
+    Piece_iterator it(snapshot, 0);
+    const Piece* piece;
+    size_t skip;
+    while (it.next_piece(&piece, &skip)) {
+        const char* data = piece->data() + skip;
+        size_t size = piece->length - skip;
+        const Buffer_block* block = piece->block.get();
+
+        if (size >= COPY_SIZE || chunk.size() + size > WRITE_SIZE) {
+            if (!write_range(out, chunk.empty() ? NULL : &chunk[0],
+                        chunk.size()))
+                return false;
+            chunk.clear();
+        }
+
+        if (size >= COPY_SIZE && block->mapped && block->fd >= 0) {
+            size_t copied = copy_range(out, block->fd,
+                    piece->start + skip, size);
+            data += copied;
+            size -= copied;
+        }
+
+        if (size >= WRITE_SIZE) {
+            if (!write_range(out, data, size))
+                return false;
+        } else {
+            chunk.insert(chunk.end(), data, data + size);
+        }
+    }
+
+    return write_range(out, chunk.empty() ? NULL : &chunk[0], chunk.size());
+}
+
+bool Saver::write_range(int out, const char* data, size_t size)
+{
+    while (size) {
+        ssize_t written = write(out, data, std::min(size, WRITE_SIZE));
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written == 0)
+            errno = EIO;
+        if (written <= 0)
+            return false;
+
+        data += written;
+        size -= written;
+        advance(written);
+    }
+    return true;
+}
+
+// Returns how much was copied. Whatever is left over, because the file
+// system cannot do it or the kernel is too old, is written normally.
+size_t Saver::copy_range(int out, int in, size_t offset, size_t size)
+{
+    loff_t from = offset;
+    size_t copied = 0;
+    while (copied < size) {
+        ssize_t bytes = copy_file_range(in, &from, out, NULL,
+                size - copied, 0);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            break;
+
+        copied += bytes;
+        advance(bytes);
+    }
+    return copied;
+}
+
+void Saver::advance(size_t bytes)
+{
+    done += bytes;
+
+    long now = now_ms();
+    if (now - reported >= PROGRESS_MS) {
+        reported = now;
+        events->post(new Save_progress(this, done));
+    }
+}
@@ -15,8 +15,26 @@
 // limitations under the License.
 
 #include <rotide/scripting.hpp>
+#include <rotide/cursors.hpp>
+#include <rotide/marks.hpp>
+#include <rotide/view.hpp>
+#include <rotide/searcher.hpp>
+#include <rotide/undo.hpp>
 #include <rotide/curses.hpp>
+#include <rotide/js/blocks.hpp>
+#include <rotide/js/completion.hpp>
 #include <rotide/js/core.hpp>
+#include <rotide/js/cursors.hpp>
+#include <rotide/js/file.hpp>
+#include <rotide/js/finder.hpp>
+#include <rotide/js/grep.hpp>
+#include <rotide/js/jumps.hpp>
+#include <rotide/js/macro.hpp>
+#include <rotide/js/registers.hpp>
+#include <rotide/js/search.hpp>
+#include <rotide/js/syntax.hpp>
+#include <rotide/js/undo.hpp>
+#include <rotide/js/view.hpp>
 #include <rotide/v8/type_conversion.hpp>
 
 #include <sstream>
@@ -34,6 +52,7 @@ using namespace v8;
 // ro =
 //      insert_mode         : boolean
 //      status              : string
+//      history_size        : Int32
 //      CTRL_A .. CTRL_Z    : integers
 //      A .. Z              : integers
 //
@@ -41,6 +60,7 @@ using namespace v8;
 //      bind        : function ([Key], String, function)
 //      command  : function (function ([Key]))
 //      command  : function (String, function ([Key]))
+//      history     : function (Int32)
 //
 namespace {
 
@@ -50,6 +70,7 @@ Accessors accessors[] = {
     ACCESSOR_MAP(Scripting_engine, status),
     ACCESSOR_MAP(Scripting_engine, mx),
     ACCESSOR_MAP(Scripting_engine, my),
+    ACCESSOR_MAP(Scripting_engine, history_size),
     ACCESSOR_GETTER_MAP(Scripting_engine, CTRL_A),
     ACCESSOR_GETTER_MAP(Scripting_engine, CTRL_B),
     ACCESSOR_GETTER_MAP(Scripting_engine, CTRL_C),
@@ -91,6 +112,7 @@ Function_mapping functions[] = {
     FUNCTION_MAP(Scripting_engine, test),
     FUNCTION_MAP(Scripting_engine, bind),
     FUNCTION_MAP(Scripting_engine, command),
+    FUNCTION_MAP(Scripting_engine, history),
     { NULL, NULL, NULL }
 };
 
@@ -98,12 +120,32 @@ Function_mapping functions[] = {
 // TODO(justinvh): This shouldn't be a constant.
 const int STATUS = 55;
 
+// Bytes of packed key sequences the command history keeps by default.
+const int HISTORY_SIZE = 16 * 1024;
+
+// A macro that replays itself, directly or through others, stops here.
+const int MAX_REPLAY_DEPTH = 100;
+
 } // namespace
 
 // Construct a new scripting instance relative to
-// a curses instance.
-Scripting_engine::Scripting_engine(Curses* curses)
-    : curses(curses)
+// a curses instance, the view it edits through, the undo history,
+// saver, searcher, highlighter, structure index, marks, cursors, word
+// index, yank registers and file watcher of the buffer behind it, and
+// the grepper and file index of the directory around it.
+Scripting_engine::Scripting_engine(Curses* curses, Buffer_view* view,
+        Undo_tree* undo, Saver* saver, Searcher* searcher, Grepper* grepper,
+        File_index* files, Syntax_highlighter* syntax,
+        Structure_index* structure, Marks* marks, Cursor_set* cursors,
+        Word_index* words, Yank_registers* yanks, File_watcher* watcher)
+    : curses(curses), view(view), undo(undo), saver(saver),
+      searcher(searcher), grepper(grepper), files(files), syntax(syntax),
+      structure(structure), marks(marks), cursors(cursors), words(words),
+      yanks(yanks), watcher(watcher),
+      key_history(HISTORY_SIZE),
+      search_from(0), key_taken(false), prompt(NO_PROMPT),
+      recording_register(0), replay_register(0), replay_count(0),
+      replay_depth(0)
 {
     assert(curses != NULL && "Null instance of curses passed!");
 
@@ -250,11 +292,25 @@ void Scripting_engine::handle_key_combination()
     Curses_pos& status = curses->status();
     int key = curses->last_key;
 
+    if (attrs.search_mode) {
+        type_search(key);
+        return;
+    }
+
+    // In insert mode a control key bound on its own runs right away, so
+    // things like completion work while typing. Tab and backspace are
+    // left to be typed.
+    const Function_list* list;
+    bool immediate = insert_mode() && key_combination.empty()
+        && is_ctrl_key(key) && key != CTRL_J && key != CTRL_I
+        && key != CTRL_H && bindings.get(key, &list);
 
     // If the key pressed is any variation of CTRL+A to CTRL+Z
     // excluding CTRL+J (since ENTER holds the same values traditionally)
     // then append the key to the vector and update the status.
-    if ((attrs.cmd_mode && is_cmd_key(key)) || (is_ctrl_key(key) && key != CTRL_J)) {
+    if ((attrs.cmd_mode && is_cmd_key(key))
+            || (is_ctrl_key(key) && key != CTRL_J && !immediate))
+    {
         status << CLEAR;
 
         if (attrs.cmd_mode) {
@@ -284,7 +340,6 @@ void Scripting_engine::handle_key_combination()
     Context::Scope scope(context);
     Handle<Array> arguments;
 
-    const Function_list* list;
     std::string cmd_no_args;
 
     // If we are in insert mode then we don't want to parse
@@ -302,21 +357,12 @@ void Scripting_engine::handle_key_combination()
 
     // Remember, CTRL+J is the same as ENTER.
     if (key == CTRL_J && attrs.cmd_mode) {
-        std::stringstream buf;
-        for (kcit = key_combination.begin(),
-                end = key_combination.end();
-                kcit != end;
-                ++kcit)
-        {
-            buf << KEY_STR(*kcit, KS_NO_PRETTY_PRINT);
-        }
-        const std::string& cmd_str = buf.str();
+        const std::string& cmd_str = typed();
         if (!bindings.get(cmd_str, &cmd_no_args, &list, &arguments)) {
             status  << "ERROR: \"" 
                     << cmd_no_args << "\" is not an editor command." 
                     << RESET;
-            key_history.push_back(key_combination);
-            key_combination.clear();
+            remember(key);
             return;
         }
     } else if (key == CTRL_J) {
@@ -339,8 +385,7 @@ void Scripting_engine::handle_key_combination()
                 }
             }
             status << "\" is not an editor command." << RESET;
-            key_history.push_back(key_combination);
-            key_combination.clear();
+            remember(key);
             return;
         }
     } else if (!insert_mode()
@@ -380,8 +425,7 @@ void Scripting_engine::handle_key_combination()
             << "ERROR: \"" 
             << KEY_STR(key) << "\" is not an editor command." 
             << RESET;
-        key_history.push_back(key_combination);
-        key_combination.clear();
+        remember(key);
         return;
     }
 
@@ -430,6 +474,9 @@ void Scripting_engine::handle_key_combination()
         }
     }
 
+    // A binding that took the key keeps it from being typed.
+    key_taken = immediate && success;
+
     if (!success && cmd_no_args.size()) {
         status << CLEAR << COLOR(WHITE, RED) << BOLD;
         status 
@@ -438,7 +485,76 @@ void Scripting_engine::handle_key_combination()
             << RESET;
     }
 
-    key_history.push_back(key_combination);
+    remember(key);
+}
+
+// The search prompt takes every key until Enter or Esc. Only the pattern
+// is rebuilt for each key; the searcher works out how much of the last
+// search it can keep.
+void Scripting_engine::type_search(int key)
+{
+    Curses_pos& status = curses->status();
+
+    if (key == CTRL_J || key == ESC) {
+        attrs.search_mode = false;
+        attrs.cmd_mode = false;
+        attrs.status = "-- WAITING --";
+        if (key == CTRL_J) {
+            searcher->accept();
+            marks->moved(search_from, view->buffer->generation);
+        } else {
+            searcher->abandon();
+            status << CLEAR;
+        }
+        remember(key);
+        return;
+    }
+
+    if (key == 127 || key == CTRL_H) {
+        if (!key_combination.empty())
+            key_combination.pop_back();
+    } else if (is_cmd_key(key)) {
+        key_combination.push_back(key);
+    } else {
+        return;
+    }
+
+    const std::string& pattern = typed();
+    status << CLEAR << attrs.status << pattern;
+    searcher->type(pattern);
+}
+
+// The command line typed so far.
+std::string Scripting_engine::typed() const
+{
+    std::stringstream buf;
+    for (Key_list::const_iterator kcit = key_combination.begin(),
+            end = key_combination.end();
+            kcit != end;
+            ++kcit)
+    {
+        buf << KEY_STR(*kcit, KS_NO_PRETTY_PRINT);
+    }
+    return buf.str();
+}
+
+void Scripting_engine::prompt_search()
+{
+    attrs.status = "/";
+    attrs.cmd_mode = true;
+    attrs.search_mode = true;
+    search_from = view->cursor;
+    key_combination.clear();
+    curses->status() << CLEAR << attrs.status;
+}
+
+// Commands go into the history as the keys that made them. A single key
+// command never lands in key_combination, so it goes in on its own.
+void Scripting_engine::remember(int key)
+{
+    if (key_combination.empty())
+        key_combination.push_back(key);
+    key_history.push(key_combination);
     key_combination.clear();
 }
 
@@ -450,6 +566,214 @@ void Scripting_engine::think()
     curses->refresh();
 }
 
+// A key is recorded only if recording was on before and after it was
+// handled, so the keys that start and stop a recording stay out of it.
+// Keys fed by a replay are never recorded; the command that started the
+// replay already was. The marks hear where each command started, so
+// they can tell a jump; a replay is one command to them too.
+void Scripting_engine::feed(int key)
+{
+    if (prompt != NO_PROMPT) {
+        take_register(key);
+        return;
+    }
+
+    bool recorded = recording() && replay_depth == 0;
+    bool insert_mode = attrs.insert_mode;
+    char c = key;
+    bool searching = attrs.search_mode;
+    Buffer* shown = view->buffer;
+    size_t from = view->cursor;
+    unsigned long generation = shown->generation;
+
+    curses->last_key = key;
+    key_taken = false;
+    think();
+
+    if (!attrs.insert_mode || key_taken)
+        insert_mode = false;
+
+    if (insert_mode && cursors->active()) {
+        if (key == 127 || key == CTRL_H)
+            cursors->backspace();
+        else
+            cursors->insert(&c, 1);
+    } else if (insert_mode) {
+        if (key == 127 || key == CTRL_H)
+            view->backspace();
+        else
+            view->insert(&c, 1);
+    }
+
+    if (recorded && recording())
+        registers[recording_register].push_back(key);
+
+    // A replay still waiting for its register keeps its count until the
+    // next key names one.
+    if (replay_count && prompt == NO_PROMPT)
+        run_replay();
+
+    if (!attrs.insert_mode && replay_depth == 0)
+        undo->checkpoint();
+
+    // The search prompt tells the marks itself once it is done.
+    if (replay_depth == 0 && view->buffer == shown && !searching
+            && !attrs.search_mode)
+    {
+        marks->moved(from, generation);
+    }
+}
+
+void Scripting_engine::paste(const std::string& text)
+{
+    undo->checkpoint();
+    if (cursors->active())
+        cursors->insert(text.data(), text.size());
+    else
+        view->insert(text.data(), text.size());
+    undo->checkpoint();
+
+    if (recording() && replay_depth == 0) {
+        Key_list& keys = registers[recording_register];
+        for (std::string::const_iterator cit = text.begin(), end = text.end();
+                cit != end;
+                ++cit)
+        {
+            keys.push_back((unsigned char)*cit);
+        }
+    }
+}
+
+bool Scripting_engine::record(int reg)
+{
+    if (recording())
+        return false;
+
+    if (reg == 0) {
+        prompt = RECORD_PROMPT;
+        return true;
+    }
+
+    if (!is_cmd_key(reg))
+        return false;
+
+    registers[reg].clear();
+    recording_register = reg;
+
+    std::stringstream status;
+    status << "-- RECORDING " << (char)reg << " --";
+    attrs.status = status.str();
+    curses->status() << CLEAR << attrs.status;
+    return true;
+}
+
+void Scripting_engine::stop_recording()
+{
+    if (!recording())
+        return;
+
+    recording_register = 0;
+    attrs.status = "-- WAITING --";
+    curses->status() << CLEAR << attrs.status;
+}
+
+// Replays are only queued here. They run once the key that asked for
+// them has been handled, which keeps the keys of the replay from ending
+// up in the middle of a half-typed command.
+bool Scripting_engine::replay(int reg, int count)
+{
+    if (count <= 0)
+        return false;
+
+    if (reg == 0) {
+        prompt = REPLAY_PROMPT;
+        replay_register = 0;
+        replay_count = count;
+        return true;
+    }
+
+    if (registers.find(reg) == registers.end())
+        return false;
+
+    replay_register = reg;
+    replay_count = count;
+    return true;
+}
+
+bool Scripting_engine::mark(int name)
+{
+    if (name == 0) {
+        prompt = MARK_PROMPT;
+        return true;
+    }
+
+    return is_cmd_key(name) && marks->set(name);
+}
+
+bool Scripting_engine::go_mark(int name)
+{
+    if (name == 0) {
+        prompt = GO_MARK_PROMPT;
+        return true;
+    }
+
+    return is_cmd_key(name) && marks->go(name);
+}
+
+// The key after ro.record(), ro.replay(), ro.mark() or ro.go_mark()
+// without a name names it. ESC or anything unprintable drops the request.
+void Scripting_engine::take_register(int key)
+{
+    Register_prompt action = prompt;
+    int count = replay_count;
+
+    prompt = NO_PROMPT;
+    replay_count = 0;
+    if (!is_cmd_key(key))
+        return;
+
+    if (action == RECORD_PROMPT) {
+        record(key);
+    } else if (action == MARK_PROMPT) {
+        mark(key);
+    } else if (action == GO_MARK_PROMPT) {
+        if (!go_mark(key)) {
+            attrs.status = "-- NO SUCH MARK --";
+            curses->status() << CLEAR << attrs.status;
+        }
+    } else if (replay(key, count) && replay_count) {
+        run_replay();
+    }
+}
+
+// Feeds a register count times. Nothing reaches the terminal until the
+// last repetition is done, so a long replay costs one screen update.
+void Scripting_engine::run_replay()
+{
+    int reg = replay_register;
+    int count = replay_count;
+    replay_register = replay_count = 0;
+
+    if (replay_depth >= MAX_REPLAY_DEPTH)
+        return;
+
+    // A copy, since the register can be recorded over while it plays.
+    const Key_list keys = registers[reg];
+
+    ++replay_depth;
+    curses->hold();
+    for (int i = 0; i < count; ++i) {
+        for (Key_list::const_iterator cit = keys.begin(), end = keys.end();
+                cit != end;
+                ++cit)
+        {
+            feed(*cit);
+        }
+    }
+    curses->release();
+    --replay_depth;
+}
+
 // Load a runtime/* file.
 // These files are going to be JavaScript source files relative
 // to the runtime/ directory.
@@ -538,7 +862,24 @@ Handle<Object> Scripting_engine::wrap_class_as_object(
     HandleScope scope;
     if (function_tmpl->IsEmpty())
         (*function_tmpl) = FunctionTemplate::New();
-    generate_fun_tmpl(function_tmpl, accessors, functions, NULL);
+
+    // Modules that extend the ro object directly
+    Extension_list modules;
+    modules.push_back(View::extension());
+    modules.push_back(Macro::extension());
+    modules.push_back(Undo::extension());
+    modules.push_back(File::extension());
+    modules.push_back(Search::extension());
+    modules.push_back(Grep::extension());
+    modules.push_back(Jumps::extension());
+    modules.push_back(Finder::extension());
+    modules.push_back(Syntax::extension());
+    modules.push_back(Blocks::extension());
+    modules.push_back(Cursors::extension());
+    modules.push_back(Completion::extension());
+    modules.push_back(Registers::extension());
+
+    generate_fun_tmpl(function_tmpl, accessors, functions, &modules);
     (*function_tmpl)->SetClassName(String::New("rotide"));
     Local<Function> ctor = (*function_tmpl)->GetFunction();
     Local<Object> obj = ctor->NewInstance();
@@ -633,6 +974,34 @@ FUNCTION_DEFINE(Scripting_engine, command)
 
 }
 
+// JavaScript function: ro.history (Int32)
+// Returns the keys of a command from the history, 0 being the latest, or
+// undefined if the history does not go back that far.
+//
+// EXAMPLE:
+//  var last = ro.history(0);
+FUNCTION_DEFINE(Scripting_engine, history)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(args.Holder());
+    int32_t back;
+    if (!smart_convert(args[0], &back) || back < 0) {
+        return Exception::TypeError(
+                String::New(
+                    "The definition of this method is: \
+                    ro.history(Int32)."));
+    }
+
+    Key_ring::Entry entry;
+    if (!self->key_history.get(back, &entry))
+        return Undefined();
+
+    Local<Array> keys = Array::New();
+    int key;
+    for (uint32_t i = 0; entry.next(&key); ++i)
+        keys->Set(i, Int32::New(key));
+    return keys;
+}
+
 // JavaScript getter: ro.insert_mode : boolean
 // If true the editor is in insert mode. Otherwise it is in a command mode.
 // Returns the value of insert_mode
@@ -764,6 +1133,29 @@ ACCESSOR_SETTER_DEFINE(Scripting_engine, mx)
     self->curses->refresh();
 }
 
+// JavaScript getter: ro.history_size : Int32
+// Bytes kept for the command history.
+ACCESSOR_GETTER_DEFINE(Scripting_engine, history_size)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    return Int32::New(self->key_history.capacity());
+}
+
+// JavaScript setter: ro.history_size : Int32
+// Resizes the command history. Shrinking it drops the oldest commands.
+ACCESSOR_SETTER_DEFINE(Scripting_engine, history_size)
+{
+    Scripting_engine* self = unwrap<Scripting_engine>(info.Holder());
+    int32_t size;
+    if (!smart_convert(value, &size) || size <= 0) {
+        Exception::Error(
+                String::New(
+                    "history_size is a positive Int32"));
+        return;
+    }
+    self->key_history.resize(size);
+}
+
 // JavaScript getter: ro.my : Int32
 // Retrieves the cursor x position.
 ACCESSOR_GETTER_DEFINE(Scripting_engine, my)
@@ -0,0 +1,142 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/search.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Backward searches scan windows of this size, nearest first.
+const size_t WINDOW_SIZE = 1024 * 1024;
+
+// A rough guess at how common a byte is in text and code; higher is more
+// common. Only the order matters.
+int commonness(unsigned char byte)
+{
+    static const char ORDER[] = " etaoinsrhldcumfpgwybvkxjqz\n";
+    const char* found = (const char*)memchr(ORDER, byte, sizeof(ORDER) - 1);
+    if (found)
+        return 300 - (found - ORDER);
+    if (byte >= 'A' && byte <= 'Z')
+        return commonness(byte - 'A' + 'a') - 60;
+    if (byte >= '0' && byte <= '9')
+        return 200;
+    if (byte >= 32 && byte < 127)
+        return 150;
+    return 0;
+}
+
+} // namespace
+
+Literal_search::Literal_search(const std::string& pattern)
+    : needle(pattern), rare(0)
+{
+    for (size_t i = 1; i < needle.size(); ++i) {
+        if (commonness(needle[i]) < commonness(needle[rare]))
+            rare = i;
+    }
+}
+
+bool Literal_search::forward(const Buffer_snapshot& snapshot, size_t from,
+        size_t end, size_t* at) const
+{
+    return scan(snapshot, from, end, false, at);
+}
+
+bool Literal_search::backward(const Buffer_snapshot& snapshot, size_t begin,
+        size_t before, size_t* at) const
+{
+    size_t high = before;
+    while (high > begin) {
+        size_t low = (high - begin > WINDOW_SIZE) ? high - WINDOW_SIZE : begin;
+        if (scan(snapshot, low, high, true, at))
+            return true;
+        high = low;
+    }
+    return false;
+}
+
+const char* Literal_search::find(const char* begin, const char* end) const
+{
+    size_t length = needle.size();
+    if (length == 0 || (size_t)(end - begin) < length)
+        return NULL;
+
+    unsigned char byte = needle[rare];
+    const char* p = begin + rare;
+    const char* stop = end - length + rare + 1;
+    while ((p = (const char*)memchr(p, byte, stop - p)) != NULL) {
+        if (memcmp(p - rare, needle.data(), length) == 0)
+            return p - rare;
+        ++p;
+    }
+    return NULL;
+}
+
+// Looks for the rare byte in [from + rare, end + rare), so that every
+// candidate starts in [from, end). Candidates that fit in the run being
+// scanned are compared in place; the few that reach into other pieces are
+// read out first.
+bool Literal_search::scan(const Buffer_snapshot& snapshot, size_t from,
+        size_t end, bool last, size_t* at) const
+{
+    size_t length = needle.size();
+    size_t total = snapshot.size();
+    if (length == 0 || from >= end || length > total)
+        return false;
+
+    end = std::min(end, total - length + 1);
+    if (from >= end)
+        return false;
+
+    const char* pattern = needle.data();
+    unsigned char byte = needle[rare];
+    bool found = false;
+
+    Piece_iterator it(snapshot, from + rare);
+    const char* data;
+    size_t size;
+    size_t position = from + rare;
+    while (position < end + rare && it.next(&data, &size)) {
+        size_t limit = std::min(size, end + rare - position);
+        const char* p = data;
+        const char* stop = data + limit;
+
+        while ((p = (const char*)memchr(p, byte, stop - p)) != NULL) {
+            size_t index = p - data;
+            size_t start = position + index - rare;
+            bool match;
+            if (index >= rare && index - rare + length <= size)
+                match = memcmp(p - rare, pattern, length) == 0;
+            else
+                match = snapshot.text(start, length) == needle;
+
+            if (match) {
+                *at = start;
+                found = true;
+                if (!last)
+                    return true;
+            }
+            ++p;
+        }
+
+        position += size;
+    }
+
+    return found;
+}
@@ -0,0 +1,594 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/searcher.hpp>
+#include <rotide/events.hpp>
+#include <rotide/search.hpp>
+#include <rotide/thread.hpp>
+#include <rotide/view.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <poll.h>
+#include <regex.h>
+
+#include <rotide/curses.hpp>
+
+using namespace curses_lib;
+
+namespace {
+
+// Chunks are this big. Those of a regular expression are rounded up to
+// the end of a line, unless the line runs on for more than another chunk.
+const size_t CHUNK_SIZE = 4 * 1024 * 1024;
+
+// How far past its end a chunk is matched for a regular expression: to
+// the end of the line there, but no further than this.
+const size_t MAX_OVERLAP = 64 * 1024;
+
+const int REGEX_FLAGS = REG_EXTENDED | REG_NEWLINE;
+
+bool cancelled(Search_scan* scan)
+{
+    return __sync_fetch_and_add(&scan->cancelled, 0) != 0;
+}
+
+bool finished(const Search_scan* scan)
+{
+    for (size_t i = 0; i < scan->done.size(); ++i) {
+        if (!scan->done[i])
+            return false;
+    }
+    return true;
+}
+
+bool before_offset(const Search_match& match, size_t offset)
+{
+    return match.offset < offset;
+}
+
+bool after_offset(size_t offset, const Search_match& match)
+{
+    return offset < match.offset;
+}
+
+// Every match of a literal starting in [begin, end); a match may run on
+// into the next chunk.
+void match_literal(Search_scan* scan, size_t begin, size_t end,
+        Match_list* matches)
+{
+    Literal_search search(scan->pattern);
+    size_t at;
+    while (!cancelled(scan)
+            && search.forward(scan->snapshot, begin, end, &at))
+    {
+        matches->push_back(Search_match(at, search.size()));
+        begin = at + 1;
+    }
+}
+
+// The text of [begin, end), in place if it sits in a single piece and
+// copied out otherwise.
+const char* text_of(const Buffer_snapshot& snapshot, size_t begin,
+        size_t end, std::string* copy)
+{
+    size_t length = end - begin;
+    const char* data;
+    size_t size;
+    Piece_iterator it(snapshot, begin);
+    if (it.next(&data, &size) && size >= length)
+        return data;
+
+    copy->resize(length);
+    snapshot.read(begin, length, &(*copy)[0]);
+    return copy->data();
+}
+
+// The matches of a literal among those of a prefix of it, skip bytes
+// long: only the rest of the pattern is compared, right where the prefix
+// matched.
+void refine_literal(Search_scan* scan, const Match_list& earlier,
+        size_t skip, size_t begin, size_t end, Match_list* matches)
+{
+    const std::string& pattern = scan->pattern;
+    if (skip == pattern.size()) {
+        *matches = earlier;
+        return;
+    }
+
+    // A match may run on past the end of the chunk.
+    size_t last = std::min(end + pattern.size(), scan->snapshot.size());
+    std::string copy;
+    const char* data = text_of(scan->snapshot, begin, last, &copy);
+    const char* rest = pattern.data() + skip;
+    size_t more = pattern.size() - skip;
+
+    size_t checked = 0;
+    for (Match_list::const_iterator it = earlier.begin(), stop = earlier.end();
+            it != stop;
+            ++it)
+    {
+        if (++checked % 4096 == 0 && cancelled(scan))
+            return;
+
+        size_t at = it->offset + skip;
+        if (at + more <= last && memcmp(data + at - begin, rest, more) == 0)
+            matches->push_back(Search_match(it->offset, pattern.size()));
+    }
+}
+
+// Every match of a regular expression starting in [begin, end).
+// REG_NEWLINE still lets a bracket expression such as [[:space:]] match a
+// newline, so the text is matched on to the end of the line after the
+// chunk (see MAX_OVERLAP) for matches that run on into it. REG_STARTEND
+// lets regexec work through the text without terminating it.
+void match_regex(Search_scan* scan, size_t begin, size_t end,
+        Match_list* matches)
+{
+    regex_t regex;
+    if (regcomp(&regex, scan->pattern.c_str(), REGEX_FLAGS) != 0)
+        return;
+
+    const Buffer_snapshot& snapshot = scan->snapshot;
+    size_t total = snapshot.size();
+    size_t stop = std::min(snapshot.line_end(snapshot.line_of(end)) + 1,
+            std::min(end + MAX_OVERLAP, total));
+    size_t length = end - begin;
+    std::string copy;
+    const char* data = text_of(snapshot, begin, stop, &copy);
+
+    // A chunk cut in the middle of a long line does not start one.
+    // Only the text's own end is the end of a line.
+    char before = '\n';
+    if (begin)
+        snapshot.read(begin - 1, 1, &before);
+    bool last = end == total;
+    int flags = REG_STARTEND | (before == '\n' ? 0 : REG_NOTBOL)
+        | (stop == total ? 0 : REG_NOTEOL);
+
+    size_t from = 0;
+    regmatch_t match;
+    while ((from < length || (last && from == length)) && !cancelled(scan)) {
+        match.rm_so = from;
+        match.rm_eo = stop - begin;
+        if (regexec(&regex, data, 1, &match, flags) != 0
+                || (size_t)match.rm_so > length
+                || ((size_t)match.rm_so == length && !last))
+            break;
+
+        matches->push_back(Search_match(begin + match.rm_so,
+                    match.rm_eo - match.rm_so));
+        from = (match.rm_eo > match.rm_so) ? match.rm_eo : match.rm_so + 1;
+    }
+
+    regfree(&regex);
+}
+
+class Chunk_done : public Event {
+public:
+    Chunk_done(Searcher* searcher, const Ref<Search_scan>& scan,
+            size_t chunk)
+        : searcher(searcher), scan(scan), chunk(chunk) { }
+
+    void run() { searcher->delivered(scan.get(), chunk); }
+
+private:
+    Searcher* searcher;
+    Ref<Search_scan> scan;
+    size_t chunk;
+};
+
+// Matches one chunk, or, given an earlier scan for a prefix of the
+// pattern that is done with the chunk, narrows down its matches.
+class Chunk_job : public Job {
+public:
+    Chunk_job(Searcher* searcher, Event_queue* events,
+            const Ref<Search_scan>& scan, size_t chunk,
+            const Ref<Search_scan>& base = Ref<Search_scan>())
+        : searcher(searcher), events(events), scan(scan), base(base),
+          chunk(chunk) { }
+
+    void run()
+    {
+        if (cancelled(scan.get()))
+            return;
+
+        size_t begin = scan->starts[chunk];
+        size_t end = scan->starts[chunk + 1];
+        if (!base.empty())
+            refine_literal(scan.get(), base->matches[chunk],
+                    base->pattern.size(), begin, end, &scan->matches[chunk]);
+        else if (scan->regex)
+            match_regex(scan.get(), begin, end, &scan->matches[chunk]);
+        else
+            match_literal(scan.get(), begin, end, &scan->matches[chunk]);
+
+        if (cancelled(scan.get()))
+            return;
+
+        __sync_lock_test_and_set(&scan->done[chunk], 1);
+        events->post(new Chunk_done(searcher, scan, chunk));
+    }
+
+private:
+    Searcher* searcher;
+    Event_queue* events;
+    Ref<Search_scan> scan, base;
+    size_t chunk;
+};
+
+} // namespace
+
+Search_scan::Search_scan(const Buffer_snapshot& snapshot,
+        const std::string& pattern, bool regex)
+    : refs(0), snapshot(snapshot), pattern(pattern), regex(regex),
+      cancelled(0)
+{
+    // A literal match may run on past the end of its chunk, so a literal
+    // is cut anywhere, and one long line is searched by every core too.
+    size_t total = snapshot.size();
+    starts.push_back(0);
+    while (total - starts.back() > CHUNK_SIZE) {
+        size_t cut = starts.back() + CHUNK_SIZE;
+        if (regex) {
+            size_t line_end = snapshot.line_end(snapshot.line_of(cut)) + 1;
+            if (line_end < total && line_end - cut <= CHUNK_SIZE)
+                cut = line_end;
+        }
+        starts.push_back(cut);
+    }
+    starts.push_back(total);
+
+    matches.resize(starts.size() - 1);
+    done.resize(starts.size() - 1, 0);
+}
+
+size_t Search_scan::chunk_of(size_t offset) const
+{
+    size_t chunk = std::upper_bound(starts.begin(), starts.end() - 1, offset)
+        - starts.begin();
+    return chunk ? chunk - 1 : 0;
+}
+
+Searcher::Searcher(Buffer_view* view, Thread_pool* pool,
+        Event_queue* events)
+    : view(view), pool(pool), events(events), last_regex(false),
+      waiting(false), backward(false), origin(0), typing(false), home(0)
+{
+    view->buffer->listen(this);
+    view->add_highlighter(this);
+}
+
+Searcher::~Searcher()
+{
+    cancel();
+    view->remove_highlighter(this);
+    view->buffer->unlisten(this);
+}
+
+bool Searcher::start(const std::string& pattern, bool regex,
+        std::string* error)
+{
+    cancel();
+    if (pattern.empty()) {
+        *error = "Empty pattern";
+        return false;
+    }
+
+    if (regex) {
+        regex_t compiled;
+        int failed = regcomp(&compiled, pattern.c_str(), REGEX_FLAGS);
+        if (failed) {
+            char message[256];
+            regerror(failed, &compiled, message, sizeof(message));
+            *error = message;
+            return false;
+        }
+        regfree(&compiled);
+    }
+
+    last_pattern = pattern;
+    last_regex = regex;
+    scan = new Search_scan(view->buffer->snapshot(), pattern, regex);
+
+    waiting = true;
+    backward = false;
+    origin = view->cursor;
+
+    view->curses->status() << CLEAR << "Searching for " << pattern << " ...";
+    submit(Ref<Search_scan>());
+    return true;
+}
+
+void Searcher::type(const std::string& pattern)
+{
+    if (!typing) {
+        typing = true;
+        home = view->cursor;
+    }
+
+    cancel();
+    view->set_offset(home);
+    last_pattern = pattern;
+    last_regex = false;
+
+    // Only the scans for prefixes of the pattern are of any more use; the
+    // longest one is the last.
+    std::vector<Ref<Search_scan> > prefixes;
+    for (size_t i = 0; i < typed.size(); ++i) {
+        const std::string& earlier = typed[i]->pattern;
+        if (pattern.compare(0, earlier.size(), earlier) == 0)
+            prefixes.push_back(typed[i]);
+    }
+    typed.swap(prefixes);
+
+    if (pattern.empty())
+        return;
+
+    Ref<Search_scan> base;
+    if (!typed.empty())
+        base = typed.back();
+
+    if (!base.empty() && base->pattern == pattern && finished(base.get())) {
+        scan = base;
+    } else {
+        scan = new Search_scan(view->buffer->snapshot(), pattern, false);
+        if (!base.empty() && base->starts != scan->starts)
+            base.reset();
+        if (!typed.empty() && typed.back()->pattern == pattern)
+            typed.pop_back();
+        typed.push_back(scan);
+    }
+
+    waiting = true;
+    backward = false;
+    origin = home;
+    if (scan != base)
+        submit(base);
+    jump();
+}
+
+void Searcher::accept()
+{
+    typing = false;
+    typed.clear();
+}
+
+void Searcher::abandon()
+{
+    cancel();
+    typed.clear();
+    if (typing)
+        view->set_offset(home);
+    typing = false;
+}
+
+bool Searcher::next(bool backward)
+{
+    if (scan.empty()) {
+        std::string error;
+        if (last_pattern.empty() || !start(last_pattern, last_regex, &error))
+            return false;
+    }
+
+    waiting = true;
+    this->backward = backward;
+    origin = view->cursor;
+    jump();
+    return true;
+}
+
+bool Searcher::collect(const std::string& pattern, bool regex,
+        Match_list* matches, std::string* error)
+{
+    if (scan.empty() || scan->pattern != pattern || scan->regex != regex) {
+        if (!start(pattern, regex, error))
+            return false;
+    }
+
+    // Nothing moves the cursor once the matches are in.
+    waiting = false;
+
+    struct pollfd ready = { events->fd(), POLLIN, 0 };
+    while (!scan.empty() && !complete()) {
+        poll(&ready, 1, -1);
+        events->dispatch();
+    }
+
+    if (scan.empty()) {
+        *error = "Search cancelled";
+        return false;
+    }
+
+    // Each chunk's matches are let go as soon as they are copied, so
+    // there are never two whole copies of a big match list.
+    matches->clear();
+    matches->reserve(count());
+    for (size_t i = 0; i < scan->matches.size(); ++i) {
+        matches->insert(matches->end(), scan->matches[i].begin(),
+                scan->matches[i].end());
+        Match_list().swap(scan->matches[i]);
+    }
+    cancel();
+    return true;
+}
+
+void Searcher::cancel()
+{
+    if (!scan.empty())
+        __sync_lock_test_and_set(&scan->cancelled, 1);
+    scan.reset();
+    waiting = false;
+}
+
+bool Searcher::complete() const
+{
+    return !scan.empty() && finished(scan.get());
+}
+
+size_t Searcher::count() const
+{
+    size_t total = 0;
+    if (scan.empty())
+        return total;
+
+    for (size_t i = 0; i < scan->done.size(); ++i) {
+        if (scan->done[i])
+            total += scan->matches[i].size();
+    }
+    return total;
+}
+
+void Searcher::edited(Buffer*, const Buffer_edit&)
+{
+    cancel();
+    typed.clear();
+}
+
+// Only the chunks under [begin, end) are looked at, and only once they
+// are done, so drawing never waits for a search.
+void Searcher::highlight(size_t begin, size_t end,
+        Highlight_list* highlights)
+{
+    if (scan.empty() || begin >= end
+            || scan->snapshot.root != view->buffer->snapshot().root)
+        return;
+
+    // A literal match can start in the chunk before.
+    size_t chunk = scan->chunk_of(begin);
+    if (chunk > 0)
+        --chunk;
+
+    for (; chunk < scan->done.size() && scan->starts[chunk] < end; ++chunk) {
+        if (!scan->done[chunk])
+            continue;
+
+        // Matches never overlap by more than a pattern's length, so this
+        // only steps back over the few that run into the range.
+        const Match_list& matches = scan->matches[chunk];
+        Match_list::const_iterator it = std::lower_bound(matches.begin(),
+                matches.end(), begin, before_offset);
+        while (it != matches.begin() && (it - 1)->offset + (it - 1)->length
+                > begin)
+            --it;
+
+        for (; it != matches.end() && it->offset < end; ++it) {
+            highlights->push_back(
+                    Highlight(it->offset, it->length, A_REVERSE));
+        }
+    }
+}
+
+void Searcher::delivered(Search_scan* done, size_t)
+{
+    if (done == scan.get())
+        jump();
+}
+
+// Walks the chunks in the direction of the move, starting from the one
+// with the origin and ending with it again from the other side. Stops at
+// the first chunk that is not done yet; the move is finished when it is.
+bool Searcher::jump()
+{
+    if (!waiting)
+        return false;
+
+    size_t chunks = scan->matches.size();
+    size_t first = scan->chunk_of(origin);
+    for (size_t step = 0; step <= chunks; ++step) {
+        size_t chunk = backward
+            ? (first + chunks - step % chunks) % chunks
+            : (first + step) % chunks;
+        if (!scan->done[chunk])
+            return false;
+
+        const Match_list& matches = scan->matches[chunk];
+        Match_list::const_iterator found = matches.end();
+        if (matches.empty()) {
+            continue;
+        } else if (!backward && step == 0) {
+            found = std::upper_bound(matches.begin(), matches.end(),
+                    origin, after_offset);
+        } else if (!backward) {
+            found = matches.begin();
+            if (step == chunks && found->offset > origin)
+                found = matches.end();
+        } else {
+            Match_list::const_iterator below = (step == 0)
+                ? std::lower_bound(matches.begin(), matches.end(),
+                        origin, before_offset)
+                : matches.end();
+            if (below != matches.begin())
+                found = below - 1;
+            if (step == chunks && found != matches.end()
+                    && found->offset < origin)
+                found = matches.end();
+        }
+
+        if (found != matches.end()) {
+            waiting = false;
+            view->set_offset(found->offset);
+            report(*found);
+            return true;
+        }
+    }
+
+    waiting = false;
+    if (typing)
+        view->curses->status() << CLEAR << "/" << last_pattern
+            << "  not found";
+    else
+        view->curses->status() << CLEAR << "Pattern not found: "
+            << last_pattern;
+    return false;
+}
+
+// Says which match this is, once every chunk has been counted.
+void Searcher::report(const Search_match& match)
+{
+    Curses_pos& status = view->curses->status();
+    status << CLEAR << "/" << last_pattern;
+    if (!complete())
+        return;
+
+    size_t chunk = scan->chunk_of(match.offset);
+    size_t index = std::lower_bound(scan->matches[chunk].begin(),
+            scan->matches[chunk].end(), match.offset, before_offset)
+        - scan->matches[chunk].begin();
+    for (size_t i = 0; i < chunk; ++i)
+        index += scan->matches[i].size();
+
+    status << "  " << index + 1 << " of " << count();
+}
+
+// Queues the chunks starting at the origin, since that is where the
+// first match is looked for. The chunks a scan for a prefix of the
+// pattern is done with are narrowed down from its matches instead of
+// searched again.
+void Searcher::submit(const Ref<Search_scan>& base)
+{
+    size_t chunks = scan->matches.size();
+    size_t first = scan->chunk_of(origin);
+    for (size_t i = 0; i < chunks; ++i) {
+        size_t chunk = (first + i) % chunks;
+        if (!base.empty() && __sync_fetch_and_add(&base->done[chunk], 0))
+            pool->submit(new Chunk_job(this, events, scan, chunk, base));
+        else
+            pool->submit(new Chunk_job(this, events, scan, chunk));
+    }
+}
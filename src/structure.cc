@@ -0,0 +1,748 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/structure.hpp>
+#include <rotide/curses_types.hpp>
+#include <rotide/events.hpp>
+#include <rotide/thread.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <string>
+#include <vector>
+
+#include <rotide/curses.hpp>
+
+using namespace curses_lib;
+
+// A run of the buffer. `bytes` and `total` cover the subtree and `own`
+// this chunk alone.
+struct Structure_chunk {
+    Structure_chunk(size_t length, const Structure_summary& own);
+    ~Structure_chunk() { delete left; delete right; }
+
+    Structure_chunk* left;
+    Structure_chunk* right;
+    unsigned priority;
+    size_t length, bytes;
+    Structure_summary own, total;
+};
+
+namespace {
+
+// Bytes per chunk, at most. An edit reads about three of them again.
+const size_t CHUNK = 4096;
+
+// Edits kept while the first build runs. Past this many, reading the
+// buffer again is quicker than playing them back.
+const size_t MAX_PENDING = 4096;
+
+// How far along a line a bracket is looked for, and how long a line can
+// be and still be looked through for the bracket it leaves open.
+const size_t LONG_LINE = 64 * 1024;
+
+const int NO_INDENT = INT_MAX;
+const size_t NOT_FOUND = size_t(-1);
+
+// The terminal's own background.
+const int DEFAULT = -1;
+
+// What each byte is to the index: 1 + kind for an opening bracket, its
+// negation for a closing one, and NEWLINE for a newline.
+const signed char NEWLINE = 127;
+
+struct Byte_classes {
+    Byte_classes()
+    {
+        std::fill(of, of + 256, 0);
+        of[(unsigned char)'('] = 1 + BRACKET_ROUND;
+        of[(unsigned char)')'] = -1 - BRACKET_ROUND;
+        of[(unsigned char)'['] = 1 + BRACKET_SQUARE;
+        of[(unsigned char)']'] = -1 - BRACKET_SQUARE;
+        of[(unsigned char)'{'] = 1 + BRACKET_CURLY;
+        of[(unsigned char)'}'] = -1 - BRACKET_CURLY;
+        of[(unsigned char)'\n'] = NEWLINE;
+    }
+
+    signed char of[256];
+};
+
+const Byte_classes CLASSES;
+
+int class_of(char c)
+{
+    return CLASSES.of[(unsigned char)c];
+}
+
+bool is_bracket(int cls)
+{
+    return cls != 0 && cls != NEWLINE;
+}
+
+unsigned next_priority()
+{
+    static unsigned state = 2463534242U;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+Structure_summary empty_summary()
+{
+    Structure_summary summary;
+    for (int kind = 0; kind < BRACKET_KINDS; ++kind)
+        summary.brackets[kind].sum = summary.brackets[kind].low = 0;
+    summary.indent = NO_INDENT;
+    return summary;
+}
+
+// Makes summary cover what it did followed by next.
+void append(Structure_summary* summary, const Structure_summary& next)
+{
+    for (int kind = 0; kind < BRACKET_KINDS; ++kind) {
+        Bracket_depth& depth = summary->brackets[kind];
+        depth.low = std::min(depth.low, depth.sum + next.brackets[kind].low);
+        depth.sum += next.brackets[kind].sum;
+    }
+    summary->indent = std::min(summary->indent, next.indent);
+}
+
+// The indentation of the line that is indent columns in at offset, or
+// NO_INDENT if there is nothing else on it.
+int indent_at(const Buffer_snapshot& snapshot, size_t offset, int indent)
+{
+    Piece_iterator it(snapshot, offset);
+    const char* data;
+    size_t size;
+    while (it.next(&data, &size)) {
+        for (size_t i = 0; i < size; ++i) {
+            if (data[i] == ' ')
+                ++indent;
+            else if (data[i] == '\t')
+                indent += TAB_WIDTH - indent % TAB_WIDTH;
+            else if (data[i] == '\n' || data[i] == '\r')
+                return NO_INDENT;
+            else
+                return indent;
+        }
+    }
+    return NO_INDENT;
+}
+
+// Reads [start, start + length). A line belongs to the run it starts in,
+// so the indentation of the last one may be read past the end.
+Structure_summary summarize(const Buffer_snapshot& snapshot, size_t start,
+        size_t length)
+{
+    Structure_summary summary = empty_summary();
+    size_t end = start + length;
+    bool measuring = start == 0 || snapshot.at(start - 1) == '\n';
+    int indent = 0;
+
+    Piece_iterator it(snapshot, start);
+    size_t at = start;
+    const char* data;
+    size_t size;
+    while (at < end && it.next(&data, &size)) {
+        size = std::min(size, end - at);
+        for (size_t i = 0; i < size; ++i) {
+            char c = data[i];
+            if (measuring) {
+                if (c == ' ') {
+                    ++indent;
+                    continue;
+                }
+                if (c == '\t') {
+                    indent += TAB_WIDTH - indent % TAB_WIDTH;
+                    continue;
+                }
+                measuring = false;
+                if (c != '\n' && c != '\r')
+                    summary.indent = std::min(summary.indent, indent);
+            }
+
+            int cls = class_of(c);
+            if (cls == 0)
+                continue;
+
+            if (cls == NEWLINE) {
+                measuring = at + i + 1 < end;
+                indent = 0;
+            } else if (cls > 0) {
+                ++summary.brackets[cls - 1].sum;
+            } else {
+                Bracket_depth& depth = summary.brackets[-cls - 1];
+                depth.low = std::min(depth.low, --depth.sum);
+            }
+        }
+        at += size;
+    }
+
+    if (measuring) {
+        summary.indent = std::min(summary.indent,
+                indent_at(snapshot, end, indent));
+    }
+    return summary;
+}
+
+size_t count_bytes(const Structure_chunk* chunk)
+{
+    return chunk ? chunk->bytes : 0;
+}
+
+void update(Structure_chunk* chunk)
+{
+    chunk->bytes = count_bytes(chunk->left) + chunk->length
+        + count_bytes(chunk->right);
+    chunk->total = chunk->left ? chunk->left->total : empty_summary();
+    append(&chunk->total, chunk->own);
+    if (chunk->right)
+        append(&chunk->total, chunk->right->total);
+}
+
+Structure_chunk* merge(Structure_chunk* a, Structure_chunk* b)
+{
+    if (a == NULL)
+        return b;
+    if (b == NULL)
+        return a;
+
+    if (a->priority > b->priority) {
+        a->right = merge(a->right, b);
+        update(a);
+        return a;
+    }
+
+    b->left = merge(a, b->left);
+    update(b);
+    return b;
+}
+
+// Splits the chunks at offset. A chunk across it goes left if
+// straddle_left is set, and right otherwise.
+void split(Structure_chunk* chunk, size_t offset, Structure_chunk** left,
+        Structure_chunk** right, bool straddle_left)
+{
+    if (chunk == NULL) {
+        *left = *right = NULL;
+        return;
+    }
+
+    size_t start = count_bytes(chunk->left);
+    size_t end = start + chunk->length;
+    if (straddle_left ? start < offset : end <= offset) {
+        split(chunk->right, offset > end ? offset - end : 0,
+                &chunk->right, right, straddle_left);
+        update(chunk);
+        *left = chunk;
+    } else {
+        split(chunk->left, offset, left, &chunk->left, straddle_left);
+        update(chunk);
+        *right = chunk;
+    }
+}
+
+// Chunks for [start, start + length), cut into equal parts so an edit
+// does not leave slivers behind.
+Structure_chunk* build(const Buffer_snapshot& snapshot, size_t start,
+        size_t length)
+{
+    Structure_chunk* tree = NULL;
+    size_t parts = (length + CHUNK - 1) / CHUNK;
+    for (size_t i = 0; i < parts; ++i) {
+        size_t part = length / parts + (i < length % parts ? 1 : 0);
+        tree = merge(tree, new Structure_chunk(part,
+                    summarize(snapshot, start, part)));
+        start += part;
+    }
+    return tree;
+}
+
+// Looks through [from, to) for the closing bracket of kind that takes
+// the depth below zero.
+size_t scan_forward(const Buffer_snapshot& snapshot, size_t from,
+        size_t to, int kind, int* depth)
+{
+    Piece_iterator it(snapshot, from);
+    const char* data;
+    size_t size;
+    while (from < to && it.next(&data, &size)) {
+        size = std::min(size, to - from);
+        for (size_t i = 0; i < size; ++i) {
+            int cls = class_of(data[i]);
+            if (cls == kind + 1)
+                ++*depth;
+            else if (cls == -kind - 1 && --*depth < 0)
+                return from + i;
+        }
+        from += size;
+    }
+    return NOT_FOUND;
+}
+
+// Looks back through [from, to) for the opening bracket of kind that
+// takes the depth, counted backwards, above zero.
+size_t scan_backward(const Buffer_snapshot& snapshot, size_t from,
+        size_t to, int kind, int* depth)
+{
+    std::string text = snapshot.text(from, to - from);
+    for (size_t i = text.size(); i-- > 0;) {
+        int cls = class_of(text[i]);
+        if (cls == -kind - 1)
+            --*depth;
+        else if (cls == kind + 1 && ++*depth > 0)
+            return from + i;
+    }
+    return NOT_FOUND;
+}
+
+// A subtree the depth cannot drop below zero in is passed over whole.
+size_t seek_forward(const Structure_chunk* chunk, size_t base, size_t from,
+        int kind, int* depth, const Buffer_snapshot& snapshot)
+{
+    if (chunk == NULL || base + chunk->bytes <= from)
+        return NOT_FOUND;
+
+    const Bracket_depth& total = chunk->total.brackets[kind];
+    if (base >= from && *depth + total.low >= 0) {
+        *depth += total.sum;
+        return NOT_FOUND;
+    }
+
+    size_t found = seek_forward(chunk->left, base, from, kind, depth,
+            snapshot);
+    if (found != NOT_FOUND)
+        return found;
+
+    size_t start = base + count_bytes(chunk->left);
+    size_t end = start + chunk->length;
+    if (end > from) {
+        const Bracket_depth& own = chunk->own.brackets[kind];
+        if (start >= from && *depth + own.low >= 0) {
+            *depth += own.sum;
+        } else {
+            found = scan_forward(snapshot, std::max(start, from), end, kind,
+                    depth);
+            if (found != NOT_FOUND)
+                return found;
+        }
+    }
+
+    return seek_forward(chunk->right, end, from, kind, depth, snapshot);
+}
+
+// The mirror of seek_forward. Walking back, the depth can rise by at
+// most sum - low over a run.
+size_t seek_backward(const Structure_chunk* chunk, size_t base,
+        size_t from, int kind, int* depth, const Buffer_snapshot& snapshot)
+{
+    if (chunk == NULL || base >= from)
+        return NOT_FOUND;
+
+    const Bracket_depth& total = chunk->total.brackets[kind];
+    if (base + chunk->bytes <= from
+            && *depth + total.sum - total.low <= 0) {
+        *depth += total.sum;
+        return NOT_FOUND;
+    }
+
+    size_t start = base + count_bytes(chunk->left);
+    size_t end = start + chunk->length;
+    size_t found = seek_backward(chunk->right, end, from, kind, depth,
+            snapshot);
+    if (found != NOT_FOUND)
+        return found;
+
+    if (start < from) {
+        const Bracket_depth& own = chunk->own.brackets[kind];
+        if (end <= from && *depth + own.sum - own.low <= 0) {
+            *depth += own.sum;
+        } else {
+            found = scan_backward(snapshot, start, std::min(end, from),
+                    kind, depth);
+            if (found != NOT_FOUND)
+                return found;
+        }
+    }
+
+    return seek_backward(chunk->left, base, from, kind, depth, snapshot);
+}
+
+// The first line starting in [from, to) indented no further than most.
+size_t scan_dedent(const Buffer_snapshot& snapshot, size_t from, size_t to,
+        int most)
+{
+    if ((from == 0 || snapshot.at(from - 1) == '\n')
+            && indent_at(snapshot, from, 0) <= most)
+        return from;
+
+    std::string text = snapshot.text(from, to - from);
+    for (size_t i = 0; i + 1 < text.size(); ++i) {
+        if (text[i] == '\n' && indent_at(snapshot, from + i + 1, 0) <= most)
+            return from + i + 1;
+    }
+    return NOT_FOUND;
+}
+
+size_t seek_dedent(const Structure_chunk* chunk, size_t base, size_t from,
+        int most, const Buffer_snapshot& snapshot)
+{
+    if (chunk == NULL || base + chunk->bytes <= from
+            || (base >= from && chunk->total.indent > most))
+        return NOT_FOUND;
+
+    size_t found = seek_dedent(chunk->left, base, from, most, snapshot);
+    if (found != NOT_FOUND)
+        return found;
+
+    size_t start = base + count_bytes(chunk->left);
+    size_t end = start + chunk->length;
+    if (end > from && (start < from || chunk->own.indent <= most)) {
+        found = scan_dedent(snapshot, std::max(start, from), end, most);
+        if (found != NOT_FOUND)
+            return found;
+    }
+
+    return seek_dedent(chunk->right, end, from, most, snapshot);
+}
+
+// Reads a whole snapshot into pieces for the index to be built from.
+class Structure_job : public Job {
+public:
+    Structure_job(Structure_index* index, Event_queue* events,
+            const Ref<Structure_run>& build, const Buffer_snapshot& snapshot)
+        : index(index), events(events), build(build), snapshot(snapshot)
+    {
+    }
+
+    void run();
+
+private:
+    Structure_index* index;
+    Event_queue* events;
+    Ref<Structure_run> build;
+    Buffer_snapshot snapshot;
+};
+
+class Structure_built : public Event {
+public:
+    Structure_built(Structure_index* index,
+            const Ref<Structure_run>& build, Structure_piece_list* pieces)
+        : index(index), build(build), pieces(pieces) { }
+    ~Structure_built() { delete pieces; }
+
+    void run() { index->built(build.get(), pieces); }
+
+private:
+    Structure_index* index;
+    Ref<Structure_run> build;
+    Structure_piece_list* pieces;
+};
+
+bool cancelled(Structure_run* run)
+{
+    return __sync_fetch_and_add(&run->cancelled, 0) != 0;
+}
+
+void Structure_job::run()
+{
+    Structure_piece_list* pieces = new Structure_piece_list;
+    size_t size = snapshot.size();
+    pieces->reserve((size + CHUNK - 1) / CHUNK);
+    for (size_t start = 0; start < size; start += CHUNK) {
+        if (cancelled(build.get())) {
+            delete pieces;
+            return;
+        }
+
+        Structure_piece piece;
+        piece.length = std::min(CHUNK, size - start);
+        piece.summary = summarize(snapshot, start, piece.length);
+        pieces->push_back(piece);
+    }
+    events->post(new Structure_built(index, build, pieces));
+}
+
+} // namespace
+
+Structure_chunk::Structure_chunk(size_t length,
+        const Structure_summary& own)
+    : left(NULL), right(NULL), priority(next_priority()),
+      length(length), bytes(length), own(own), total(own)
+{
+}
+
+Structure_index::Structure_index(Buffer_view* view, Thread_pool* pool,
+        Event_queue* events)
+    : view(view), buffer(view->buffer), pool(pool), events(events),
+      root(NULL), marked_cursor(NOT_FOUND), marked_generation(0),
+      marking(false)
+{
+    marked[0] = marked[1] = 0;
+    mark_attr = COLOR_PAIR(COLOR(BLACK, CYAN)()) | BOLD;
+
+    buffer->listen(this);
+    view->add_highlighter(this);
+    start();
+}
+
+Structure_index::~Structure_index()
+{
+    if (!run.empty())
+        __sync_lock_test_and_set(&run->cancelled, 1);
+    view->remove_highlighter(this);
+    buffer->unlisten(this);
+    delete root;
+}
+
+// Throws the index away and reads the buffer again in the background.
+void Structure_index::start()
+{
+    if (!run.empty())
+        __sync_lock_test_and_set(&run->cancelled, 1);
+
+    delete root;
+    root = NULL;
+    pending.clear();
+
+    // Binary content has no brackets or indentation worth the scan.
+    if (buffer->binary) {
+        run.reset();
+        return;
+    }
+
+    run = new Structure_run;
+    pool->submit(new Structure_job(this, events, run, buffer->snapshot()));
+}
+
+void Structure_index::built(Structure_run* finished,
+        Structure_piece_list* pieces)
+{
+    if (finished != run.get())
+        return;
+
+    for (Structure_piece_list::const_iterator it = pieces->begin(),
+            end = pieces->end();
+            it != end;
+            ++it)
+    {
+        root = merge(root, new Structure_chunk(it->length, it->summary));
+    }
+    run.reset();
+
+    // Each edit is played over the text as it was right after it.
+    for (size_t i = 0; i < pending.size(); ++i) {
+        apply(pending[i], i + 1 < pending.size()
+                ? pending[i + 1].before : buffer->snapshot());
+    }
+    pending.clear();
+}
+
+void Structure_index::edited(Buffer* buffer, const Buffer_edit& edit)
+{
+    if (buffer->binary)
+        return;
+
+    if (run.empty())
+        apply(edit, buffer->snapshot());
+    else if (pending.size() < MAX_PENDING)
+        pending.push_back(edit);
+    else
+        start();
+}
+
+// The chunks the edit touches are read again, and so are their
+// neighbours: a chunk's summary depends on the byte in front of it and
+// on indentation running on into the next.
+void Structure_index::apply(const Buffer_edit& edit,
+        const Buffer_snapshot& after)
+{
+    Structure_chunk *left, *middle, *right, *rest, *edge;
+    split(root, edit.offset, &left, &rest, false);
+    split(rest, edit.offset + edit.removed - count_bytes(left), &middle,
+            &right, true);
+
+    if (left) {
+        split(left, left->bytes - 1, &left, &edge, false);
+        middle = merge(edge, middle);
+    }
+    if (right) {
+        split(right, 1, &edge, &right, true);
+        middle = merge(middle, edge);
+    }
+
+    size_t start = count_bytes(left);
+    size_t length = count_bytes(middle) + edit.inserted - edit.removed;
+    delete middle;
+    root = merge(merge(left, build(after, start, length)), right);
+}
+
+size_t Structure_index::forward(int kind, size_t from)
+{
+    int depth = 0;
+    return seek_forward(root, 0, from, kind, &depth, buffer->snapshot());
+}
+
+size_t Structure_index::backward(int kind, size_t from)
+{
+    int depth = 0;
+    return seek_backward(root, 0, from, kind, &depth, buffer->snapshot());
+}
+
+size_t Structure_index::dedent(size_t from, int indent)
+{
+    return seek_dedent(root, 0, from, indent, buffer->snapshot());
+}
+
+bool Structure_index::match(size_t offset, size_t* bracket, size_t* other)
+{
+    if (!ready() || offset >= buffer->size())
+        return false;
+
+    size_t end = std::min(buffer->line_end(buffer->line_of(offset)),
+            offset + LONG_LINE);
+    std::string text = buffer->text(offset, end - offset);
+    for (size_t i = 0; i < text.size(); ++i) {
+        int cls = class_of(text[i]);
+        if (!is_bracket(cls))
+            continue;
+
+        *bracket = offset + i;
+        *other = (cls > 0) ? forward(cls - 1, *bracket + 1)
+            : backward(-cls - 1, *bracket);
+        return *other != NOT_FOUND;
+    }
+    return false;
+}
+
+// The last bracket on the line that is still open at its end.
+bool Structure_index::opened_last(size_t line, size_t* offset, int* kind)
+{
+    size_t start = buffer->line_start(line);
+    size_t length = buffer->line_end(line) - start;
+    if (length > LONG_LINE)
+        return false;
+
+    std::string text = buffer->text(start, length);
+    std::vector<size_t> open;
+    for (size_t i = 0; i < text.size(); ++i) {
+        int cls = class_of(text[i]);
+        if (!is_bracket(cls))
+            continue;
+
+        if (cls > 0) {
+            open.push_back(i);
+            continue;
+        }
+
+        for (size_t j = open.size(); j-- > 0;) {
+            if (class_of(text[open[j]]) == -cls) {
+                open.resize(j);
+                break;
+            }
+        }
+    }
+
+    if (open.empty())
+        return false;
+
+    *offset = start + open.back();
+    *kind = class_of(text[open.back()]) - 1;
+    return true;
+}
+
+// Blank lines at the end of an indented block are left out of it.
+bool Structure_index::block(size_t line, size_t* first, size_t* last)
+{
+    if (!ready() || line + 1 >= buffer->lines())
+        return false;
+
+    size_t offset;
+    int kind;
+    if (opened_last(line, &offset, &kind)) {
+        size_t close = forward(kind, offset + 1);
+        if (close != NOT_FOUND) {
+            size_t end = buffer->line_of(close);
+            if (end <= line + 1)
+                return false;
+
+            *first = line + 1;
+            *last = end - 1;
+            return true;
+        }
+    }
+
+    const Buffer_snapshot& snapshot = buffer->snapshot();
+    int indent = indent_at(snapshot, buffer->line_start(line), 0);
+    if (indent == NO_INDENT)
+        return false;
+
+    size_t found = dedent(buffer->line_start(line + 1), indent);
+    size_t end = (found == NOT_FOUND) ? buffer->lines()
+        : buffer->line_of(found);
+    while (end > line + 1 && indent_at(snapshot,
+                buffer->line_start(end - 1), 0) == NO_INDENT)
+        --end;
+    if (end <= line + 1)
+        return false;
+
+    *first = line + 1;
+    *last = end - 1;
+    return true;
+}
+
+bool Structure_index::jump()
+{
+    size_t bracket, other;
+    if (view->buffer != buffer || !match(view->cursor, &bracket, &other))
+        return false;
+
+    view->set_offset(other);
+    return true;
+}
+
+bool Structure_index::fold()
+{
+    size_t first, last;
+    return view->buffer == buffer && block(view->line(), &first, &last)
+        && view->fold(first, last);
+}
+
+// Only a bracket right under the cursor is marked, with its match.
+void Structure_index::highlight(size_t begin, size_t end,
+        Highlight_list* highlights)
+{
+    if (!ready() || view->buffer != buffer)
+        return;
+
+    if (view->cursor != marked_cursor
+            || buffer->generation != marked_generation) {
+        marked_cursor = view->cursor;
+        marked_generation = buffer->generation;
+        marking = marked_cursor < buffer->size()
+            && is_bracket(class_of(buffer->at(marked_cursor)))
+            && match(marked_cursor, &marked[0], &marked[1]);
+    }
+
+    if (!marking)
+        return;
+
+    for (int i = 0; i < 2; ++i) {
+        if (marked[i] >= begin && marked[i] < end)
+            highlights->push_back(Highlight(marked[i], 1, mark_attr));
+    }
+}
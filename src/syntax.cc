@@ -0,0 +1,659 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/syntax.hpp>
+#include <rotide/curses_types.hpp>
+#include <rotide/events.hpp>
+#include <rotide/thread.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <rotide/curses.hpp>
+
+using namespace curses_lib;
+
+namespace {
+
+const char* STYLE_NAMES[STYLE_COUNT] = {
+    "plain",
+    "keyword",
+    "type",
+    "string",
+    "number",
+    "comment",
+    "preprocessor",
+    "constant",
+    "function"
+};
+
+// The terminal's own background.
+const int DEFAULT = -1;
+
+// Lines longer than this, which are hardly ever code, are left plain and
+// are taken to end in the state they start in.
+const size_t LONG_LINE = 64 * 1024;
+
+const int REGEX_FLAGS = REG_EXTENDED;
+
+const size_t NO_LINE = size_t(-1);
+
+// A visible line at most this far past the known states is lexed on the
+// spot, which takes well under a millisecond.
+const size_t SYNC_LINES = 256;
+
+// Batches handed back by a lexing job start small, so the lines just
+// past an edit come back quickly, and grow to this.
+const size_t FIRST_BATCH = 64;
+const size_t LAST_BATCH = 8192;
+
+// Where a rule next matches in a line, for as long as the lexer stays in
+// the rule's state. so is past the end of the line if it does not match
+// again.
+struct Rule_match {
+    bool searched;
+    size_t so, eo;
+};
+
+// Finds the first match of a rule at or after from that is not empty.
+void search(const Grammar_rule& rule, const char* text, size_t size,
+        size_t from, Rule_match* match)
+{
+    match->searched = true;
+    while (from <= size) {
+        regmatch_t found;
+        found.rm_so = from;
+        found.rm_eo = size;
+        int flags = REG_STARTEND | (from ? REG_NOTBOL : 0);
+        if (regexec(rule.regex, text, 1, &found, flags) != 0)
+            break;
+
+        if (found.rm_eo > found.rm_so) {
+            match->so = found.rm_so;
+            match->eo = found.rm_eo;
+            return;
+        }
+        from = found.rm_so + 1;
+    }
+    match->so = match->eo = size + 1;
+}
+
+// Adds a run, running it together with the one before if they look the
+// same. Plain text is left out.
+void add_span(Syntax_span_list* spans, size_t offset, size_t length,
+        int style)
+{
+    if (spans == NULL || length == 0 || style == STYLE_PLAIN)
+        return;
+
+    if (!spans->empty()) {
+        Syntax_span& last = spans->back();
+        if (last.style == style && last.offset + last.length == offset) {
+            last.length += length;
+            return;
+        }
+    }
+    spans->push_back(Syntax_span(offset, length, style));
+}
+
+// Lexes one line of a snapshot, using text to hold it.
+int lex_snapshot(const Grammar& grammar, const Buffer_snapshot& snapshot,
+        size_t line, int state, Syntax_span_list* spans, std::string* text)
+{
+    size_t start = snapshot.line_start(line);
+    size_t size = snapshot.line_end(line) - start;
+    if (size > LONG_LINE)
+        return state;
+
+    text->resize(size);
+    if (size)
+        snapshot.read(start, size, &(*text)[0]);
+    return lex_line(grammar, state, text->data(), size, spans);
+}
+
+bool cancelled(Lex_run* run)
+{
+    return __sync_fetch_and_add(&run->cancelled, 0) != 0;
+}
+
+} // namespace
+
+// The states at the start of the lines from first on, as lexed by run.
+struct Lex_batch {
+    Lex_batch* next;
+    Ref<Lex_run> run;
+    size_t first;
+    std::vector<int> states;
+};
+
+namespace {
+
+class Lex_ready : public Event {
+public:
+    explicit Lex_ready(Syntax_highlighter* syntax) : syntax(syntax) { }
+    void run() { syntax->receive(); }
+
+private:
+    Syntax_highlighter* syntax;
+};
+
+// Lexes a snapshot from line, which starts in state, to its end.
+class Lex_job : public Job {
+public:
+    Lex_job(Syntax_highlighter* syntax, Event_queue* events,
+            const Ref<Lex_inbox>& inbox, const Ref<Lex_run>& lexing,
+            const Ref<Grammar>& grammar, const Buffer_snapshot& snapshot,
+            size_t line, int state)
+        : syntax(syntax), events(events), inbox(inbox), lexing(lexing),
+          grammar(grammar), snapshot(snapshot), line(line), state(state)
+    {
+    }
+
+    void run()
+    {
+        size_t last = snapshot.lines() - 1;
+        size_t batch_size = FIRST_BATCH;
+        Lex_batch* batch = NULL;
+        std::string text;
+        while (line < last && !cancelled(lexing.get())) {
+            if (batch == NULL) {
+                batch = new Lex_batch;
+                batch->run = lexing;
+                batch->first = line + 1;
+                batch->states.reserve(batch_size);
+            }
+
+            state = lex_snapshot(*grammar, snapshot, line, state, NULL,
+                    &text);
+            batch->states.push_back(state);
+            ++line;
+
+            if (batch->states.size() == batch_size) {
+                publish(batch);
+                batch = NULL;
+                batch_size = std::min(batch_size * 2, LAST_BATCH);
+            }
+        }
+
+        if (batch)
+            publish(batch);
+    }
+
+private:
+    // The main thread is only woken for the first batch it has not
+    // taken in yet.
+    void publish(Lex_batch* batch)
+    {
+        Lex_batch* head;
+        do {
+            head = inbox->head;
+            batch->next = head;
+        } while (!__sync_bool_compare_and_swap(&inbox->head, head, batch));
+
+        if (__sync_lock_test_and_set(&inbox->signalled, 1) == 0)
+            events->post(new Lex_ready(syntax));
+    }
+
+    Syntax_highlighter* syntax;
+    Event_queue* events;
+    Ref<Lex_inbox> inbox;
+    Ref<Lex_run> lexing;
+    Ref<Grammar> grammar;
+    Buffer_snapshot snapshot;
+    size_t line;
+    int state;
+};
+
+} // namespace
+
+Lex_inbox::~Lex_inbox()
+{
+    while (head) {
+        Lex_batch* next = head->next;
+        delete head;
+        head = next;
+    }
+}
+
+int syntax_style(const std::string& name)
+{
+    for (int i = 0; i < STYLE_COUNT; ++i) {
+        if (name == STYLE_NAMES[i])
+            return i;
+    }
+    return -1;
+}
+
+Grammar::Grammar(const std::string& name)
+    : refs(0), name(name)
+{
+}
+
+Grammar::~Grammar()
+{
+    for (Grammar_state_list::iterator it = states.begin(),
+            end = states.end();
+            it != end;
+            ++it)
+    {
+        for (Grammar_rule_list::iterator rule = it->rules.begin(),
+                rules_end = it->rules.end();
+                rule != rules_end;
+                ++rule)
+        {
+            regfree(rule->regex);
+            delete rule->regex;
+        }
+    }
+}
+
+int Grammar::state(const std::string& name)
+{
+    for (size_t i = 0; i < states.size(); ++i) {
+        if (states[i].name == name)
+            return i;
+    }
+
+    Grammar_state made;
+    made.name = name;
+    made.style = STYLE_PLAIN;
+    states.push_back(made);
+    return states.size() - 1;
+}
+
+int Grammar::initial() const
+{
+    for (size_t i = 0; i < states.size(); ++i) {
+        if (states[i].name == "start")
+            return i;
+    }
+    return 0;
+}
+
+bool Grammar::add_rule(int state, const std::string& pattern, int style,
+        int next, std::string* error)
+{
+    regex_t* regex = new regex_t;
+    int failed = regcomp(regex, pattern.c_str(), REGEX_FLAGS);
+    if (failed) {
+        char message[256];
+        regerror(failed, regex, message, sizeof(message));
+        *error = pattern + ": " + message;
+        delete regex;
+        return false;
+    }
+
+    Grammar_rule rule;
+    rule.pattern = pattern;
+    rule.regex = regex;
+    rule.style = style;
+    rule.next = next;
+    states[state].rules.push_back(rule);
+    return true;
+}
+
+bool Grammar::matches(const std::string& path) const
+{
+    for (std::vector<std::string>::const_iterator it = extensions.begin(),
+            end = extensions.end();
+            it != end;
+            ++it)
+    {
+        if (path.size() >= it->size()
+                && path.compare(path.size() - it->size(), it->size(), *it)
+                    == 0)
+            return true;
+    }
+    return false;
+}
+
+Grammar* Grammar::duplicate() const
+{
+    Grammar* copy = new Grammar(name);
+    copy->extensions = extensions;
+    for (size_t i = 0; i < states.size(); ++i) {
+        int state = copy->state(states[i].name);
+        copy->states[state].style = states[i].style;
+        const Grammar_rule_list& rules = states[i].rules;
+        for (Grammar_rule_list::const_iterator it = rules.begin(),
+                end = rules.end();
+                it != end;
+                ++it)
+        {
+            std::string error;
+            copy->add_rule(state, it->pattern, it->style, it->next, &error);
+        }
+    }
+    return copy;
+}
+
+// At each point the rule of the current state that matches first wins,
+// the earlier rule if two start at the same place. Where every rule
+// last matched is kept until the lexer passes it, so a line costs about
+// one search per rule and one per token rather than one per rule and
+// token.
+int lex_line(const Grammar& grammar, int state, const char* text,
+        size_t size, Syntax_span_list* spans)
+{
+    if (grammar.states.empty())
+        return state;
+
+    std::vector<Rule_match> matches;
+    size_t at = 0;
+    bool moved = true;
+    while (at < size) {
+        const Grammar_state& current = grammar.states[state];
+        const Grammar_rule_list& rules = current.rules;
+        if (moved) {
+            Rule_match unknown = { false, 0, 0 };
+            matches.assign(rules.size(), unknown);
+            moved = false;
+        }
+
+        size_t best = rules.size();
+        for (size_t i = 0; i < rules.size(); ++i) {
+            Rule_match& match = matches[i];
+            if (!match.searched || match.so < at)
+                search(rules[i], text, size, at, &match);
+            if (match.so <= size && (best == rules.size()
+                        || match.so < matches[best].so))
+                best = i;
+        }
+
+        if (best == rules.size()) {
+            add_span(spans, at, size - at, current.style);
+            break;
+        }
+
+        const Grammar_rule& rule = rules[best];
+        const Rule_match& match = matches[best];
+        add_span(spans, at, match.so - at, current.style);
+        add_span(spans, match.so, match.eo - match.so,
+                rule.style == STYLE_PLAIN ? current.style : rule.style);
+        at = match.eo;
+
+        if (rule.next >= 0 && rule.next != state) {
+            state = rule.next;
+            moved = true;
+        }
+    }
+    return state;
+}
+
+Syntax_highlighter::Syntax_highlighter(Buffer_view* view, Thread_pool* pool,
+        Event_queue* events)
+    : view(view), buffer(view->buffer), pool(pool), events(events),
+      dirty(0), stale(0), inbox(new Lex_inbox), spans_line(NO_LINE),
+      spans_generation(0)
+{
+    attrs[STYLE_PLAIN] = 0;
+    attrs[STYLE_KEYWORD] = COLOR_PAIR(COLOR(YELLOW, DEFAULT)()) | BOLD;
+    attrs[STYLE_TYPE] = COLOR_PAIR(COLOR(GREEN, DEFAULT)());
+    attrs[STYLE_STRING] = COLOR_PAIR(COLOR(RED, DEFAULT)());
+    attrs[STYLE_NUMBER] = COLOR_PAIR(COLOR(MAGENTA, DEFAULT)());
+    attrs[STYLE_COMMENT] = COLOR_PAIR(COLOR(CYAN, DEFAULT)());
+    attrs[STYLE_PREPROCESSOR] = COLOR_PAIR(COLOR(BLUE, DEFAULT)()) | BOLD;
+    attrs[STYLE_CONSTANT] = COLOR_PAIR(COLOR(MAGENTA, DEFAULT)()) | BOLD;
+    attrs[STYLE_FUNCTION] = COLOR_PAIR(COLOR(BLUE, DEFAULT)());
+
+    buffer->listen(this);
+    view->add_highlighter(this);
+}
+
+Syntax_highlighter::~Syntax_highlighter()
+{
+    cancel();
+    view->remove_highlighter(this);
+    buffer->unlisten(this);
+}
+
+void Syntax_highlighter::add(const Ref<Grammar>& grammar)
+{
+    grammars.push_back(grammar);
+    select();
+}
+
+bool Syntax_highlighter::settled() const
+{
+    return current.empty()
+        || (!states.empty() && dirty >= buffer->lines());
+}
+
+// The last grammar added for the buffer's file.
+void Syntax_highlighter::select()
+{
+    Ref<Grammar> chosen;
+    for (std::vector<Ref<Grammar> >::const_iterator it = grammars.begin(),
+            end = grammars.end();
+            it != end;
+            ++it)
+    {
+        if ((*it)->matches(buffer->path))
+            chosen = *it;
+    }
+
+    if (chosen != current) {
+        cancel();
+        current = chosen;
+        background.reset();
+        if (!current.empty())
+            background = current->duplicate();
+        states.clear();
+        dirty = stale = 0;
+        spans_line = NO_LINE;
+    }
+}
+
+void Syntax_highlighter::cancel()
+{
+    if (job.empty())
+        return;
+
+    __sync_lock_test_and_set(&job->cancelled, 1);
+    job.reset();
+}
+
+// Starts lexing from the first line whose state is not known, unless a
+// job is already on its way there.
+void Syntax_highlighter::schedule()
+{
+    if (!job.empty() || settled())
+        return;
+
+    if (states.empty()) {
+        states.push_back(current->initial());
+        dirty = 1;
+        stale = 0;
+        if (settled())
+            return;
+    }
+
+    job = new Lex_run;
+    pool->submit(new Lex_job(this, events, inbox, job, background,
+                buffer->snapshot(), dirty - 1, states[dirty - 1]));
+}
+
+// The states of the lines after the edited one are shifted to where the
+// lines went; those of the lines put in are unknown. Lexing starts over
+// at the line after the edit, and can't stop early until it has passed
+// the last line put in by any edit since it last ran. A job still lexing
+// the old text is no use any more.
+void Syntax_highlighter::edited(Buffer*, const Buffer_edit& edit)
+{
+    cancel();
+    spans_line = NO_LINE;
+    size_t first = edit.line + 1;
+    if (first >= states.size())
+        return;
+
+    size_t gone = std::min(edit.removed_lines, states.size() - first);
+    states.erase(states.begin() + first, states.begin() + first + gone);
+    states.insert(states.begin() + first, edit.inserted_lines, -1);
+
+    if (stale > first + edit.removed_lines)
+        stale = stale - edit.removed_lines + edit.inserted_lines;
+    else if (stale > first)
+        stale = first;
+    stale = std::max(stale, first + edit.inserted_lines);
+    dirty = std::min(std::min(dirty, first), states.size());
+}
+
+// Batches are pushed newest first, so the list is turned around before
+// they are taken in.
+void Syntax_highlighter::receive()
+{
+    __sync_lock_release(&inbox->signalled);
+    Lex_batch* taken = __sync_lock_test_and_set(&inbox->head,
+            (Lex_batch*)NULL);
+
+    Lex_batch* batches = NULL;
+    while (taken) {
+        Lex_batch* next = taken->next;
+        taken->next = batches;
+        batches = taken;
+        taken = next;
+    }
+
+    while (batches) {
+        Lex_batch* next = batches->next;
+        if (!job.empty() && batches->run == job) {
+            merge(*batches);
+            spans_line = NO_LINE;
+        }
+        delete batches;
+        batches = next;
+    }
+
+    schedule();
+}
+
+// A job started at or before dirty, on the text as it is now, so its
+// states are right. Once one matches what was cached past the last line
+// put in, the rest of the cache is right too, and the job is only
+// needed again for lines never lexed at all.
+void Syntax_highlighter::merge(const Lex_batch& batch)
+{
+    for (size_t i = 0; i < batch.states.size(); ++i) {
+        size_t line = batch.first + i;
+        if (line < dirty)
+            continue;
+
+        int state = batch.states[i];
+        if (line < states.size()) {
+            if (line > stale && states[line] == state) {
+                dirty = states.size();
+                cancel();
+                return;
+            }
+            states[line] = state;
+        } else {
+            states.push_back(state);
+        }
+        ++dirty;
+    }
+}
+
+void Syntax_highlighter::highlight(size_t begin, size_t end,
+        Highlight_list* highlights)
+{
+    if (current.empty() || view->buffer != buffer)
+        return;
+
+    for (size_t line = buffer->line_of(begin); line < buffer->lines();
+            ++line)
+    {
+        size_t start = buffer->line_start(line);
+        if (start >= end)
+            break;
+
+        const Syntax_span_list& runs = spans(line);
+        for (Syntax_span_list::const_iterator it = runs.begin(),
+                runs_end = runs.end();
+                it != runs_end;
+                ++it)
+        {
+            size_t from = std::max(begin, start + it->offset);
+            size_t to = std::min(end, start + it->offset + it->length);
+            if (from < to) {
+                highlights->push_back(Highlight(from, to - from,
+                            attrs[it->style]));
+            }
+        }
+
+        if (buffer->line_end(line) >= end)
+            break;
+    }
+
+    schedule();
+}
+
+// Lexes up to line on the spot if it is only a little past the known
+// states. Returns whether the state at its start is known. A job lexing
+// from further back is stopped once this catches up with the cache.
+bool Syntax_highlighter::settle(size_t line)
+{
+    if (states.empty()) {
+        states.push_back(current->initial());
+        dirty = 1;
+        stale = 0;
+    }
+
+    if (line < dirty)
+        return true;
+    if (line - dirty >= SYNC_LINES)
+        return false;
+
+    std::string text;
+    while (dirty <= line) {
+        int state = lex_snapshot(*current, buffer->snapshot(), dirty - 1,
+                states[dirty - 1], NULL, &text);
+        if (dirty < states.size()) {
+            if (dirty > stale && states[dirty] == state) {
+                dirty = states.size();
+                cancel();
+                continue;
+            }
+            states[dirty] = state;
+        } else {
+            states.push_back(state);
+        }
+        ++dirty;
+    }
+    return true;
+}
+
+// A line whose state is not known yet is lexed from the one it had
+// before the last edits, which is right more often than not, and drawn
+// again once the job has got to it.
+const Syntax_span_list& Syntax_highlighter::spans(size_t line)
+{
+    if (line == spans_line && buffer->generation == spans_generation)
+        return line_spans;
+
+    int state = current->initial();
+    if (settle(line) || (line < states.size() && states[line] >= 0))
+        state = states[line];
+
+    std::string text;
+    line_spans.clear();
+    lex_snapshot(*current, buffer->snapshot(), line, state, &line_spans,
+            &text);
+    spans_line = line;
+    spans_generation = buffer->generation;
+    return line_spans;
+}
@@ -0,0 +1,137 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/thread.hpp>
+
+#include <cerrno>
+#include <ctime>
+
+#include <sys/time.h>
+#include <unistd.h>
+
+bool Condition::wait(Mutex& mutex, int ms)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+
+    struct timespec until;
+    long usec = now.tv_usec + (ms % 1000) * 1000L;
+    until.tv_sec = now.tv_sec + ms / 1000 + usec / 1000000;
+    until.tv_nsec = (usec % 1000000) * 1000;
+
+    return pthread_cond_timedwait(&condition, &mutex.mutex, &until)
+        != ETIMEDOUT;
+}
+
+void* Thread::trampoline(void* self)
+{
+    static_cast<Thread*>(self)->run();
+    return NULL;
+}
+
+bool Thread::start()
+{
+    if (started)
+        return false;
+
+    started = pthread_create(&thread, NULL, trampoline, this) == 0;
+    return started;
+}
+
+void Thread::join()
+{
+    if (!started)
+        return;
+
+    pthread_join(thread, NULL);
+    started = false;
+}
+
+Thread_pool::Thread_pool(size_t threads)
+    : stopping(false)
+{
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cores > 0 ? cores : 1;
+    }
+
+    for (size_t i = 0; i < threads; ++i) {
+        Worker* worker = new Worker(this);
+        if (!worker->start()) {
+            delete worker;
+            break;
+        }
+        workers.push_back(worker);
+    }
+}
+
+Thread_pool::~Thread_pool()
+{
+    {
+        Lock lock(mutex);
+        stopping = true;
+        ready.broadcast();
+    }
+
+    for (Worker_list::iterator it = workers.begin(), end = workers.end();
+            it != end;
+            ++it)
+    {
+        (*it)->join();
+        delete *it;
+    }
+
+    for (Job_queue::iterator it = jobs.begin(), end = jobs.end();
+            it != end;
+            ++it)
+    {
+        delete *it;
+    }
+}
+
+// Without any threads to hand it to, the job runs right here.
+void Thread_pool::submit(Job* job)
+{
+    if (workers.empty()) {
+        job->run();
+        delete job;
+        return;
+    }
+
+    Lock lock(mutex);
+    jobs.push_back(job);
+    ready.signal();
+}
+
+void Thread_pool::Worker::run()
+{
+    for (;;) {
+        Job* job;
+        {
+            Lock lock(pool->mutex);
+            while (pool->jobs.empty() && !pool->stopping)
+                pool->ready.wait(pool->mutex);
+            if (pool->stopping)
+                return;
+
+            job = pool->jobs.front();
+            pool->jobs.pop_front();
+        }
+
+        job->run();
+        delete job;
+    }
+}
@@ -0,0 +1,303 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/undo.hpp>
+#include <rotide/undo_journal.hpp>
+
+#include <algorithm>
+#include <set>
+
+namespace {
+
+// The tree may hold on to this much before old steps are dropped.
+const size_t UNDO_BUDGET = 64 * 1024 * 1024;
+
+// Treap nodes an edit is assumed to copy on top of the node itself.
+const size_t PATH_NODES = 40;
+
+// A step keeps the text it removed alive, plus its share of the tree.
+size_t step_cost(const Undo_node* node)
+{
+    return sizeof(Undo_node) + PATH_NODES * sizeof(Piece_node)
+        + node->removed;
+}
+
+bool older(const Undo_node* a, const Undo_node* b)
+{
+    return a->sequence < b->sequence;
+}
+
+} // namespace
+
+Undo_node::Undo_node(Undo_node* parent, const Buffer_snapshot& snapshot,
+        unsigned long sequence)
+    : parent(parent), active(0), snapshot(snapshot),
+      offset(0), removed(0), inserted(0), session(0), sequence(sequence),
+      cost(0)
+{
+    cost = step_cost(this);
+}
+
+Undo_tree::Undo_tree(Buffer* buffer)
+    : buffer(buffer), journal(NULL), root(NULL), current(NULL),
+      open(false), restoring(false), sequence(0),
+      limit(UNDO_BUDGET), total(0)
+{
+    buffer->listen(this);
+    reset();
+}
+
+Undo_tree::~Undo_tree()
+{
+    buffer->unlisten(this);
+    destroy(root);
+}
+
+void Undo_tree::reset()
+{
+    if (root)
+        destroy(root);
+
+    root = current = new Undo_node(NULL, buffer->snapshot(), ++sequence);
+    total = root->cost;
+    open = false;
+}
+
+// The first edit after a checkpoint starts a step below the current
+// state. Later ones widen it: the part in front of the change and the
+// part behind it only ever shrink, and what is left in the middle is
+// what the step replaced.
+void Undo_tree::edited(Buffer* buffer, const Buffer_edit& edit)
+{
+    if (restoring)
+        return;
+
+    const Buffer_snapshot& after = buffer->snapshot();
+    size_t size = after.size();
+
+    if (!open) {
+        Undo_node* node = new Undo_node(current, after, ++sequence);
+        node->offset = edit.offset;
+        node->removed = edit.removed;
+        node->inserted = edit.inserted;
+
+        current->active = current->children.size();
+        current->children.push_back(node);
+        current = node;
+        open = true;
+    } else {
+        size_t before = current->parent->snapshot.size();
+        size_t tail = before - current->offset - current->removed;
+
+        current->offset = std::min(current->offset, edit.offset);
+        tail = std::min(tail, size - edit.offset - edit.inserted);
+        current->removed = before - current->offset - tail;
+        current->inserted = size - current->offset - tail;
+        current->snapshot = after;
+        total -= current->cost;
+    }
+
+    current->cost = step_cost(current);
+    total += current->cost;
+
+    if (total > limit)
+        prune();
+}
+
+void Undo_tree::written(Buffer* buffer)
+{
+    if (current->snapshot.root != buffer->saved.root)
+        return;
+
+    close();
+    if (journal)
+        journal->anchor(current);
+}
+
+void Undo_tree::checkpoint()
+{
+    close();
+}
+
+void Undo_tree::close()
+{
+    if (!open)
+        return;
+
+    open = false;
+    if (journal)
+        journal->closed(current);
+}
+
+void Undo_tree::prepend(const Buffer_snapshot& snapshot, size_t offset,
+        size_t removed, size_t inserted,
+        unsigned long session, unsigned long sequence)
+{
+    Undo_node* node = new Undo_node(NULL, snapshot, sequence);
+    node->session = session;
+    node->children.push_back(root);
+    total += node->cost;
+
+    root->parent = node;
+    root->offset = offset;
+    root->removed = removed;
+    root->inserted = inserted;
+    total -= root->cost;
+    root->cost = step_cost(root);
+    total += root->cost;
+
+    root = node;
+}
+
+void Undo_tree::restore(Undo_node* node, size_t offset, size_t removed,
+        size_t inserted)
+{
+    restoring = true;
+    buffer->restore(node->snapshot, offset, removed, inserted);
+    restoring = false;
+    current = node;
+}
+
+bool Undo_tree::undo(size_t* offset)
+{
+    close();
+    if (current == root && journal)
+        journal->load();
+    if (current == root)
+        return false;
+
+    Undo_node* node = current;
+    if (offset)
+        *offset = node->offset;
+    restore(node->parent, node->offset, node->inserted, node->removed);
+    return true;
+}
+
+bool Undo_tree::redo(size_t* offset)
+{
+    close();
+    if (current->children.empty())
+        return false;
+
+    Undo_node* node = current->children[current->active];
+    if (offset)
+        *offset = node->offset;
+    restore(node, node->offset, node->removed, node->inserted);
+    return true;
+}
+
+bool Undo_tree::branch(int delta)
+{
+    long count = current->children.size();
+    if (count == 0)
+        return false;
+
+    long active = ((long)current->active + delta) % count;
+    current->active = active < 0 ? active + count : active;
+    return true;
+}
+
+void Undo_tree::set_budget(size_t bytes)
+{
+    limit = bytes;
+    if (total > limit)
+        prune();
+}
+
+// Drops steps until the tree is well under budget, so pruning does not
+// run again on the very next edit. Branches off the way to the current
+// state go first, their oldest leaves before anything else; after that
+// the root moves forward.
+void Undo_tree::prune()
+{
+    size_t target = limit / 4 * 3;
+
+    std::set<const Undo_node*> path;
+    Undo_node_list way;
+    for (Undo_node* node = current; node; node = node->parent) {
+        path.insert(node);
+        way.push_back(node);
+    }
+
+    bool dropped = true;
+    while (total > target && dropped) {
+        Undo_node_list leaves, stack(1, root);
+        while (!stack.empty()) {
+            Undo_node* node = stack.back();
+            stack.pop_back();
+            if (node->children.empty() && !path.count(node))
+                leaves.push_back(node);
+            stack.insert(stack.end(),
+                    node->children.begin(), node->children.end());
+        }
+
+        std::sort(leaves.begin(), leaves.end(), older);
+        dropped = !leaves.empty();
+
+        for (Undo_node_list::iterator it = leaves.begin(), end = leaves.end();
+                it != end && total > target;
+                ++it)
+        {
+            Undo_node* parent = (*it)->parent;
+            Undo_node_list& siblings = parent->children;
+            size_t index = std::find(siblings.begin(), siblings.end(), *it)
+                - siblings.begin();
+
+            siblings.erase(siblings.begin() + index);
+            if (parent->active > index
+                    || parent->active >= siblings.size())
+                parent->active = parent->active ? parent->active - 1 : 0;
+            destroy(*it);
+        }
+    }
+
+    // Everything left is on the way to the current state. way runs from
+    // the current state up to the root.
+    while (total > target && root != current) {
+        way.pop_back();
+        Undo_node* next = way.back();
+
+        Undo_node_list& children = root->children;
+        children.erase(std::find(children.begin(), children.end(), next));
+        destroy(root);
+
+        // The new root replaces nothing, so the text it removed is no
+        // longer held on its behalf.
+        root = next;
+        root->parent = NULL;
+        root->offset = root->removed = root->inserted = 0;
+        total -= root->cost;
+        root->cost = step_cost(root);
+        total += root->cost;
+    }
+
+    // With no parent left the open step has nothing to widen against.
+    if (root == current)
+        open = false;
+}
+
+// Deletes a subtree. Histories get long, so this keeps its own stack.
+void Undo_tree::destroy(Undo_node* node)
+{
+    Undo_node_list stack(1, node);
+    while (!stack.empty()) {
+        Undo_node* top = stack.back();
+        stack.pop_back();
+        stack.insert(stack.end(), top->children.begin(), top->children.end());
+        total -= top->cost;
+        delete top;
+    }
+}
@@ -0,0 +1,532 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/undo_journal.hpp>
+#include <rotide/undo.hpp>
+#include <rotide/varint.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <map>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+const char MAGIC[] = "RUJ1";
+const size_t MAGIC_SIZE = sizeof(MAGIC) - 1;
+
+// Earlier sessions are read this much at a time. Record headers and the
+// fields in front of a step's text fit in MAX_HEADER.
+const size_t READ_SIZE = 64 * 1024;
+const size_t MAX_HEADER = 8 * MAX_VARINT;
+
+enum Record_type {
+    STEP_RECORD = 1,
+    ANCHOR_RECORD = 2
+};
+
+typedef std::pair<unsigned long, unsigned long> Step_id;
+
+// A step as read back. Only where its removed text sits in the journal
+// is kept; the text is read when the step is put back.
+struct Journal_step {
+    Step_id parent;
+    size_t offset;
+    off_t removed_at;
+    size_t removed_size;
+    size_t inserted_size;
+};
+
+typedef std::map<Step_id, Journal_step> Step_map;
+
+struct Journal_anchor {
+    Step_id id;
+    unsigned long size, seconds, nanoseconds;
+
+    bool same_file(const Journal_anchor& other) const
+    {
+        return size == other.size && seconds == other.seconds
+            && nanoseconds == other.nanoseconds;
+    }
+};
+
+typedef std::vector<Journal_anchor> Anchor_list;
+
+void put(std::string* out, unsigned long value)
+{
+    unsigned char buffer[MAX_VARINT];
+    out->append((char*)buffer, put_varint(value, buffer) - buffer);
+}
+
+bool get(const unsigned char** in, const unsigned char* end,
+        unsigned long* value)
+{
+    *in = get_varint(*in, end, value);
+    return *in != NULL;
+}
+
+bool write_all(int fd, const char* data, size_t size)
+{
+    while (size) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+        data += written;
+        size -= written;
+    }
+    return true;
+}
+
+void encode(const Journal_record& record, std::string* out)
+{
+    std::string payload;
+    put(&payload, record.session);
+    put(&payload, record.sequence);
+
+    if (record.type == STEP_RECORD) {
+        put(&payload, record.parent_session);
+        put(&payload, record.parent_sequence);
+        put(&payload, record.offset);
+        put(&payload, record.removed);
+        payload += record.before.text(record.offset, record.removed);
+        put(&payload, record.inserted);
+        payload += record.after.text(record.offset, record.inserted);
+    } else {
+        put(&payload, record.size);
+        put(&payload, record.seconds);
+        put(&payload, record.nanoseconds);
+    }
+
+    *out += (char)record.type;
+    put(out, payload.size());
+    *out += payload;
+}
+
+bool read_all(int fd, off_t at, size_t size, char* out)
+{
+    while (size) {
+        ssize_t bytes = pread(fd, out, size, at);
+        if (bytes < 0 && errno == EINTR)
+            continue;
+        if (bytes <= 0)
+            return false;
+        out += bytes;
+        at += bytes;
+        size -= bytes;
+    }
+    return true;
+}
+
+// Reads the journal front to back through a window of READ_SIZE bytes,
+// so it is never in memory as a whole. Text that is skipped over is not
+// read at all.
+class Journal_reader {
+public:
+    Journal_reader(int fd, off_t end) : fd(fd), end(end), start(0) { }
+
+    // The bytes from offset on, as many as are in the window but at least
+    // MAX_HEADER of them unless the journal ends first. NULL on a read
+    // error.
+    const unsigned char* at(off_t offset, const unsigned char** limit);
+
+private:
+    int fd;
+    off_t end, start;
+    std::string window;
+};
+
+const unsigned char* Journal_reader::at(off_t offset,
+        const unsigned char** limit)
+{
+    off_t want = std::min(offset + (off_t)MAX_HEADER, end);
+    if (offset < start || want > start + (off_t)window.size()) {
+        window.resize(std::min((off_t)READ_SIZE, end - offset));
+        if (!read_all(fd, offset, window.size(), &window[0]))
+            return NULL;
+        start = offset;
+    }
+
+    const unsigned char* data = (const unsigned char*)window.data();
+    *limit = data + window.size();
+    return data + (offset - start);
+}
+
+bool get_at(Journal_reader* reader, off_t* offset, off_t end,
+        unsigned long* value)
+{
+    const unsigned char* limit;
+    const unsigned char* in = reader->at(*offset, &limit);
+    if (in == NULL)
+        return false;
+
+    limit = std::min(limit, in + (end - *offset));
+    const unsigned char* next = get_varint(in, limit, value);
+    if (next == NULL)
+        return false;
+    *offset += next - in;
+    return true;
+}
+
+// Indexes the records of earlier sessions, [MAGIC_SIZE, end) of the
+// journal. A record cut short by a crash ends the journal there.
+void decode(int fd, off_t end, Step_map* steps, Anchor_list* anchors)
+{
+    Journal_reader reader(fd, end);
+    off_t at = MAGIC_SIZE;
+
+    while (at < end) {
+        const unsigned char* limit;
+        const unsigned char* in = reader.at(at, &limit);
+        if (in == NULL)
+            return;
+
+        int type = *in;
+        ++at;
+        unsigned long length;
+        if (!get_at(&reader, &at, end, &length)
+                || length > (unsigned long)(end - at))
+            return;
+
+        off_t record = at;
+        off_t record_end = at + length;
+        at = record_end;
+
+        Step_id id;
+        if (!get_at(&reader, &record, record_end, &id.first)
+                || !get_at(&reader, &record, record_end, &id.second))
+            continue;
+
+        if (type == STEP_RECORD) {
+            Journal_step step;
+            unsigned long offset, size;
+            if (!get_at(&reader, &record, record_end, &step.parent.first)
+                    || !get_at(&reader, &record, record_end,
+                        &step.parent.second)
+                    || !get_at(&reader, &record, record_end, &offset)
+                    || !get_at(&reader, &record, record_end, &size)
+                    || size > (unsigned long)(record_end - record))
+                continue;
+
+            step.offset = offset;
+            step.removed_at = record;
+            step.removed_size = size;
+            record += size;
+
+            if (!get_at(&reader, &record, record_end, &size)
+                    || size > (unsigned long)(record_end - record))
+                continue;
+
+            step.inserted_size = size;
+            (*steps)[id] = step;
+        } else if (type == ANCHOR_RECORD) {
+            Journal_anchor anchor;
+            anchor.id = id;
+            if (get_at(&reader, &record, record_end, &anchor.size)
+                    && get_at(&reader, &record, record_end, &anchor.seconds)
+                    && get_at(&reader, &record, record_end,
+                        &anchor.nanoseconds))
+                anchors->push_back(anchor);
+        }
+    }
+}
+
+// Checks the magic of an open journal, putting it in an empty one, and
+// gives the journal's size.
+bool check(int fd, unsigned long* size)
+{
+    struct stat st;
+    char magic[MAGIC_SIZE];
+    if (fstat(fd, &st) < 0)
+        return false;
+
+    if (st.st_size == 0) {
+        *size = MAGIC_SIZE;
+        return write_all(fd, MAGIC, MAGIC_SIZE);
+    }
+
+    *size = st.st_size;
+    return pread(fd, magic, MAGIC_SIZE, 0) == (ssize_t)MAGIC_SIZE
+        && memcmp(magic, MAGIC, MAGIC_SIZE) == 0;
+}
+
+} // namespace
+
+std::string Undo_journal::path_for(const std::string& file)
+{
+    size_t slash = file.rfind('/');
+    if (slash == std::string::npos)
+        return "." + file + ".undo";
+    return file.substr(0, slash + 1) + "." + file.substr(slash + 1) + ".undo";
+}
+
+// A journal that is not ours (wrong magic) is left alone and nothing is
+// recorded for this session. One that does not exist yet is only made
+// once there is a step to put in it, so files that are only looked at
+// get none.
+Undo_journal::Undo_journal(Undo_tree* tree)
+    : tree(tree), fd(-1), session(0), root_sequence(0),
+      root_size(0), root_seconds(0), root_nanoseconds(0),
+      loaded(false), writable(false), stopping(false)
+{
+    const std::string& file = tree->buffer->path;
+    if (file.empty())
+        return;
+
+    fd = ::open(path_for(file).c_str(), O_RDWR | O_APPEND);
+    if (fd < 0 && errno != ENOENT)
+        return;
+    if (fd >= 0 && !check(fd, &session)) {
+        close(fd);
+        fd = -1;
+        return;
+    }
+
+    root_sequence = tree->top()->sequence;
+    stat_file(&root_size, &root_seconds, &root_nanoseconds);
+    writable = true;
+    tree->journal = this;
+}
+
+Undo_journal::~Undo_journal()
+{
+    if (tree->journal != this)
+        return;
+
+    tree->checkpoint();
+    tree->journal = NULL;
+    if (running()) {
+        {
+            Lock lock(mutex);
+            stopping = true;
+            ready.signal();
+        }
+        join();
+    }
+    if (fd >= 0)
+        close(fd);
+}
+
+// Makes the journal if need be and starts writing this session, with
+// the state it started from anchored to the file as it was opened.
+bool Undo_journal::begin()
+{
+    if (running())
+        return true;
+    if (!writable)
+        return false;
+
+    if (fd < 0) {
+        const std::string& path = path_for(tree->buffer->path);
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0600);
+        if (fd >= 0 && !check(fd, &session)) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0 || !start()) {
+        writable = false;
+        return false;
+    }
+
+    Journal_record record;
+    record.type = ANCHOR_RECORD;
+    record.session = session;
+    record.sequence = root_sequence;
+    record.size = root_size;
+    record.seconds = root_seconds;
+    record.nanoseconds = root_nanoseconds;
+    push(record);
+    return true;
+}
+
+bool Undo_journal::stat_file(unsigned long* size, unsigned long* seconds,
+        unsigned long* nanoseconds) const
+{
+    struct stat st;
+    if (stat(tree->buffer->path.c_str(), &st) < 0)
+        return false;
+
+    *size = st.st_size;
+    *seconds = st.st_mtim.tv_sec;
+    *nanoseconds = st.st_mtim.tv_nsec;
+    return true;
+}
+
+void Undo_journal::push(const Journal_record& record)
+{
+    Lock lock(mutex);
+    queue.push_back(record);
+    ready.signal();
+}
+
+void Undo_journal::closed(const Undo_node* node)
+{
+    if (node->parent == NULL || !begin())
+        return;
+
+    const Undo_node* parent = node->parent;
+    Journal_record record;
+    record.type = STEP_RECORD;
+    record.session = node->session ? node->session : session;
+    record.sequence = node->sequence;
+    record.parent_session = parent->session ? parent->session : session;
+    record.parent_sequence = parent->sequence;
+    record.offset = node->offset;
+    record.removed = node->removed;
+    record.inserted = node->inserted;
+    record.before = parent->snapshot;
+    record.after = node->snapshot;
+    push(record);
+}
+
+void Undo_journal::anchor(const Undo_node* node)
+{
+    if (!begin())
+        return;
+
+    Journal_record record;
+    record.type = ANCHOR_RECORD;
+    record.session = node->session ? node->session : session;
+    record.sequence = node->sequence;
+    if (!stat_file(&record.size, &record.seconds, &record.nanoseconds))
+        return;
+    push(record);
+}
+
+// Writes whatever has piled up in one go. Encoding happens here, so the
+// main thread only ever copies a few snapshot handles.
+void Undo_journal::run()
+{
+    mutex.lock();
+    for (;;) {
+        while (queue.empty() && !stopping)
+            ready.wait(mutex);
+        if (queue.empty())
+            break;
+
+        Journal_queue batch;
+        batch.swap(queue);
+        mutex.unlock();
+
+        std::string out;
+        for (Journal_queue::const_iterator cit = batch.begin(),
+                end = batch.end();
+                cit != end;
+                ++cit)
+        {
+            encode(*cit, &out);
+        }
+        write_all(fd, out.data(), out.size());
+
+        mutex.lock();
+    }
+    mutex.unlock();
+}
+
+// Starting from the latest earlier state that matches the file as it was
+// opened, walks back step by step. A state with no step behind it started
+// a session, and the walk carries on from the latest earlier state with
+// the same file under it.
+//
+// Only the part of the journal before this session is read, so the
+// writer thread can keep appending meanwhile. It is read once for its
+// records; the text of a step is only read when the walk gets to it.
+void Undo_journal::load()
+{
+    if (fd < 0 || loaded)
+        return;
+    loaded = true;
+
+    const Undo_node* top = tree->top();
+    if (top->session != 0 || top->sequence != root_sequence)
+        return;
+
+    Step_map steps;
+    Anchor_list anchors;
+    decode(fd, session, &steps, &anchors);
+
+    Journal_anchor opened;
+    opened.size = root_size;
+    opened.seconds = root_seconds;
+    opened.nanoseconds = root_nanoseconds;
+
+    size_t before = anchors.size();
+    Step_id id;
+    bool found = false;
+    while (before-- > 0) {
+        if (anchors[before].same_file(opened)) {
+            id = anchors[before].id;
+            found = true;
+            break;
+        }
+    }
+    if (!found)
+        return;
+
+    Buffer scratch;
+    scratch.restore(top->snapshot, 0, 0, top->snapshot.size());
+
+    std::string removed;
+    size_t limit = steps.size() + anchors.size();
+    while (limit-- > 0) {
+        Step_map::const_iterator step = steps.find(id);
+        if (step != steps.end()) {
+            const Journal_step& s = step->second;
+            if (s.offset + s.inserted_size > scratch.size())
+                return;
+
+            removed.resize(s.removed_size);
+            if (s.removed_size
+                    && !read_all(fd, s.removed_at, s.removed_size,
+                        &removed[0]))
+                return;
+
+            scratch.remove(s.offset, s.inserted_size);
+            scratch.insert(s.offset, removed.data(), s.removed_size);
+            tree->prepend(scratch.snapshot(), s.offset, s.removed_size,
+                    s.inserted_size, s.parent.first, s.parent.second);
+            id = s.parent;
+            continue;
+        }
+
+        // The start of a session: find what it was started from.
+        size_t own = before;
+        while (own > 0 && anchors[own].id != id)
+            --own;
+        if (anchors[own].id != id)
+            return;
+
+        const Journal_anchor& started = anchors[own];
+        found = false;
+        while (own-- > 0) {
+            if (anchors[own].same_file(started) && anchors[own].id != id) {
+                id = anchors[own].id;
+                before = own;
+                found = true;
+                break;
+            }
+        }
+        if (!found)
+            return;
+    }
+}
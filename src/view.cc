@@ -0,0 +1,765 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/view.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <rotide/curses.hpp>
+
+using namespace curses_lib;
+
+namespace {
+
+void put(WINDOW* window, const std::string& text, int attr)
+{
+    if (text.empty())
+        return;
+
+    if (attr)
+        wattron(window, attr);
+    waddnstr(window, text.c_str(), text.size());
+    if (attr)
+        wattroff(window, attr);
+}
+
+// Stands for the lines under a fold, cut to the room left in the row.
+void put_fold(WINDOW* window, size_t hidden, int room)
+{
+    char text[64];
+    int length = snprintf(text, sizeof(text), " +-- %lu lines --",
+            (unsigned long)hidden);
+    if (room > 0)
+        put(window, std::string(text, std::min(length, room)), A_BOLD);
+}
+
+// Rows of the hex dump hold this many bytes, as hexdump -C does, or fewer
+// on a narrow window.
+const size_t HEX_ROW = 16;
+
+// Both digits of every byte value, so formatting a byte is a lookup and
+// a two byte copy instead of a division and two lookups.
+const char* hex_pairs()
+{
+    static char pairs[512];
+    static bool made = false;
+    if (!made) {
+        const char* digits = "0123456789abcdef";
+        for (int i = 0; i < 256; ++i) {
+            pairs[2 * i] = digits[i >> 4];
+            pairs[2 * i + 1] = digits[i & 15];
+        }
+        made = true;
+    }
+    return pairs;
+}
+
+// Offset digits for a buffer of size bytes, at least eight.
+size_t offset_digits(size_t size)
+{
+    size_t digits = 8;
+    while (digits < 2 * sizeof(size_t) && (size >> (4 * digits)) != 0)
+        ++digits;
+    return digits;
+}
+
+// Cells a row of the hex dump takes. A row of eight bytes:
+//  "00000010  7f 45 4c 46 02 01 01 00  |.ELF....|"
+size_t hex_cells(size_t digits, size_t bytes)
+{
+    return digits + 2 + 3 * bytes + bytes / 8 + 2 + bytes;
+}
+
+// Screen column of the hex digits of the byte at column in a row.
+size_t hex_cell(size_t digits, size_t column)
+{
+    return digits + 2 + 3 * column + column / 8;
+}
+
+} // namespace
+
+Buffer_view::Buffer_view(Curses* curses, Buffer* buffer)
+    : curses(curses), buffer(buffer), cursor(0),
+      top_line(0), top_row(0), rows(0), columns(0), goal(-1),
+      hex_mode(buffer->binary), hex_top(0)
+{
+    buffer->listen(this);
+}
+
+Buffer_view::~Buffer_view()
+{
+    buffer->unlisten(this);
+}
+
+// Edits in front of the cursor move it; edits that swallow it leave it
+// at the start of the edit. Folds past the edit move with their lines
+// and one the edit reaches into is opened.
+void Buffer_view::edited(Buffer* buffer, const Buffer_edit& edit)
+{
+    if (layout.lines())
+        layout.edited(buffer->snapshot(), edit);
+
+    if (!folds.empty() && folds.rbegin()->second >= edit.line) {
+        size_t touched = edit.line + edit.removed_lines;
+        size_t moved = edit.inserted_lines - edit.removed_lines;
+        Fold_map kept;
+        for (Fold_map::const_iterator it = folds.begin(), end = folds.end();
+                it != end;
+                ++it)
+        {
+            size_t first = it->first, last = it->second;
+            if (last < edit.line) {
+                kept.insert(*it);
+            } else if (first > touched) {
+                kept[first + moved] = last + moved;
+            } else if (layout.lines()) {
+                if (first < edit.line)
+                    layout.hide(first, edit.line - first, false);
+                if (last > touched)
+                    layout.hide(touched + 1 + moved, last - touched, false);
+            }
+        }
+        folds.swap(kept);
+    }
+
+    if (cursor >= edit.offset + edit.removed)
+        cursor = cursor - edit.removed + edit.inserted;
+    else if (cursor > edit.offset)
+        cursor = edit.offset;
+
+    if (edit.line < top_line) {
+        if (top_line <= edit.line + edit.removed_lines) {
+            top_line = edit.line;
+            top_row = 0;
+        } else {
+            top_line = top_line - edit.removed_lines + edit.inserted_lines;
+        }
+    }
+}
+
+// Picks up the size of the active window. A new width throws the wrap
+// cache away since every break depends on it. The hex dump needs no
+// layout, and making one reads every byte, so it is left for when the
+// text is shown again.
+void Buffer_view::fit()
+{
+    int height, width;
+    getmaxyx(curses->active_window, height, width);
+    rows = height;
+    columns = width;
+    if (hex_mode)
+        return;
+
+    if (layout.lines() == 0 || layout.width() != std::max(1, width)) {
+        layout.reset(buffer->snapshot(), width);
+        for (Fold_map::const_iterator it = folds.begin(), end = folds.end();
+                it != end;
+                ++it)
+        {
+            layout.hide(it->first, it->second - it->first + 1, true);
+        }
+    }
+}
+
+// Screen column of a byte offset within a visual row.
+int Buffer_view::cell_of(size_t line, size_t row, size_t offset)
+{
+    const Wrap_line& wrap = layout.measure(line);
+    size_t start = buffer->line_start(line) + wrap.row_start(row);
+    const std::string& text = buffer->text(start, offset - start);
+
+    int cell = 0;
+    for (std::string::const_iterator cit = text.begin(), end = text.end();
+            cit != end;
+            ++cit)
+    {
+        cell += cell_width(*cit, cell);
+    }
+    return cell;
+}
+
+// Byte offset of whatever sits at a screen column within a visual row,
+// clamped to the row.
+size_t Buffer_view::offset_at_cell(size_t line, size_t row, int cell)
+{
+    const Wrap_line& wrap = layout.measure(line);
+    size_t start = buffer->line_start(line);
+    size_t length = buffer->line_end(line) - start;
+    size_t from = wrap.row_start(row);
+    bool last = row + 1 >= wrap.rows;
+    size_t to = last ? length : wrap.breaks[row];
+    const std::string& text = buffer->text(start + from, to - from);
+
+    int column = 0;
+    size_t i = 0, lead = 0;
+    for (; i < text.size(); ++i) {
+        int cells = cell_width(text[i], column);
+        if (cells == 0)
+            continue;
+        if (column + cells > cell)
+            return start + from + i;
+        lead = i;
+        column += cells;
+    }
+
+    // Past the end of the row. The last row of a line can hold the
+    // cursor after its final character; other rows end on their last one.
+    return start + from + (last ? text.size() : lead);
+}
+
+// The cursor never rests in a fold: one it moves into is opened.
+void Buffer_view::follow_cursor()
+{
+    if (hex_mode) {
+        size_t width = hex_width();
+        size_t row = cursor / width, top = hex_top / width;
+        if (row < top)
+            top = row;
+        else if (rows > 0 && row >= top + rows)
+            top = row - rows + 1;
+        hex_top = top * width;
+        return;
+    }
+
+    size_t line = this->line();
+    size_t fold_first, fold_last;
+    if (folded(line, &fold_first, &fold_last))
+        unfold(fold_first);
+
+    if (shown(top_line) != top_line) {
+        top_line = shown(top_line);
+        top_row = 0;
+    }
+
+    size_t start = buffer->line_start(line);
+    size_t row = layout.measure(line).row_of(cursor - start);
+
+    if (line < top_line || (line == top_line && row < top_row)) {
+        top_line = line;
+        top_row = row;
+        return;
+    }
+
+    // Everything that can still be on screen with the cursor is measured
+    // so the distance below is exact rather than an estimate.
+    size_t first = std::max(top_line, line > (size_t)rows ? line - rows : 0);
+    layout.measure(top_line);
+    for (size_t l = first; l < line; ++l)
+        layout.measure(l);
+
+    size_t top = layout.row_of(top_line) + top_row;
+    size_t at = layout.row_of(line) + row;
+    if (at >= top + rows) {
+        Wrap_position position = layout.locate(at - rows + 1);
+        top_line = position.line;
+        top_row = position.row;
+    }
+}
+
+void Buffer_view::draw()
+{
+    fit();
+    if (hex_mode) {
+        draw_hex();
+        return;
+    }
+
+    WINDOW* window = curses->active_window;
+    size_t lines = buffer->lines();
+    size_t line = std::min(top_line, lines - 1);
+    size_t row = top_row;
+    if (shown(line) != line) {
+        line = shown(line);
+        row = 0;
+    }
+    int cursor_row = 0, cursor_col = 0;
+    std::vector<int> attrs;
+
+    for (int r = 0; r < rows; ++r) {
+        wmove(window, r, 0);
+        wclrtoeol(window);
+
+        if (line >= lines) {
+            waddch(window, '~');
+            continue;
+        }
+
+        const Wrap_line& wrap = layout.measure(line);
+        row = std::min(row, wrap.rows - 1);
+
+        size_t start = buffer->line_start(line);
+        size_t length = buffer->line_end(line) - start;
+        size_t from = wrap.row_start(row);
+        bool last = row + 1 >= wrap.rows;
+        size_t to = last ? length : wrap.breaks[row];
+        const std::string& text = buffer->text(start + from, to - from);
+        highlight(start + from, text.size(), &attrs);
+
+        // Tabs are spelled out so the screen matches the layout, and other
+        // control characters take a single cell like the layout assumes.
+        // Each run of text with the same attributes goes out at once.
+        std::string out;
+        int column = 0;
+        int attr = 0;
+        for (size_t i = 0; i < text.size(); ++i) {
+            unsigned char c = text[i];
+            if (start + from + i == cursor) {
+                cursor_row = r;
+                cursor_col = column;
+            }
+
+            if (attrs[i] != attr) {
+                put(window, out, attr);
+                out.clear();
+                attr = attrs[i];
+            }
+
+            int cells = cell_width(c, column);
+            if (c == '\t')
+                out.append(cells, ' ');
+            else if (c < 32 || c == 127)
+                out += '?';
+            else
+                out += c;
+            column += cells;
+        }
+
+        if (last && cursor == start + length) {
+            cursor_row = r;
+            cursor_col = column;
+        }
+
+        put(window, out, attr);
+
+        // A fold is skipped in one step however many lines it holds.
+        Fold_map::const_iterator fold = folds.find(line + 1);
+        if (last && fold != folds.end()) {
+            put_fold(window, fold->second - fold->first + 1,
+                    layout.width() - column);
+        }
+
+        if (++row >= wrap.rows) {
+            line = (fold == folds.end()) ? line + 1 : fold->second + 1;
+            row = 0;
+        }
+    }
+
+    wmove(window, cursor_row, cursor_col);
+    curses->pos.row = cursor_row;
+    curses->pos.col = cursor_col;
+    curses->touched_window = window;
+}
+
+// Reads the bytes of the visible rows and nothing else, so a dump of a
+// file of any size costs a screenful to draw.
+void Buffer_view::draw_hex()
+{
+    WINDOW* window = curses->active_window;
+    size_t width = hex_width();
+    size_t digits = offset_digits(buffer->size());
+    hex_top = std::min(hex_top, buffer->size());
+    hex_top -= hex_top % width;
+
+    const std::string& text = buffer->text(hex_top, rows * width);
+    std::vector<int> attrs;
+    highlight(hex_top, text.size(), &attrs);
+    if (cursor >= hex_top && cursor - hex_top < text.size())
+        attrs[cursor - hex_top] |= A_REVERSE;
+
+    const char* pairs = hex_pairs();
+    const char* numbers = "0123456789abcdef";
+    for (int r = 0; r < rows; ++r) {
+        wmove(window, r, 0);
+        wclrtoeol(window);
+
+        size_t begin = r * width;
+        if (begin >= text.size() && (begin || text.size())) {
+            waddch(window, '~');
+            continue;
+        }
+        size_t count = std::min(width, text.size() - begin);
+
+        std::string out(digits, '0');
+        size_t offset = hex_top + begin;
+        for (size_t d = 0; d < digits; ++d)
+            out[d] = numbers[(offset >> (4 * (digits - 1 - d))) & 15];
+        out += "  ";
+
+        // The cursor's own highlight belongs to the text column only; its
+        // digits are where the terminal's cursor goes.
+        int attr = 0;
+        for (size_t i = 0; i < width; ++i) {
+            int next = i < count ? attrs[begin + i] : 0;
+            if (begin + i + hex_top == cursor)
+                next &= ~A_REVERSE;
+            if (next != attr) {
+                put(window, out, attr);
+                out.clear();
+                attr = next;
+            }
+            if (i < count) {
+                const char* pair = pairs + 2 * (unsigned char)text[begin + i];
+                out.append(pair, 2);
+                out += ' ';
+            } else {
+                out += "   ";
+            }
+            if (i % 8 == 7)
+                out += ' ';
+        }
+        put(window, out, attr);
+        out = "|";
+        attr = 0;
+
+        for (size_t i = 0; i < count; ++i) {
+            if (attrs[begin + i] != attr) {
+                put(window, out, attr);
+                out.clear();
+                attr = attrs[begin + i];
+            }
+            unsigned char c = text[begin + i];
+            out += (c >= 32 && c < 127) ? (char)c : '.';
+        }
+        put(window, out, attr);
+        put(window, "|", 0);
+    }
+
+    int cursor_row = 0, cursor_col = hex_cell(digits, 0);
+    if (cursor >= hex_top && cursor - hex_top < rows * width) {
+        cursor_row = (cursor - hex_top) / width;
+        cursor_col = hex_cell(digits, (cursor - hex_top) % width);
+    }
+
+    wmove(window, cursor_row, cursor_col);
+    curses->pos.row = cursor_row;
+    curses->pos.col = cursor_col;
+    curses->touched_window = window;
+}
+
+// The widest row of HEX_ROW, HEX_ROW / 2, ... down to 4 bytes that fits.
+size_t Buffer_view::hex_width() const
+{
+    size_t digits = offset_digits(buffer->size());
+    size_t width = HEX_ROW;
+    while (width > 4 && hex_cells(digits, width) > (size_t)columns)
+        width /= 2;
+    return width;
+}
+
+// Where the cursor stops in the hex dump: on a byte, unless there are
+// none.
+size_t Buffer_view::last_byte() const
+{
+    return buffer->size() ? buffer->size() - 1 : 0;
+}
+
+void Buffer_view::show(Buffer* other)
+{
+    if (other == buffer)
+        return;
+
+    buffer->unlisten(this);
+    buffer = other;
+    buffer->listen(this);
+
+    cursor = 0;
+    top_line = top_row = 0;
+    goal = -1;
+    hex_mode = buffer->binary;
+    hex_top = 0;
+    folds.clear();
+    layout.reset(buffer->snapshot(), layout.width());
+}
+
+void Buffer_view::add_highlighter(Highlighter* highlighter)
+{
+    highlighters.push_back(highlighter);
+}
+
+void Buffer_view::remove_highlighter(Highlighter* highlighter)
+{
+    highlighters.erase(
+            std::remove(highlighters.begin(), highlighters.end(),
+                highlighter),
+            highlighters.end());
+}
+
+// The attribute of every byte in [offset, offset + size), from all the
+// highlighters. A later highlight's color replaces an earlier one's; the
+// rest of the attributes add up.
+void Buffer_view::highlight(size_t offset, size_t size,
+        std::vector<int>* attrs)
+{
+    attrs->assign(size, 0);
+    if (highlighters.empty())
+        return;
+
+    Highlight_list runs;
+    for (Highlighter_list::iterator it = highlighters.begin(),
+            end = highlighters.end();
+            it != end;
+            ++it)
+    {
+        (*it)->highlight(offset, offset + size, &runs);
+    }
+
+    for (Highlight_list::const_iterator it = runs.begin(), end = runs.end();
+            it != end;
+            ++it)
+    {
+        size_t from = std::max(it->offset, offset) - offset;
+        size_t to = std::min(it->offset + it->length, offset + size);
+        for (size_t i = from; i + offset < to; ++i) {
+            int& attr = (*attrs)[i];
+            if (it->attr & A_COLOR)
+                attr &= ~A_COLOR;
+            attr |= it->attr;
+        }
+    }
+}
+
+void Buffer_view::insert(const char* data, size_t size)
+{
+    fit();
+    goal = -1;
+    buffer->insert(cursor, data, size);
+    follow_cursor();
+}
+
+void Buffer_view::overwrite(const char* data, size_t size)
+{
+    if (size == 0)
+        return;
+
+    fit();
+    goal = -1;
+    size_t at = cursor;
+    size_t over = std::min(size, buffer->size() - at);
+    buffer->replace(Range_list(1, Buffer_range(at, over)), data, size);
+    cursor = hex_mode ? std::min(at + size, last_byte()) : at + size;
+    follow_cursor();
+}
+
+bool Buffer_view::set_hex(bool on)
+{
+    if (!on && buffer->binary)
+        return false;
+
+    fit();
+    goal = -1;
+    hex_mode = on;
+    if (hex_mode)
+        cursor = std::min(cursor, last_byte());
+    follow_cursor();
+    return true;
+}
+
+// Removes the character in front of the cursor.
+void Buffer_view::backspace()
+{
+    if (cursor == 0)
+        return;
+
+    fit();
+    goal = -1;
+    size_t start = cursor - 1;
+    while (start > 0 && (buffer->at(start) & 0xC0) == 0x80)
+        --start;
+    buffer->remove(start, cursor - start);
+    follow_cursor();
+}
+
+void Buffer_view::move_rows(long delta)
+{
+    fit();
+
+    if (hex_mode) {
+        size_t width = hex_width();
+        long last = last_byte() / width;
+        long row = std::max(0L,
+                std::min((long)(cursor / width) + delta, last));
+        cursor = std::min(row * width + cursor % width, last_byte());
+        follow_cursor();
+        return;
+    }
+
+    size_t line = this->line();
+    size_t start = buffer->line_start(line);
+    size_t row = layout.measure(line).row_of(cursor - start);
+
+    if (goal < 0)
+        goal = cell_of(line, row, cursor);
+
+    long target = (long)(layout.row_of(line) + row) + delta;
+    target = std::max(0L, std::min(target, (long)layout.rows() - 1));
+
+    Wrap_position position = layout.locate(target);
+    size_t rows_in_line = layout.measure(position.line).rows;
+    position.row = std::min(position.row, rows_in_line - 1);
+
+    cursor = offset_at_cell(position.line, position.row, goal);
+    follow_cursor();
+}
+
+void Buffer_view::move_columns(long delta)
+{
+    fit();
+    goal = -1;
+
+    // Bytes, across rows.
+    if (hex_mode) {
+        long target = std::max(0L, (long)cursor + delta);
+        cursor = std::min((size_t)target, last_byte());
+        follow_cursor();
+        return;
+    }
+
+    size_t line = this->line();
+    size_t start = buffer->line_start(line);
+    size_t end = buffer->line_end(line);
+
+    for (; delta > 0 && cursor < end; --delta) {
+        ++cursor;
+        while (cursor < end && (buffer->at(cursor) & 0xC0) == 0x80)
+            ++cursor;
+    }
+
+    for (; delta < 0 && cursor > start; ++delta) {
+        --cursor;
+        while (cursor > start && (buffer->at(cursor) & 0xC0) == 0x80)
+            --cursor;
+    }
+
+    follow_cursor();
+}
+
+void Buffer_view::set_line(size_t line)
+{
+    fit();
+    goal = -1;
+    cursor = buffer->line_start(line);
+    follow_cursor();
+}
+
+void Buffer_view::set_column(size_t column)
+{
+    fit();
+    goal = -1;
+    size_t line = this->line();
+    size_t start = buffer->line_start(line);
+    cursor = std::min(start + column, buffer->line_end(line));
+    follow_cursor();
+}
+
+void Buffer_view::set_offset(size_t offset)
+{
+    fit();
+    goal = -1;
+    cursor = std::min(offset, hex_mode ? last_byte() : buffer->size());
+    follow_cursor();
+}
+
+size_t Buffer_view::line() const
+{
+    return buffer->line_of(cursor);
+}
+
+size_t Buffer_view::column() const
+{
+    return cursor - buffer->line_start(line());
+}
+
+bool Buffer_view::fold(size_t first, size_t last)
+{
+    size_t hidden_first, hidden_last;
+    if (first == 0 || last < first || last >= buffer->lines()
+            || folded(first - 1, &hidden_first, &hidden_last))
+        return false;
+
+    fit();
+    Fold_map::iterator inside = folds.lower_bound(first), end = inside;
+    for (; end != folds.end() && end->first <= last + 1; ++end) {
+        if (end->second > last)
+            return false;
+    }
+    folds.erase(inside, end);
+    folds[first] = last;
+    layout.hide(first, last - first + 1, true);
+
+    size_t line = this->line();
+    if (line >= first && line <= last) {
+        goal = -1;
+        cursor = buffer->line_start(first - 1);
+    }
+    follow_cursor();
+    return true;
+}
+
+bool Buffer_view::unfold(size_t line)
+{
+    size_t first, last;
+    if (!folded(line, &first, &last)) {
+        Fold_map::const_iterator it = folds.find(line + 1);
+        if (it == folds.end())
+            return false;
+        first = it->first;
+        last = it->second;
+    }
+
+    folds.erase(first);
+    if (layout.lines())
+        layout.hide(first, last - first + 1, false);
+    return true;
+}
+
+void Buffer_view::unfold_all()
+{
+    if (layout.lines()) {
+        for (Fold_map::const_iterator it = folds.begin(), end = folds.end();
+                it != end;
+                ++it)
+        {
+            layout.hide(it->first, it->second - it->first + 1, false);
+        }
+    }
+    folds.clear();
+}
+
+bool Buffer_view::folded(size_t line, size_t* first, size_t* last) const
+{
+    Fold_map::const_iterator it = folds.upper_bound(line);
+    if (it == folds.begin())
+        return false;
+
+    --it;
+    if (line > it->second)
+        return false;
+
+    *first = it->first;
+    *last = it->second;
+    return true;
+}
+
+// The line standing for line on the screen: itself, or the one over the
+// fold that hides it.
+size_t Buffer_view::shown(size_t line) const
+{
+    size_t first, last;
+    return folded(line, &first, &last) ? first - 1 : line;
+}
@@ -0,0 +1,705 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <rotide/watcher.hpp>
+#include <rotide/events.hpp>
+#include <rotide/saver.hpp>
+#include <rotide/undo.hpp>
+#include <rotide/view.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <rotide/curses.hpp>
+
+namespace {
+
+// What the directory's watch is told about: writes to the file, and
+// files moved or made in its place.
+const uint32_t WATCH_MASK = IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO
+    | IN_CREATE | IN_ONLYDIR;
+
+// Changes adding up to no more than this are copied out of the new
+// mapping; bigger ones keep it and have it indexed.
+const size_t COPY_LIMIT = 16 * 1024 * 1024;
+
+// A followed file that grew by more is read in pieces this big, so the
+// buffer takes in a burst a piece at a time.
+const size_t TAIL_CHUNK = 64 * 1024 * 1024;
+
+bool cancelled(Reload_run* run)
+{
+    return __sync_fetch_and_add(&run->cancelled, 0) != 0;
+}
+
+// Binary content is left without a line index, as Buffer::open leaves
+// it, so a rotated core dump costs no more than a text file to take in.
+void index(Buffer_block* block)
+{
+    if (block->looks_binary())
+        block->binary = true;
+    else
+        block->build_index();
+}
+
+// Whether a block is a mapping of the file described by info.
+bool maps(const Buffer_block& block, const struct stat& info)
+{
+    struct stat mapped;
+    return block.mapped && block.fd >= 0 && fstat(block.fd, &mapped) == 0
+        && mapped.st_dev == info.st_dev && mapped.st_ino == info.st_ino;
+}
+
+// Adds the blocks of a snapshot that map the file described by info, if
+// they are not there yet. Only the blocks' descriptors are looked at.
+void find_mappings(const Buffer_snapshot& text, const struct stat& info,
+        Block_list* blocks)
+{
+    Piece_iterator it(text, 0);
+    const Piece* piece;
+    const Buffer_block* checked = NULL;
+    size_t skip;
+    while (it.next_piece(&piece, &skip)) {
+        if (piece->block.get() == checked)
+            continue;
+        checked = piece->block.get();
+        if (std::find(blocks->begin(), blocks->end(), piece->block)
+                == blocks->end() && maps(*checked, info))
+        {
+            blocks->push_back(piece->block);
+        }
+    }
+}
+
+class Files_changed : public Event {
+public:
+    Files_changed(File_watcher* watcher, const File_name_list& names)
+        : watcher(watcher), names(names) { }
+
+    void run() { watcher->changed(names); }
+
+private:
+    File_watcher* watcher;
+    File_name_list names;
+};
+
+class Reload_done : public Event {
+public:
+    Reload_done(File_watcher* watcher, const Ref<Reload_run>& run,
+            unsigned long generation, bool unchanged,
+            const Ref<Buffer_block>& text, const Diff_hunk_list& hunks,
+            int error)
+        : watcher(watcher), reload(run), generation(generation),
+          unchanged(unchanged), text(text), hunks(hunks), error(error)
+    {
+    }
+
+    void run()
+    {
+        watcher->reloaded(reload.get(), generation, unchanged, text, hunks,
+                error);
+    }
+
+private:
+    File_watcher* watcher;
+    Ref<Reload_run> reload;
+    unsigned long generation;
+    bool unchanged;
+    Ref<Buffer_block> text;
+    Diff_hunk_list hunks;
+    int error;
+};
+
+// Maps the file and diffs the buffer against it. A file that still holds
+// what was last saved has not been changed by anyone else, which is the
+// case right after a save of our own.
+//
+// A buffer still mapping the file itself cannot be diffed: the file was
+// written over in place, the old pages show the new bytes, and past a
+// new end they fault. It is replaced whole instead, and those pages are
+// cut to the file before anything reads them.
+class Reload_job : public Job {
+public:
+    Reload_job(File_watcher* watcher, Event_queue* events,
+            const Ref<Reload_run>& run, const std::string& path,
+            const Buffer_snapshot& current, const Buffer_snapshot& saved,
+            unsigned long generation, bool force)
+        : watcher(watcher), events(events), reload(run), path(path),
+          current(current), saved(saved), generation(generation),
+          force(force)
+    {
+    }
+
+    void run();
+
+private:
+    File_watcher* watcher;
+    Event_queue* events;
+    Ref<Reload_run> reload;
+    std::string path;
+    Buffer_snapshot current, saved;
+    unsigned long generation;
+    bool force;
+};
+
+void Reload_job::run()
+{
+    Ref<Buffer_block> text;
+    Diff_hunk_list hunks;
+    int error = 0;
+    bool unchanged = false;
+
+    struct stat info;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd >= 0 && fstat(fd, &info) < 0) {
+        error = errno;
+        close(fd);
+    } else if (fd < 0 || !map_file(fd, &text)) {
+        error = errno;
+    } else {
+        if (text.empty())
+            text = new Buffer_block(0);
+
+        Block_list mapped;
+        find_mappings(current, info, &mapped);
+        find_mappings(saved, info, &mapped);
+        for (Block_list::const_iterator cit = mapped.begin(),
+                end = mapped.end();
+                cit != end;
+                ++cit)
+        {
+            (*cit)->cut(info.st_size);
+        }
+
+        if (!mapped.empty()) {
+            if (current.size() || text->used)
+                hunks.push_back(Diff_hunk(0, current.size(), 0, text->used));
+        } else {
+            unchanged = !force && same(saved, *text);
+            if (!unchanged && !cancelled(reload.get()))
+                diff(current, *text, &hunks);
+        }
+
+        size_t changed = 0;
+        for (Diff_hunk_list::const_iterator cit = hunks.begin(),
+                end = hunks.end();
+                cit != end;
+                ++cit)
+        {
+            changed += cit->inserted;
+        }
+
+        if (changed > COPY_LIMIT) {
+            index(text.get());
+        } else if (changed) {
+            Ref<Buffer_block> copy(new Buffer_block(changed));
+            for (Diff_hunk_list::iterator it = hunks.begin(),
+                    end = hunks.end();
+                    it != end;
+                    ++it)
+            {
+                memcpy(copy->data + copy->used, text->data + it->from,
+                        it->inserted);
+                it->from = copy->used;
+                copy->used += it->inserted;
+            }
+            copy->build_index();
+            text = copy;
+        } else {
+            text.reset();
+        }
+    }
+
+    if (!cancelled(reload.get())) {
+        events->post(new Reload_done(watcher, reload, generation, unchanged,
+                    text, hunks, error));
+    }
+}
+
+class Tail_done : public Event {
+public:
+    Tail_done(File_watcher* watcher, const Ref<Reload_run>& run,
+            bool rotated, dev_t device, ino_t inode,
+            const Ref<Buffer_block>& text, off_t size, bool more, int error)
+        : watcher(watcher), reload(run), rotated(rotated), device(device),
+          inode(inode), text(text), size(size), more(more), error(error)
+    {
+    }
+
+    void run()
+    {
+        watcher->tailed(reload.get(), rotated, device, inode, text, size,
+                more, error);
+    }
+
+private:
+    File_watcher* watcher;
+    Ref<Reload_run> reload;
+    bool rotated;
+    dev_t device;
+    ino_t inode;
+    Ref<Buffer_block> text;
+    off_t size;
+    bool more;
+    int error;
+};
+
+// Reads what a followed file gained past `from`. Another inode at the
+// path, or a file shorter than what was read, means it was rotated; the
+// new one is mapped whole then. What a binary file gains is binary too.
+class Tail_job : public Job {
+public:
+    Tail_job(File_watcher* watcher, Event_queue* events,
+            const Ref<Reload_run>& run, const std::string& path,
+            dev_t device, ino_t inode, off_t from, bool binary)
+        : watcher(watcher), events(events), reload(run), path(path),
+          device(device), inode(inode), from(from), binary(binary)
+    {
+    }
+
+    void run();
+
+private:
+    File_watcher* watcher;
+    Event_queue* events;
+    Ref<Reload_run> reload;
+    std::string path;
+    dev_t device;
+    ino_t inode;
+    off_t from;
+    bool binary;
+};
+
+void Tail_job::run()
+{
+    Ref<Buffer_block> text;
+    bool rotated = false, more = false;
+    off_t size = from;
+    int error = 0;
+
+    struct stat info;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0 || fstat(fd, &info) < 0) {
+        error = errno;
+    } else if (info.st_dev != device || info.st_ino != inode
+            || info.st_size < from)
+    {
+        rotated = true;
+        device = info.st_dev;
+        inode = info.st_ino;
+        if (map_file(fd, &text)) {
+            if (!text.empty())
+                index(text.get());
+            size = text.empty() ? 0 : text->used;
+        } else {
+            error = errno;
+        }
+        fd = -1;
+    } else if (info.st_size > from) {
+        size_t want = std::min((size_t)(info.st_size - from), TAIL_CHUNK);
+        text = new Buffer_block(want);
+        while (text->used < want) {
+            ssize_t got = pread(fd, text->data + text->used,
+                    want - text->used, from + text->used);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0)
+                error = errno;
+            if (got <= 0)
+                break;
+            text->used += got;
+        }
+        if (binary)
+            text->binary = true;
+        else
+            text->build_index();
+        size = from + text->used;
+        more = size < info.st_size;
+    }
+    if (fd >= 0)
+        close(fd);
+
+    if (!cancelled(reload.get())) {
+        events->post(new Tail_done(watcher, reload, rotated, device, inode,
+                    text, size, more, error));
+    }
+}
+
+} // namespace
+
+File_watcher::Reader::Reader(File_watcher* watcher, Event_queue* events,
+        int fd)
+    : watcher(watcher), events(events), fd(fd)
+{
+    if (pipe(wake) < 0)
+        wake[0] = wake[1] = -1;
+}
+
+File_watcher::Reader::~Reader()
+{
+    if (wake[0] >= 0) {
+        close(wake[0]);
+        close(wake[1]);
+    }
+}
+
+void File_watcher::Reader::stop()
+{
+    if (wake[1] >= 0 && write(wake[1], "", 1) < 0)
+        return;
+    join();
+}
+
+// Reads the watch until stopped, posting the names each read brings in
+// one go.
+void File_watcher::Reader::run()
+{
+    char data[64 * 1024]
+        __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    for (;;) {
+        struct pollfd fds[2];
+        fds[0].fd = fd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wake[0];
+        fds[1].events = POLLIN;
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[1].revents)
+            return;
+
+        ssize_t size = read(fd, data, sizeof(data));
+        if (size <= 0)
+            continue;
+
+        File_name_list names;
+        for (char* at = data; at < data + size; ) {
+            struct inotify_event* event = (struct inotify_event*)at;
+            // A file being written to sends one event per write.
+            if (event->len && (names.empty() || names.back() != event->name))
+                names.push_back(event->name);
+            at += sizeof(struct inotify_event) + event->len;
+        }
+        if (!names.empty())
+            events->post(new Files_changed(watcher, names));
+    }
+}
+
+File_watcher::File_watcher(Buffer_view* view, Undo_tree* undo,
+        Saver* saver, Curses* curses, Thread_pool* pool, Event_queue* events)
+    : view(view), buffer(view->buffer), undo(undo), saver(saver),
+      curses(curses), pool(pool), events(events), inotify(inotify_init()),
+      directory(-1), reader(NULL), reloading(false), pending(false),
+      forcing(false), tailing(false), device(0), inode(0), taken(0)
+{
+    run = new Reload_run;
+    buffer->listen(this);
+
+    if (inotify >= 0) {
+        fcntl(inotify, F_SETFD, FD_CLOEXEC);
+        reader = new Reader(this, events, inotify);
+        if (!reader->start()) {
+            delete reader;
+            reader = NULL;
+        }
+    }
+}
+
+File_watcher::~File_watcher()
+{
+    __sync_lock_test_and_set(&run->cancelled, 1);
+    buffer->unlisten(this);
+    if (reader != NULL) {
+        reader->stop();
+        delete reader;
+    }
+    if (inotify >= 0)
+        close(inotify);
+}
+
+bool File_watcher::watch()
+{
+    if (reader == NULL || buffer->path.empty())
+        return false;
+    if (buffer->path == path)
+        return true;
+
+    if (directory >= 0)
+        inotify_rm_watch(inotify, directory);
+
+    path = buffer->path;
+    size_t slash = path.rfind('/');
+    std::string parent = slash == std::string::npos ? "."
+        : slash == 0 ? "/" : path.substr(0, slash);
+    name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+    directory = inotify_add_watch(inotify, parent.c_str(), WATCH_MASK);
+
+    mappings.clear();
+    struct stat info;
+    if (stat(path.c_str(), &info) == 0) {
+        find_mappings(buffer->saved, info, &mappings);
+        find_mappings(buffer->snapshot(), info, &mappings);
+    }
+    return directory >= 0;
+}
+
+// A reload asked for while one is running is done once that one is in,
+// so a file being written to all the time is read at most one at a time.
+void File_watcher::reload(bool force)
+{
+    if (path.empty())
+        return;
+
+    forcing = forcing || force;
+    if (reloading) {
+        pending = true;
+        return;
+    }
+
+    reloading = true;
+    pending = false;
+    pool->submit(new Reload_job(this, events, run, path, buffer->snapshot(),
+                buffer->saved, buffer->generation, forcing));
+}
+
+bool File_watcher::follow(bool on)
+{
+    if (on && !watch())
+        return false;
+    if (on == tailing)
+        return true;
+
+    // Whatever was on its way was asked for in the other mode.
+    __sync_lock_test_and_set(&run->cancelled, 1);
+    run = new Reload_run;
+    reloading = pending = forcing = false;
+
+    tailing = on;
+    if (tailing) {
+        take_file();
+        tail();
+    }
+    return true;
+}
+
+// The file is taken to be what was saved last. If it grew meanwhile the
+// first read catches up.
+void File_watcher::take_file()
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) < 0) {
+        device = 0;
+        inode = 0;
+    } else {
+        device = info.st_dev;
+        inode = info.st_ino;
+    }
+    taken = buffer->saved.size();
+}
+
+void File_watcher::tail()
+{
+    if (reloading) {
+        pending = true;
+        return;
+    }
+
+    reloading = true;
+    pending = false;
+    pool->submit(new Tail_job(this, events, run, path, device, inode,
+                taken, buffer->binary));
+}
+
+// A save puts another file in place, which is not a rotation.
+void File_watcher::written(Buffer*)
+{
+    watch();
+    if (tailing)
+        take_file();
+}
+
+// Our own saves are seen through the saver instead. Whoever changed the
+// file, the mappings of it are cut first.
+void File_watcher::changed(const File_name_list& names)
+{
+    if (std::find(names.begin(), names.end(), name) == names.end())
+        return;
+
+    cut();
+    if (saver->busy())
+        return;
+
+    if (tailing)
+        tail();
+    else
+        reload(false);
+}
+
+// A file cut short while the buffer maps it would fault the next time
+// its end is drawn, so the pages past its end are swapped for zeros
+// before anything is. What they held is gone either way; the reload or
+// tail that follows replaces it. Mappings only we still hold are let go.
+void File_watcher::cut()
+{
+    struct stat info;
+    if (stat(path.c_str(), &info) < 0)
+        return;
+
+    for (Block_list::iterator it = mappings.begin(); it != mappings.end(); ) {
+        if ((*it)->refs == 1) {
+            it = mappings.erase(it);
+            continue;
+        }
+        if (maps(**it, info))
+            (*it)->cut(info.st_size);
+        ++it;
+    }
+}
+
+void File_watcher::reloaded(Reload_run* finished, unsigned long generation,
+        bool unchanged, const Ref<Buffer_block>& text,
+        const Diff_hunk_list& hunks, int error)
+{
+    if (finished != run.get())
+        return;
+
+    reloading = false;
+    if (buffer->generation != generation) {
+        // The buffer changed while the diff was worked out. It is only
+        // good for the buffer it was made against, so it is made again.
+        pending = true;
+    } else if (error) {
+        // A file being replaced is missing for a moment; the rename that
+        // brings it back is seen as well.
+        if (error != ENOENT) {
+            curses->status() << CLEAR << COLOR(WHITE, RED) << BOLD
+                << "Could not read " << path << ": " << strerror(error)
+                << RESET;
+        }
+        forcing = false;
+    } else if (unchanged) {
+        forcing = false;
+    } else if (hunks.empty()) {
+        // The file holds the buffer as it is now.
+        buffer->set_saved(buffer->snapshot());
+        forcing = false;
+    } else if (buffer->modified && !forcing) {
+        curses->status() << CLEAR << COLOR(WHITE, RED) << BOLD
+            << "\"" << path << "\" changed on disk; :reload takes it"
+            << RESET;
+    } else {
+        apply(text, hunks);
+        forcing = false;
+    }
+
+    if (pending)
+        reload(false);
+}
+
+// From the back, so the offsets of the hunks still to come hold.
+void File_watcher::apply(const Ref<Buffer_block>& text,
+        const Diff_hunk_list& hunks)
+{
+    Buffer_snapshot changed(text);
+    if (text->mapped)
+        mappings.push_back(text);
+
+    undo->checkpoint();
+    for (Diff_hunk_list::const_reverse_iterator crit = hunks.rbegin(),
+            end = hunks.rend();
+            crit != end;
+            ++crit)
+    {
+        buffer->remove(crit->offset, crit->removed);
+        if (crit->inserted) {
+            buffer->insert(crit->offset,
+                    changed.slice(crit->from, crit->inserted), 1);
+        }
+    }
+    undo->checkpoint();
+    buffer->set_saved(buffer->snapshot());
+
+    curses->status() << CLEAR << "\"" << path << "\" reloaded, "
+        << hunks.size() << (hunks.size() == 1 ? " change" : " changes");
+}
+
+void File_watcher::tailed(Reload_run* finished, bool rotated, dev_t device,
+        ino_t inode, const Ref<Buffer_block>& text, off_t size, bool more,
+        int error)
+{
+    if (finished != run.get())
+        return;
+
+    reloading = false;
+    if (error) {
+        // Between a rotation's rename and the new file showing up.
+        if (error != ENOENT) {
+            curses->status() << CLEAR << COLOR(WHITE, RED) << BOLD
+                << "Could not read " << path << ": " << strerror(error)
+                << RESET;
+        }
+    } else {
+        bool pinned = view->buffer == buffer
+            && view->line() + 1 >= buffer->lines();
+
+        if (rotated) {
+            // The old text goes as what it was, the new comes in as
+            // what it is, so the indexes skip only binary content.
+            bool binary = !text.empty() && text->binary;
+            bool switched = binary != buffer->binary;
+
+            undo->checkpoint();
+            buffer->remove(0, buffer->size());
+            buffer->binary = binary;
+            buffer->insert(0, Buffer_snapshot(text), 1);
+            undo->checkpoint();
+            buffer->set_saved(buffer->snapshot());
+            if (!text.empty() && text->mapped)
+                mappings.push_back(text);
+            if (switched && view->buffer == buffer)
+                view->set_hex(binary);
+
+            curses->status() << CLEAR << "\"" << path << "\" was rotated";
+            this->device = device;
+            this->inode = inode;
+        } else if (!text.empty() && text->used) {
+            undo->checkpoint();
+            buffer->append_saved(Buffer_snapshot(text));
+            undo->checkpoint();
+        }
+        taken = size;
+
+        if (pinned)
+            view->set_line(buffer->lines() - 1);
+        if (more)
+            pending = true;
+    }
+
+    if (pending)
+        tail();
+}
@@ -0,0 +1,512 @@
+//
+// Copyright 2011 Justin Bruce Van Horne <justinvh@gmail.com>
+// All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <rotide/wrap.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+typedef std::vector<Wrap_line> Wrap_line_list;
+
+// A run of consecutive lines. `lines` and `rows` are subtree totals and
+// `own` is the number of rows shown in this chunk alone.
+struct Wrap_chunk {
+    Wrap_chunk();
+    ~Wrap_chunk() { delete left; delete right; }
+
+    Wrap_chunk* left;
+    Wrap_chunk* right;
+    unsigned priority;
+    size_t lines, rows, own;
+    Wrap_line_list entries;
+};
+
+namespace {
+
+// Lines per chunk. Anything smaller than half of this gets folded into
+// its neighbours when the lines around it change.
+const size_t CHUNK_LINES = 64;
+
+unsigned next_priority()
+{
+    static unsigned state = 88675123U;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+size_t count_lines(const Wrap_chunk* chunk)
+{
+    return chunk ? chunk->lines : 0;
+}
+
+size_t count_rows(const Wrap_chunk* chunk)
+{
+    return chunk ? chunk->rows : 0;
+}
+
+void update(Wrap_chunk* chunk)
+{
+    chunk->lines = count_lines(chunk->left) + chunk->entries.size()
+        + count_lines(chunk->right);
+    chunk->rows = count_rows(chunk->left) + chunk->own
+        + count_rows(chunk->right);
+}
+
+void recount(Wrap_chunk* chunk)
+{
+    chunk->own = 0;
+    for (Wrap_line_list::const_iterator cit = chunk->entries.begin(),
+            end = chunk->entries.end();
+            cit != end;
+            ++cit)
+    {
+        chunk->own += cit->shown();
+    }
+    update(chunk);
+}
+
+void hide_lines(Wrap_chunk* chunk, size_t first, size_t last, bool hidden)
+{
+    if (chunk == NULL || first >= last)
+        return;
+
+    size_t left_lines = count_lines(chunk->left);
+    size_t chunk_end = left_lines + chunk->entries.size();
+    if (first < left_lines) {
+        hide_lines(chunk->left, first, std::min(last, left_lines),
+                hidden);
+    }
+    if (last > chunk_end) {
+        hide_lines(chunk->right, std::max(first, chunk_end) - chunk_end,
+                last - chunk_end, hidden);
+    }
+
+    if (first < chunk_end && last > left_lines) {
+        size_t from = std::max(first, left_lines) - left_lines;
+        size_t to = std::min(last, chunk_end) - left_lines;
+        for (size_t i = from; i < to; ++i)
+            chunk->entries[i].hidden = hidden;
+        recount(chunk);
+    } else {
+        update(chunk);
+    }
+}
+
+Wrap_chunk* merge(Wrap_chunk* a, Wrap_chunk* b)
+{
+    if (a == NULL)
+        return b;
+    if (b == NULL)
+        return a;
+
+    if (a->priority > b->priority) {
+        a->right = merge(a->right, b);
+        update(a);
+        return a;
+    }
+
+    b->left = merge(a, b->left);
+    update(b);
+    return b;
+}
+
+// Splits off the first `count` lines, cutting a chunk if needed.
+void split(Wrap_chunk* chunk, size_t count, Wrap_chunk** left,
+        Wrap_chunk** right)
+{
+    if (chunk == NULL) {
+        *left = *right = NULL;
+        return;
+    }
+
+    size_t left_lines = count_lines(chunk->left);
+    size_t chunk_end = left_lines + chunk->entries.size();
+
+    if (count <= left_lines) {
+        split(chunk->left, count, left, &chunk->left);
+        update(chunk);
+        *right = chunk;
+    } else if (count >= chunk_end) {
+        split(chunk->right, count - chunk_end, &chunk->right, right);
+        update(chunk);
+        *left = chunk;
+    } else {
+        Wrap_chunk* tail = new Wrap_chunk;
+        Wrap_line_list::iterator cut =
+            chunk->entries.begin() + (count - left_lines);
+        tail->entries.assign(cut, chunk->entries.end());
+        chunk->entries.erase(cut, chunk->entries.end());
+        recount(tail);
+
+        Wrap_chunk* rest = chunk->right;
+        chunk->right = NULL;
+        recount(chunk);
+
+        *left = chunk;
+        *right = merge(tail, rest);
+    }
+}
+
+void flatten(const Wrap_chunk* chunk, Wrap_line_list* out)
+{
+    if (chunk == NULL)
+        return;
+    flatten(chunk->left, out);
+    out->insert(out->end(), chunk->entries.begin(), chunk->entries.end());
+    flatten(chunk->right, out);
+}
+
+size_t first_chunk_size(const Wrap_chunk* chunk)
+{
+    while (chunk && chunk->left)
+        chunk = chunk->left;
+    return chunk ? chunk->entries.size() : 0;
+}
+
+size_t last_chunk_size(const Wrap_chunk* chunk)
+{
+    while (chunk && chunk->right)
+        chunk = chunk->right;
+    return chunk ? chunk->entries.size() : 0;
+}
+
+Wrap_chunk* build(const Wrap_line_list& lines)
+{
+    Wrap_chunk* tree = NULL;
+    for (size_t i = 0; i < lines.size(); i += CHUNK_LINES) {
+        Wrap_chunk* chunk = new Wrap_chunk;
+        size_t end = std::min(lines.size(), i + CHUNK_LINES);
+        chunk->entries.assign(lines.begin() + i, lines.begin() + end);
+        recount(chunk);
+        tree = merge(tree, chunk);
+    }
+    return tree;
+}
+
+} // namespace
+
+Wrap_chunk::Wrap_chunk()
+    : left(NULL), right(NULL), priority(next_priority()),
+      lines(0), rows(0), own(0)
+{
+}
+
+size_t Wrap_line::row_of(size_t column) const
+{
+    return std::upper_bound(breaks.begin(), breaks.end(), column)
+        - breaks.begin();
+}
+
+Wrap_layout::Wrap_layout()
+    : root(NULL), columns(1)
+{
+}
+
+Wrap_layout::~Wrap_layout()
+{
+    delete root;
+}
+
+Wrap_line Wrap_layout::estimate(size_t line, unsigned long generation) const
+{
+    size_t length = snapshot.line_end(line) - snapshot.line_start(line);
+    Wrap_line entry;
+    entry.rows = length ? (length + columns - 1) / columns : 1;
+    entry.width = columns;
+    entry.generation = generation;
+    entry.measured = generation - 1;
+    return entry;
+}
+
+// Walks the line's bytes once, from the last break still known to be good.
+void Wrap_layout::remeasure(size_t line, Wrap_line* entry) const
+{
+    size_t start = snapshot.line_start(line);
+    size_t length = snapshot.line_end(line) - start;
+
+    if (entry->width != columns)
+        entry->breaks.clear();
+
+    size_t position = entry->breaks.empty() ? 0 : entry->breaks.back();
+    int column = 0;
+
+    Piece_iterator it(snapshot, start + position);
+    const char* data;
+    size_t size;
+    while (position < length && it.next(&data, &size)) {
+        size = std::min(size, length - position);
+        for (size_t i = 0; i < size; ++i, ++position) {
+            unsigned char c = data[i];
+            int cells = cell_width(c, column);
+            if (cells == 0)
+                continue;
+
+            if (column > 0 && column + cells > columns) {
+                entry->breaks.push_back(position);
+                column = 0;
+                cells = cell_width(c, column);
+            }
+            column += std::min(cells, columns);
+        }
+    }
+
+    entry->rows = entry->breaks.size() + 1;
+    entry->width = columns;
+    entry->measured = entry->generation;
+}
+
+void Wrap_layout::reset(const Buffer_snapshot& next, int width)
+{
+    delete root;
+    root = NULL;
+    snapshot = next;
+    columns = std::max(1, width);
+
+    // One pass over the text for the line lengths rather than a tree
+    // lookup per line.
+    Wrap_line_list lines;
+    Wrap_line entry;
+    entry.width = columns;
+    entry.measured = entry.generation - 1;
+
+    size_t length = 0;
+    Piece_iterator it(snapshot, 0);
+    const char* data;
+    size_t size;
+    while (it.next(&data, &size)) {
+        const char* end = data + size;
+        const char* nl;
+        while ((nl = (const char*)memchr(data, '\n', end - data)) != NULL) {
+            length += nl - data;
+            entry.rows = length ? (length + columns - 1) / columns : 1;
+            lines.push_back(entry);
+            length = 0;
+            data = nl + 1;
+        }
+        length += end - data;
+    }
+    entry.rows = length ? (length + columns - 1) / columns : 1;
+    lines.push_back(entry);
+
+    root = build(lines);
+}
+
+void Wrap_layout::edited(const Buffer_snapshot& next, const Buffer_edit& edit)
+{
+    snapshot = next;
+    if (root == NULL) {
+        reset(next, columns);
+        return;
+    }
+
+    Wrap_line_list lines;
+    for (size_t i = 0; i <= edit.inserted_lines; ++i)
+        lines.push_back(estimate(edit.line + i, edit.generation));
+
+    // An edit inside a single line does not move the breaks in front of
+    // it, so only the rest of the line has to be measured again.
+    const Wrap_line* old = find(edit.line);
+    if (edit.removed_lines == 0 && edit.inserted_lines == 0
+            && old && old->width == columns
+            && old->measured == old->generation) {
+        size_t column = edit.offset - snapshot.line_start(edit.line);
+        Offset_list::const_iterator keep = std::lower_bound(
+                old->breaks.begin(), old->breaks.end(), column);
+        lines[0].breaks.assign(old->breaks.begin(), keep);
+    }
+
+    replace(edit.line, edit.removed_lines + 1, lines);
+}
+
+// Swaps lines [first, first + count) for new entries.
+void Wrap_layout::replace(size_t first, size_t count, Wrap_line_list& lines)
+{
+    Wrap_chunk *left, *middle, *right, *rest;
+    split(root, first, &left, &rest);
+    split(rest, count, &middle, &right);
+    delete middle;
+
+    // Pull small neighbours in so chunks do not fragment as lines come
+    // and go one at a time.
+    size_t tail_size = last_chunk_size(left);
+    if (tail_size && tail_size < CHUNK_LINES / 2) {
+        Wrap_chunk* tail;
+        split(left, count_lines(left) - tail_size, &left, &tail);
+        Wrap_line_list before;
+        flatten(tail, &before);
+        delete tail;
+        lines.insert(lines.begin(), before.begin(), before.end());
+    }
+
+    size_t head_size = first_chunk_size(right);
+    if (head_size && head_size < CHUNK_LINES / 2) {
+        Wrap_chunk* head;
+        split(right, head_size, &head, &right);
+        flatten(head, &lines);
+        delete head;
+    }
+
+    root = merge(merge(left, build(lines)), right);
+}
+
+const Wrap_line* Wrap_layout::find(size_t line) const
+{
+    const Wrap_chunk* chunk = root;
+    while (chunk) {
+        size_t left_lines = count_lines(chunk->left);
+        if (line < left_lines) {
+            chunk = chunk->left;
+        } else if (line < left_lines + chunk->entries.size()) {
+            return &chunk->entries[line - left_lines];
+        } else {
+            line -= left_lines + chunk->entries.size();
+            chunk = chunk->right;
+        }
+    }
+    return NULL;
+}
+
+const Wrap_line& Wrap_layout::measure(size_t line)
+{
+    static const Wrap_line empty;
+    if (root == NULL)
+        return empty;
+
+    line = std::min(line, root->lines - 1);
+    size_t index = line;
+
+    std::vector<Wrap_chunk*> path;
+    Wrap_chunk* chunk = root;
+    for (;;) {
+        path.push_back(chunk);
+        size_t left_lines = count_lines(chunk->left);
+        if (index < left_lines) {
+            chunk = chunk->left;
+        } else if (index < left_lines + chunk->entries.size()) {
+            index -= left_lines;
+            break;
+        } else {
+            index -= left_lines + chunk->entries.size();
+            chunk = chunk->right;
+        }
+    }
+
+    Wrap_line& entry = chunk->entries[index];
+    if (entry.width == columns && entry.measured == entry.generation)
+        return entry;
+
+    size_t before = entry.shown();
+    remeasure(line, &entry);
+    if (entry.shown() != before) {
+        chunk->own = chunk->own - before + entry.shown();
+        for (std::vector<Wrap_chunk*>::reverse_iterator rit = path.rbegin(),
+                end = path.rend();
+                rit != end;
+                ++rit)
+        {
+            update(*rit);
+        }
+    }
+
+    return entry;
+}
+
+void Wrap_layout::hide(size_t first, size_t count, bool hidden)
+{
+    hide_lines(root, first, first + count, hidden);
+}
+
+size_t Wrap_layout::row_of(size_t line) const
+{
+    const Wrap_chunk* chunk = root;
+    size_t row = 0;
+    while (chunk) {
+        size_t left_lines = count_lines(chunk->left);
+        if (line < left_lines) {
+            chunk = chunk->left;
+            continue;
+        }
+
+        row += count_rows(chunk->left);
+        line -= left_lines;
+
+        if (line < chunk->entries.size()) {
+            for (size_t i = 0; i < line; ++i)
+                row += chunk->entries[i].shown();
+            return row;
+        }
+
+        row += chunk->own;
+        line -= chunk->entries.size();
+        chunk = chunk->right;
+    }
+    return row;
+}
+
+Wrap_position Wrap_layout::locate(size_t row) const
+{
+    Wrap_position position;
+    if (root == NULL)
+        return position;
+
+    if (row >= root->rows)
+        row = root->rows - 1;
+
+    const Wrap_chunk* chunk = root;
+    size_t line = 0;
+    while (chunk) {
+        size_t left_rows = count_rows(chunk->left);
+        if (row < left_rows) {
+            chunk = chunk->left;
+            continue;
+        }
+
+        row -= left_rows;
+        line += count_lines(chunk->left);
+
+        if (row < chunk->own) {
+            for (Wrap_line_list::const_iterator cit = chunk->entries.begin(),
+                    end = chunk->entries.end();
+                    cit != end;
+                    ++cit, ++line)
+            {
+                if (row < cit->shown())
+                    break;
+                row -= cit->shown();
+            }
+            position.line = line;
+            position.row = row;
+            return position;
+        }
+
+        row -= chunk->own;
+        line += chunk->entries.size();
+        chunk = chunk->right;
+    }
+    return position;
+}
+
+size_t Wrap_layout::rows() const
+{
+    return count_rows(root);
+}
+
+size_t Wrap_layout::lines() const
+{
+    return count_lines(root);
+}